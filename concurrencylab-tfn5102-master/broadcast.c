@@ -0,0 +1,335 @@
+#include <stdint.h>
+#include "broadcast.h"
+#include "futex.h"
+
+// One item of the ring; seq is the position the item was published at plus one, or 0 while a publisher rewrites it
+// Subscribers read a slot without any lock like a seqlock: a value is only taken if seq matched before and after
+typedef struct {
+    atomic_size_t seq;
+    _Atomic(void*) value;
+} broadcast_slot_t;
+
+struct broadcast_subscriber {
+    broadcast_t* broadcast;
+    list_node_t link; // in the broadcast's subscriber list
+    atomic_size_t cursor; // position of the next item to read, only written by the subscriber
+    size_t dropped; // items skipped under BROADCAST_DROP
+};
+
+struct broadcast {
+    pthread_mutex_t mutex; // serializes the publishers and guards the subscriber list and head
+    broadcast_slot_t* slots; // a power of two, see broadcast_create; position p lives in slot p & mask
+    size_t mask;
+    size_t capacity; // most items a publish may run ahead of the slowest subscriber under BROADCAST_BLOCK
+    enum broadcast_policy policy;
+    atomic_size_t tail; // position of the next publish
+    size_t head; // lower bound of every cursor, only refreshed from the subscribers when the ring looks full
+    list_t* subscribers;
+    atomic_bool closed;
+    // Subscribers waiting for a publish sleep on published, publishers waiting for the slowest subscriber on
+    // consumed; the parked counts let the other side skip the wake syscall when nobody sleeps
+    atomic_uint published;
+    atomic_size_t readers_parked;
+    atomic_uint consumed;
+    atomic_size_t writers_parked;
+};
+
+// Creates a broadcast with a ring of capacity items (at least 1) and the given policy
+// Under BROADCAST_DROP the ring keeps at least the last capacity items
+// Returns NULL if capacity is 0 or the broadcast could not be created
+broadcast_t* broadcast_create(size_t capacity, enum broadcast_policy policy)
+{
+    if (capacity == 0 || capacity > (SIZE_MAX >> 1) / sizeof(broadcast_slot_t)) {
+        return NULL;
+    }
+    // Under BROADCAST_DROP a lapped subscriber stays clear of the slot a publish may be rewriting, so one slot is
+    // kept on top of the last capacity items
+    size_t needed = (policy == BROADCAST_DROP) ? capacity + 1 : capacity;
+    size_t slots = 1;
+    while (slots < needed) {
+        slots <<= 1;
+    }
+    broadcast_t* broadcast = (broadcast_t*)malloc(sizeof(broadcast_t));
+    if (broadcast == NULL) {
+        return NULL;
+    }
+    broadcast->slots = (broadcast_slot_t*)malloc(sizeof(broadcast_slot_t) * slots);
+    broadcast->subscribers = list_create();
+    if (broadcast->slots == NULL || broadcast->subscribers == NULL) {
+        free(broadcast->slots);
+        if (broadcast->subscribers != NULL) {
+            list_destroy(broadcast->subscribers);
+        }
+        free(broadcast);
+        return NULL;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        atomic_init(&broadcast->slots[i].seq, 0);
+        atomic_init(&broadcast->slots[i].value, NULL);
+    }
+    pthread_mutex_init(&broadcast->mutex, NULL);
+    broadcast->mask = slots - 1;
+    broadcast->capacity = capacity;
+    broadcast->policy = policy;
+    atomic_init(&broadcast->tail, 0);
+    broadcast->head = 0;
+    atomic_init(&broadcast->closed, false);
+    atomic_init(&broadcast->published, 0);
+    atomic_init(&broadcast->readers_parked, 0);
+    atomic_init(&broadcast->consumed, 0);
+    atomic_init(&broadcast->writers_parked, 0);
+    return broadcast;
+}
+
+// Wakes every publisher waiting for the slowest subscriber so it looks at the cursors again
+// Costs a single load when no publisher waits; the seq_cst load pairs with the publisher's seq_cst increment of
+// writers_parked, so either the publisher sees the cursor that moved or the move is followed by a wake here
+static void broadcast_wake_writers(broadcast_t* broadcast)
+{
+    if (atomic_load(&broadcast->writers_parked) == 0) {
+        return;
+    }
+    atomic_fetch_add(&broadcast->consumed, 1);
+    futex_wake(&broadcast->consumed, SIZE_MAX);
+}
+
+// Wakes every subscriber waiting for a publish, see broadcast_wake_writers
+static void broadcast_wake_readers(broadcast_t* broadcast)
+{
+    if (atomic_load(&broadcast->readers_parked) == 0) {
+        return;
+    }
+    atomic_fetch_add(&broadcast->published, 1);
+    futex_wake(&broadcast->published, SIZE_MAX);
+}
+
+// Subscribes to the broadcast; the subscriber sees every item published after this returns
+// Returns NULL if the broadcast is closed or the subscriber could not be allocated
+broadcast_subscriber_t* broadcast_subscribe(broadcast_t* broadcast)
+{
+    if (broadcast == NULL) {
+        return NULL;
+    }
+    broadcast_subscriber_t* subscriber = (broadcast_subscriber_t*)malloc(sizeof(broadcast_subscriber_t));
+    if (subscriber == NULL) {
+        return NULL;
+    }
+    subscriber->broadcast = broadcast;
+    subscriber->dropped = 0;
+    pthread_mutex_lock(&broadcast->mutex);
+    if (atomic_load(&broadcast->closed)) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        free(subscriber);
+        return NULL;
+    }
+    // tail only moves under the mutex, so no item published after this can be missed
+    atomic_init(&subscriber->cursor, atomic_load(&broadcast->tail));
+    list_link(broadcast->subscribers, &subscriber->link, subscriber);
+    pthread_mutex_unlock(&broadcast->mutex);
+    return subscriber;
+}
+
+// Stops the subscription and frees the subscriber, releasing the items it had not read to a blocked publisher
+void broadcast_unsubscribe(broadcast_subscriber_t* subscriber)
+{
+    if (subscriber == NULL) {
+        return;
+    }
+    broadcast_t* broadcast = subscriber->broadcast;
+    pthread_mutex_lock(&broadcast->mutex);
+    list_unlink(broadcast->subscribers, &subscriber->link);
+    pthread_mutex_unlock(&broadcast->mutex);
+    free(subscriber);
+    broadcast_wake_writers(broadcast);
+}
+
+// Returns the cursor of the slowest subscriber, or tail if there is none
+// The broadcast mutex must be held
+static size_t broadcast_slowest_locked(broadcast_t* broadcast, size_t tail)
+{
+    size_t head = tail;
+    for (list_node_t* node = list_head(broadcast->subscribers); node != NULL; node = list_next(node)) {
+        broadcast_subscriber_t* subscriber = (broadcast_subscriber_t*)list_data(node);
+        size_t cursor = atomic_load(&subscriber->cursor);
+        if (cursor < head) {
+            head = cursor;
+        }
+    }
+    return head;
+}
+
+// Body of broadcast_publish and broadcast_non_blocking_publish
+static enum channel_status broadcast_publish_wait(broadcast_t* broadcast, void* data, bool blocking)
+{
+    if (broadcast == NULL) {
+        return GEN_ERROR;
+    }
+    pthread_mutex_lock(&broadcast->mutex);
+    size_t tail = atomic_load(&broadcast->tail);
+    while (broadcast->policy == BROADCAST_BLOCK && tail - broadcast->head >= broadcast->capacity) {
+        if (atomic_load(&broadcast->closed)) {
+            pthread_mutex_unlock(&broadcast->mutex);
+            return CLOSED_ERROR;
+        }
+        // Only walk the subscribers when the ring looks full; announce ourselves before reading the cursors
+        atomic_fetch_add(&broadcast->writers_parked, 1);
+        unsigned int seen = atomic_load(&broadcast->consumed);
+        broadcast->head = broadcast_slowest_locked(broadcast, tail);
+        if (tail - broadcast->head < broadcast->capacity) {
+            atomic_fetch_sub(&broadcast->writers_parked, 1);
+            break;
+        }
+        if (!blocking) {
+            atomic_fetch_sub(&broadcast->writers_parked, 1);
+            pthread_mutex_unlock(&broadcast->mutex);
+            return CHANNEL_FULL;
+        }
+        pthread_mutex_unlock(&broadcast->mutex);
+        futex_wait(&broadcast->consumed, seen, NULL);
+        pthread_mutex_lock(&broadcast->mutex);
+        atomic_fetch_sub(&broadcast->writers_parked, 1);
+        tail = atomic_load(&broadcast->tail);
+    }
+    if (atomic_load(&broadcast->closed)) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        return CLOSED_ERROR;
+    }
+    // Seqlock write: a subscriber that lapped into this slot sees seq change and skips ahead
+    broadcast_slot_t* slot = &broadcast->slots[tail & broadcast->mask];
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->value, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, tail + 1, memory_order_release);
+    atomic_store(&broadcast->tail, tail + 1);
+    pthread_mutex_unlock(&broadcast->mutex);
+    broadcast_wake_readers(broadcast);
+    return SUCCESS;
+}
+
+// Writes data to every subscriber, waiting for room under BROADCAST_BLOCK
+// Returns SUCCESS, CLOSED_ERROR if the broadcast is closed, or GEN_ERROR on invalid arguments
+enum channel_status broadcast_publish(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish_wait(broadcast, data, true);
+}
+
+// Same as broadcast_publish but returns CHANNEL_FULL instead of waiting under BROADCAST_BLOCK
+enum channel_status broadcast_non_blocking_publish(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish_wait(broadcast, data, false);
+}
+
+// Body of broadcast_receive and broadcast_non_blocking_receive; never takes the broadcast mutex
+static enum channel_status broadcast_receive_wait(broadcast_subscriber_t* subscriber, void** data, bool blocking)
+{
+    if (subscriber == NULL || data == NULL) {
+        return GEN_ERROR;
+    }
+    broadcast_t* broadcast = subscriber->broadcast;
+    size_t cursor = atomic_load_explicit(&subscriber->cursor, memory_order_relaxed);
+    while (true) {
+        if (atomic_load(&broadcast->closed)) {
+            return CLOSED_ERROR;
+        }
+        size_t tail = atomic_load(&broadcast->tail);
+        if (cursor != tail) {
+            broadcast_slot_t* slot = &broadcast->slots[cursor & broadcast->mask];
+            size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            void* value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (seq == cursor + 1 && atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+                *data = value;
+                atomic_store(&subscriber->cursor, cursor + 1);
+                broadcast_wake_writers(broadcast);
+                return SUCCESS;
+            }
+            // A publisher lapped us under BROADCAST_DROP; skip to the oldest item no publish in flight can touch
+            tail = atomic_load(&broadcast->tail);
+            size_t oldest = tail - broadcast->mask;
+            if (oldest > cursor + 1) {
+                subscriber->dropped += oldest - cursor;
+                cursor = oldest;
+            } else {
+                subscriber->dropped++;
+                cursor++;
+            }
+            atomic_store(&subscriber->cursor, cursor);
+            continue;
+        }
+        if (!blocking) {
+            return CHANNEL_EMPTY;
+        }
+        // Announce ourselves before looking at tail again, so a publish either is seen here or wakes us
+        atomic_fetch_add(&broadcast->readers_parked, 1);
+        unsigned int seen = atomic_load(&broadcast->published);
+        if (atomic_load(&broadcast->tail) == cursor && !atomic_load(&broadcast->closed)) {
+            futex_wait(&broadcast->published, seen, NULL);
+        }
+        atomic_fetch_sub(&broadcast->readers_parked, 1);
+    }
+}
+
+// Reads the next item of the subscriber into data, waiting for one to be published
+// Returns SUCCESS, CLOSED_ERROR if the broadcast is closed, or GEN_ERROR on invalid arguments
+enum channel_status broadcast_receive(broadcast_subscriber_t* subscriber, void** data)
+{
+    return broadcast_receive_wait(subscriber, data, true);
+}
+
+// Same as broadcast_receive but returns CHANNEL_EMPTY instead of waiting
+enum channel_status broadcast_non_blocking_receive(broadcast_subscriber_t* subscriber, void** data)
+{
+    return broadcast_receive_wait(subscriber, data, false);
+}
+
+// Returns the number of items the subscriber skipped because they were overwritten under BROADCAST_DROP
+size_t broadcast_dropped(const broadcast_subscriber_t* subscriber)
+{
+    return (subscriber == NULL) ? 0 : subscriber->dropped;
+}
+
+// Closes the broadcast and wakes every blocked publish and receive, which return CLOSED_ERROR like on a channel
+// Returns SUCCESS, or CLOSED_ERROR if it was already closed
+enum channel_status broadcast_close(broadcast_t* broadcast)
+{
+    if (broadcast == NULL) {
+        return GEN_ERROR;
+    }
+    pthread_mutex_lock(&broadcast->mutex);
+    if (atomic_exchange(&broadcast->closed, true)) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        return CLOSED_ERROR;
+    }
+    pthread_mutex_unlock(&broadcast->mutex);
+    atomic_fetch_add(&broadcast->published, 1);
+    futex_wake(&broadcast->published, SIZE_MAX);
+    atomic_fetch_add(&broadcast->consumed, 1);
+    futex_wake(&broadcast->consumed, SIZE_MAX);
+    return SUCCESS;
+}
+
+// Frees the broadcast and every subscriber still subscribed
+// The caller must close the broadcast and wait for all threads to stop using it first
+// Returns SUCCESS, DESTROY_ERROR if the broadcast was not closed first, and GEN_ERROR on invalid arguments
+enum channel_status broadcast_destroy(broadcast_t* broadcast)
+{
+    if (broadcast == NULL) {
+        return GEN_ERROR;
+    }
+    if (!atomic_load(&broadcast->closed)) {
+        return DESTROY_ERROR;
+    }
+    list_node_t* node = list_head(broadcast->subscribers);
+    while (node != NULL) {
+        list_node_t* next = list_next(node);
+        broadcast_subscriber_t* subscriber = (broadcast_subscriber_t*)list_data(node);
+        list_unlink(broadcast->subscribers, node);
+        free(subscriber);
+        node = next;
+    }
+    list_destroy(broadcast->subscribers);
+    pthread_mutex_destroy(&broadcast->mutex);
+    free(broadcast->slots);
+    free(broadcast);
+    return SUCCESS;
+}
@@ -0,0 +1,59 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+#include "channel.h"
+
+// Defines what a publish does when the slowest subscriber has not read the oldest item of a full ring yet
+enum broadcast_policy {
+    // The publisher waits for the slowest subscriber, so every subscriber sees every item
+    BROADCAST_BLOCK,
+    // The oldest item is overwritten; subscribers that fall more than a ring behind skip what they missed
+    BROADCAST_DROP,
+};
+
+// A channel where one publish delivers the value to every subscriber
+// The values live once in a shared ring and every subscriber reads them through its own cursor, so a publish costs
+// the same whatever the number of subscribers and receives never take the broadcast mutex
+typedef struct broadcast broadcast_t;
+
+// One reader of a broadcast; a subscriber may only be used by one thread at a time
+typedef struct broadcast_subscriber broadcast_subscriber_t;
+
+// Creates a broadcast with a ring of capacity items (at least 1) and the given policy
+// Returns NULL if capacity is 0 or the broadcast could not be created
+broadcast_t* broadcast_create(size_t capacity, enum broadcast_policy policy);
+
+// Subscribes to the broadcast; the subscriber sees every item published after this returns
+// Returns NULL if the broadcast is closed or the subscriber could not be allocated
+broadcast_subscriber_t* broadcast_subscribe(broadcast_t* broadcast);
+
+// Stops the subscription and frees the subscriber, releasing the items it had not read to a blocked publisher
+void broadcast_unsubscribe(broadcast_subscriber_t* subscriber);
+
+// Writes data to every subscriber, waiting for room under BROADCAST_BLOCK
+// Returns SUCCESS, CLOSED_ERROR if the broadcast is closed, or GEN_ERROR on invalid arguments
+enum channel_status broadcast_publish(broadcast_t* broadcast, void* data);
+
+// Same as broadcast_publish but returns CHANNEL_FULL instead of waiting under BROADCAST_BLOCK
+enum channel_status broadcast_non_blocking_publish(broadcast_t* broadcast, void* data);
+
+// Reads the next item of the subscriber into data, waiting for one to be published
+// Returns SUCCESS, CLOSED_ERROR if the broadcast is closed, or GEN_ERROR on invalid arguments
+enum channel_status broadcast_receive(broadcast_subscriber_t* subscriber, void** data);
+
+// Same as broadcast_receive but returns CHANNEL_EMPTY instead of waiting
+enum channel_status broadcast_non_blocking_receive(broadcast_subscriber_t* subscriber, void** data);
+
+// Returns the number of items the subscriber skipped because they were overwritten under BROADCAST_DROP
+size_t broadcast_dropped(const broadcast_subscriber_t* subscriber);
+
+// Closes the broadcast and wakes every blocked publish and receive, which return CLOSED_ERROR like on a channel
+// Returns SUCCESS, or CLOSED_ERROR if it was already closed
+enum channel_status broadcast_close(broadcast_t* broadcast);
+
+// Frees the broadcast and every subscriber still subscribed
+// Returns SUCCESS, or DESTROY_ERROR if the broadcast was not closed first
+enum channel_status broadcast_destroy(broadcast_t* broadcast);
+
+#endif // BROADCAST_H
@@ -1,14 +1,56 @@
+#include <stdint.h>
+#include <string.h>
 #include "buffer.h"
 
+// Rounds capacity up to the next power of two (at least 1)
+static size_t buffer_slots(size_t capacity)
+{
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+// Returns the slot of position pos in a sized buffer
+static void* buffer_value(buffer_t* buffer, size_t pos)
+{
+    return (char*)buffer->data + (pos & buffer->mask) * buffer->elem_size;
+}
+
 // Creates a buffer with the given capacity
+// Returns NULL if the buffer could not be allocated
 buffer_t* buffer_create(size_t capacity)
 {
-    buffer_t* buffer = (buffer_t*) malloc(sizeof(buffer_t));
-    void** data  = (void**) malloc(capacity * sizeof(void*));
-    buffer->size = 0;
-    buffer->next = 0;
+    return buffer_create_sized(capacity, 0);
+}
+
+// Creates a buffer with the given capacity that stores elem_size bytes inline per value, or void* values if 0
+// Returns NULL if the buffer could not be allocated
+buffer_t* buffer_create_sized(size_t capacity, size_t elem_size)
+{
+    size_t slots = buffer_slots(capacity);
+    size_t slot_size = (elem_size == 0) ? sizeof(void*) : elem_size;
+    if (slots > (SIZE_MAX - BUFFER_CACHE_LINE) / slot_size) {
+        return NULL;
+    }
+    buffer_t* buffer = (buffer_t*) aligned_alloc(BUFFER_CACHE_LINE, sizeof(buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    // aligned_alloc wants a multiple of the alignment
+    size_t bytes = (slots * slot_size + BUFFER_CACHE_LINE - 1) & ~(size_t)(BUFFER_CACHE_LINE - 1);
+    void** data = (void**) aligned_alloc(BUFFER_CACHE_LINE, bytes);
+    if (data == NULL) {
+        free(buffer);
+        return NULL;
+    }
     buffer->capacity = capacity;
+    buffer->mask = slots - 1;
+    buffer->elem_size = elem_size;
     buffer->data = data;
+    buffer->head = 0;
+    buffer->tail = 0;
     return buffer;
 }
 
@@ -17,15 +59,15 @@ buffer_t* buffer_create(size_t capacity)
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_add(buffer_t* buffer, void* data)
 {
-    if (buffer->size >= buffer->capacity) {
+    if (buffer->tail - buffer->head >= buffer->capacity) {
         return BUFFER_ERROR;
     }
-    size_t pos = buffer->next + buffer->size;
-    if (pos >= buffer->capacity) {
-        pos -= buffer->capacity;
+    if (buffer->elem_size != 0) {
+        memcpy(buffer_value(buffer, buffer->tail), data, buffer->elem_size);
+    } else {
+        buffer->data[buffer->tail & buffer->mask] = data;
     }
-    buffer->data[pos] = data;
-    buffer->size++;
+    buffer->tail++;
     return BUFFER_SUCCESS;
 }
 
@@ -34,16 +76,116 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data)
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 {
-    if (buffer->size > 0) {
-        *data = buffer->data[buffer->next];
-        buffer->size--;
-        buffer->next++;
-        if (buffer->next >= buffer->capacity) {
-            buffer->next -= buffer->capacity;
+    if (buffer->tail == buffer->head) {
+        return BUFFER_ERROR;
+    }
+    if (buffer->elem_size != 0) {
+        memcpy(*data, buffer_value(buffer, buffer->head), buffer->elem_size);
+    } else {
+        *data = buffer->data[buffer->head & buffer->mask];
+    }
+    buffer->head++;
+    return BUFFER_SUCCESS;
+}
+
+// Adds up to count values from items into the buffer in order, copying contiguous ring segments at once
+// Returns the number of values added, which is less than count if the buffer fills up
+size_t buffer_add_batch(buffer_t* buffer, void** items, size_t count)
+{
+    size_t space = buffer->capacity - (buffer->tail - buffer->head);
+    if (count > space) {
+        count = space;
+    }
+    buffer_write_at(buffer, buffer->tail, items, count);
+    buffer->tail += count;
+    return count;
+}
+
+// Removes up to max values from the buffer in FIFO order into out, copying contiguous ring segments at once
+// Returns the number of values removed
+size_t buffer_remove_batch(buffer_t* buffer, void** out, size_t max)
+{
+    size_t size = buffer->tail - buffer->head;
+    size_t count = (max < size) ? max : size;
+    buffer_read_at(buffer, buffer->head, out, count);
+    buffer->head += count;
+    return count;
+}
+
+// Copies count values (at most the capacity) from items into the ring slots starting at position pos
+// Does not touch head/tail; used by callers that keep their own ring indices
+void buffer_write_at(buffer_t* buffer, size_t pos, void** items, size_t count)
+{
+    if (buffer->elem_size != 0) {
+        for (size_t i = 0; i < count; i++) {
+            memcpy(buffer_value(buffer, pos + i), items[i], buffer->elem_size);
         }
-        return BUFFER_SUCCESS;
+        return;
     }
-    return BUFFER_ERROR;
+    size_t start = pos & buffer->mask;
+    size_t first = buffer->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(&buffer->data[start], items, first * sizeof(void*));
+    memcpy(buffer->data, items + first, (count - first) * sizeof(void*));
+}
+
+// Copies count values (at most the capacity) from the ring slots starting at position pos into out
+// Does not touch head/tail; used by callers that keep their own ring indices
+void buffer_read_at(buffer_t* buffer, size_t pos, void** out, size_t count)
+{
+    if (buffer->elem_size != 0) {
+        for (size_t i = 0; i < count; i++) {
+            memcpy(out[i], buffer_value(buffer, pos + i), buffer->elem_size);
+        }
+        return;
+    }
+    size_t start = pos & buffer->mask;
+    size_t first = buffer->mask + 1 - start;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(out, &buffer->data[start], first * sizeof(void*));
+    memcpy(out + first, buffer->data, (count - first) * sizeof(void*));
+}
+
+// Changes the capacity of the buffer to capacity (at least the number of values it holds), moving the values
+// into a slot array of the new length; positions stay the same, so callers' head/tail indices remain valid
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR if capacity is too small or the new slot array could not be allocated
+enum buffer_status buffer_resize(buffer_t* buffer, size_t capacity)
+{
+    size_t size = buffer->tail - buffer->head;
+    if (capacity == 0 || capacity < size) {
+        return BUFFER_ERROR;
+    }
+    size_t slots = buffer_slots(capacity);
+    size_t slot_size = (buffer->elem_size == 0) ? sizeof(void*) : buffer->elem_size;
+    if (slots > (SIZE_MAX - BUFFER_CACHE_LINE) / slot_size) {
+        return BUFFER_ERROR;
+    }
+    if (slots != buffer->mask + 1) {
+        size_t bytes = (slots * slot_size + BUFFER_CACHE_LINE - 1) & ~(size_t)(BUFFER_CACHE_LINE - 1);
+        void** data = (void**) aligned_alloc(BUFFER_CACHE_LINE, bytes);
+        if (data == NULL) {
+            return BUFFER_ERROR;
+        }
+        for (size_t pos = buffer->head; pos != buffer->tail; pos++) {
+            memcpy((char*)data + (pos & (slots - 1)) * slot_size, (char*)buffer->data + (pos & buffer->mask) * slot_size, slot_size);
+        }
+        free(buffer->data);
+        buffer->data = data;
+        buffer->mask = slots - 1;
+    }
+    buffer->capacity = capacity;
+    return BUFFER_SUCCESS;
+}
+
+// Returns the bytes the buffer holds allocated
+size_t buffer_bytes(buffer_t* buffer)
+{
+    size_t slot_size = (buffer->elem_size == 0) ? sizeof(void*) : buffer->elem_size;
+    return sizeof(buffer_t) + (buffer->mask + 1) * slot_size;
 }
 
 // Frees the memory allocated to the buffer
@@ -62,12 +204,15 @@ size_t buffer_capacity(buffer_t* buffer)
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer)
 {
-    return buffer->size;
+    return buffer->tail - buffer->head;
 }
 
-// Peeks at a value in the buffer
+// Peeks at a value in the buffer; for sized buffers returns a pointer to the value in its slot
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index)
 {
+    if (buffer->elem_size != 0) {
+        return buffer_value(buffer, index);
+    }
     return buffer->data[index];
 }
@@ -3,11 +3,22 @@
 
 #include <stdlib.h>
 
+// Size of the cache lines the buffer indices and slots are aligned to
+#define BUFFER_CACHE_LINE 64
+
+// Ring of void* slots addressed by monotonically increasing positions
+// The slot array has a power-of-two length, so position pos lives in slot pos & mask
+// A sized buffer stores elem_size bytes inline in every slot instead of a void*; its functions take pointers to
+// the values, copying the value in on add and out into the memory the caller's pointer points at on remove
+// head (advanced by removals) and tail (advanced by additions) each sit on their own cache line, away from
+// the read-mostly fields, so producers and consumers do not invalidate each other's lines
 typedef struct {
-    size_t size;
-    size_t next;
-    size_t capacity;
-    void** data;
+    size_t capacity; // number of values the buffer holds, the slot array may be larger
+    size_t mask; // slot array length - 1
+    size_t elem_size; // bytes stored per slot, 0 if the slots hold the void* values themselves
+    void** data; // cache line aligned slot array, elem_size bytes per slot for sized buffers
+    _Alignas(BUFFER_CACHE_LINE) size_t head; // position of the oldest value
+    _Alignas(BUFFER_CACHE_LINE) size_t tail; // position one past the newest value
 } buffer_t;
 
 enum buffer_status {
@@ -16,8 +27,13 @@ enum buffer_status {
 };
 
 // Creates a buffer with the given capacity
+// Returns NULL if the buffer could not be allocated
 buffer_t* buffer_create(size_t capacity);
 
+// Creates a buffer with the given capacity that stores elem_size bytes inline per value, or void* values if 0
+// Returns NULL if the buffer could not be allocated
+buffer_t* buffer_create_sized(size_t capacity, size_t elem_size);
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
@@ -28,6 +44,30 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data);
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void** data);
 
+// Adds up to count values from items into the buffer in order, copying contiguous ring segments at once
+// Returns the number of values added, which is less than count if the buffer fills up
+size_t buffer_add_batch(buffer_t* buffer, void** items, size_t count);
+
+// Removes up to max values from the buffer in FIFO order into out, copying contiguous ring segments at once
+// Returns the number of values removed
+size_t buffer_remove_batch(buffer_t* buffer, void** out, size_t max);
+
+// Copies count values (at most the capacity) from items into the ring slots starting at position pos
+// Does not touch head/tail; used by callers that keep their own ring indices
+void buffer_write_at(buffer_t* buffer, size_t pos, void** items, size_t count);
+
+// Copies count values (at most the capacity) from the ring slots starting at position pos into out
+// Does not touch head/tail; used by callers that keep their own ring indices
+void buffer_read_at(buffer_t* buffer, size_t pos, void** out, size_t count);
+
+// Changes the capacity of the buffer to capacity (at least the number of values it holds), moving the values
+// into a slot array of the new length; positions stay the same, so callers' head/tail indices remain valid
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR if capacity is too small or the new slot array could not be allocated
+enum buffer_status buffer_resize(buffer_t* buffer, size_t capacity);
+
+// Returns the bytes the buffer holds allocated
+size_t buffer_bytes(buffer_t* buffer);
+
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t* buffer);
 
@@ -37,7 +77,7 @@ size_t buffer_capacity(buffer_t* buffer);
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer);
 
-// Peeks at a value in the buffer
+// Peeks at a value in the buffer; for sized buffers returns a pointer to the value in its slot
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index);
 
@@ -1,444 +1,2138 @@
+#include <stdint.h>
+#include <time.h>
 #include "channel.h"
+#include "futex.h"
+
+// Values of channel_waiter_t.fired besides the index of the case that completed
+#define CHANNEL_WAITER_OPEN SIZE_MAX
+#define CHANNEL_WAITER_BUSY (SIZE_MAX - 1)
+// Set together with a case index when the channel of that case woke the select for one of its items or slots
+#define CHANNEL_WAITER_NOTIFIED ((SIZE_MAX >> 1) + 1)
+
+// Most cases a channel_select keeps its registrations for on the stack instead of allocating them
+#define CHANNEL_SELECT_STACK_CASES 16
+
+// Values of channel_waiter_t.state
+#define CHANNEL_WAITER_IDLE 0
+#define CHANNEL_WAITER_SLEEPING 1
+#define CHANNEL_WAITER_POSTED 2
+
+// Lower bound of the CHANNEL_WAIT_ADAPTIVE spin budget, so a channel that went quiet can learn to spin again
+#define CHANNEL_SPIN_MIN 16
+
+// Tells the CPU that we are busy waiting, so it can yield to a sibling hyperthread and save power
+static void channel_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// A thread registered on the waiter lists of one or more channels (selects, and plain calls on unbuffered channels)
+// Plain waiters are dequeued by the thread that wakes them, so every post hands over one item
+// Select waiters stay registered on all of their channels until channel_select returns and are posted on every change
+// On unbuffered channels the peer completes the operation itself and records the case in fired; a select waiter
+// sets fired to CHANNEL_WAITER_BUSY while it re-checks its cases so that it cannot be completed twice
+// On buffered channels a sleeping select is claimed for one new item or slot by setting fired to
+// CHANNEL_WAITER_NOTIFIED | case; if the select then completes another case it passes the wakeup on
+// Every channel that may have become ready for a select also pushes the registration of its case on the
+// waiter's ready list, so after a wakeup the select only re-checks those cases instead of all of them
+typedef struct {
+    atomic_uint state; // futex word, CHANNEL_WAITER_IDLE/SLEEPING/POSTED
+    atomic_size_t fired;
+    bool select;
+    _Atomic(struct channel_registration*) ready; // lock-free stack of ready cases, popped as a whole by the select
+} channel_waiter_t;
+
+// One case a waiter is parked on, linked into the channel waiter list through its own node
+// Registrations live on the waiting thread's stack (or in its select set), so registering allocates nothing
+typedef struct channel_registration {
+    channel_waiter_t* waiter;
+    list_node_t link;
+    list_node_t* node; // &link while on the waiter list, NULL once dequeued
+    size_t index; // select case index, 0 for plain waiters
+    void** data; // value to send or where to store the received one, used by unbuffered handoffs
+    atomic_bool queued; // on the waiter's ready list
+    struct channel_registration* next_ready;
+} channel_registration_t;
+
+static void channel_waiter_init(channel_waiter_t* waiter, bool select)
+{
+    atomic_init(&waiter->state, CHANNEL_WAITER_IDLE);
+    atomic_init(&waiter->fired, CHANNEL_WAITER_OPEN);
+    waiter->select = select;
+    atomic_init(&waiter->ready, NULL);
+}
+
+// Sleeps until the waiter is posted or the deadline (NULL for none) passes, returning at once if a post arrived
+// since the last park
+// Returns false if the deadline passed without a post
+static bool channel_waiter_park(channel_waiter_t* waiter, const struct timespec* deadline)
+{
+    unsigned int expected = CHANNEL_WAITER_IDLE;
+    if (atomic_compare_exchange_strong(&waiter->state, &expected, CHANNEL_WAITER_SLEEPING)) {
+        do {
+            if (!futex_wait(&waiter->state, CHANNEL_WAITER_SLEEPING, deadline)) {
+                // A post that races with the timeout wins
+                expected = CHANNEL_WAITER_SLEEPING;
+                if (atomic_compare_exchange_strong(&waiter->state, &expected, CHANNEL_WAITER_IDLE)) {
+                    return false;
+                }
+            }
+        } while (atomic_load(&waiter->state) == CHANNEL_WAITER_SLEEPING);
+    }
+    atomic_store(&waiter->state, CHANNEL_WAITER_IDLE);
+    return true;
+}
+
+// Posts the waiter, only entering the kernel if it is asleep
+// The waiter may already have returned by the time futex_wake runs; a wake on a stale address is harmless
+// since every futex_wait caller re-checks its word
+static void channel_waiter_post(channel_waiter_t* waiter)
+{
+    if (atomic_exchange(&waiter->state, CHANNEL_WAITER_POSTED) == CHANNEL_WAITER_SLEEPING) {
+        futex_wake(&waiter->state, 1);
+    }
+}
+
+static void channel_registration_init(channel_registration_t* registration, channel_waiter_t* waiter, size_t index, void** data)
+{
+    registration->waiter = waiter;
+    registration->node = NULL;
+    registration->index = index;
+    registration->data = data;
+    atomic_init(&registration->queued, false);
+    registration->next_ready = NULL;
+}
+
+// Pushes a select registration on its waiter's ready list unless it is already there
+// Must be done before looking at the waiter's fired, so a select that claims the waiter afterwards finds the case
+static void channel_registration_ready(channel_registration_t* registration)
+{
+    if (atomic_exchange(&registration->queued, true)) {
+        return;
+    }
+    channel_waiter_t* waiter = registration->waiter;
+    channel_registration_t* head = atomic_load(&waiter->ready);
+    do {
+        registration->next_ready = head;
+    } while (!atomic_compare_exchange_weak(&waiter->ready, &head, registration));
+}
+
+// Adds the registration to the channel's waiter list for dir
+// The channel mutex must be held
+static void channel_enqueue_locked(channel_t* channel, enum direction dir, channel_registration_t* registration)
+{
+    list_link(channel->waiters[dir], &registration->link, registration);
+    registration->node = &registration->link;
+    atomic_fetch_add(&channel->waiting[dir], 1);
+}
+
+// Removes a registration from the channel's waiter list for dir
+// The channel mutex must be held
+static void channel_dequeue_locked(channel_t* channel, enum direction dir, list_node_t* node)
+{
+    list_unlink(channel->waiters[dir], node);
+    atomic_fetch_sub(&channel->waiting[dir], 1);
+}
+
+// Wakes up to count of the plain send/receive calls sleeping on the channel's events word for dir
+// count is the number of items or slots that just became available; SIZE_MAX wakes every sleeper (used by close)
+// Costs a single load when nobody sleeps; the seq_cst load pairs with the sleeper's seq_cst increment of parked
+// so that either the sleeper re-checks the channel after the update or the update is followed by a wake here
+static void channel_wake_parked(channel_t* channel, enum direction dir, size_t count)
+{
+    if (atomic_load(&channel->parked[dir]) == 0) {
+        return;
+    }
+    atomic_fetch_add(&channel->events[dir], 1);
+    futex_wake(&channel->events[dir], count);
+}
+
+// Wakes every registered waiter for dir so it re-checks the channel; plain waiters are dequeued (used by close)
+// The channel mutex must be held
+static void channel_wake_all_locked(channel_t* channel, enum direction dir)
+{
+    list_node_t* node = list_head(channel->waiters[dir]);
+    while (node != NULL) {
+        list_node_t* next = list_next(node);
+        channel_registration_t* registration = (channel_registration_t*)list_data(node);
+        channel_waiter_t* waiter = registration->waiter;
+        if (waiter->select) {
+            channel_registration_ready(registration);
+        } else {
+            registration->node = NULL;
+            channel_dequeue_locked(channel, dir, node);
+        }
+        channel_waiter_post(waiter);
+        node = next;
+    }
+}
+
+// Wakes up to count select waiters for dir, oldest first, after count items or slots became available
+// A sleeping select is claimed for the item or slot by moving fired from CHANNEL_WAITER_OPEN to
+// CHANNEL_WAITER_NOTIFIED | case, so the other selects parked on the channel stay asleep
+// A select that is busy re-checking its cases may already have passed this channel, so it is posted to look
+// again, but does not count since it may complete another case; selects already notified are not posted again
+// but still get the case on their ready list, as the item they were notified for may be gone when they look
+// self is the select making the call, if any, which is skipped
+// The channel mutex must be held
+static void channel_notify_locked(channel_t* channel, enum direction dir, size_t count, const channel_waiter_t* self)
+{
+    list_node_t* node = list_head(channel->waiters[dir]);
+    while (node != NULL && count > 0) {
+        channel_registration_t* registration = (channel_registration_t*)list_data(node);
+        channel_waiter_t* waiter = registration->waiter;
+        if (waiter->select && waiter != self) {
+            channel_registration_ready(registration);
+            size_t expected = CHANNEL_WAITER_OPEN;
+            if (atomic_compare_exchange_strong(&waiter->fired, &expected, CHANNEL_WAITER_NOTIFIED | registration->index)) {
+                channel_waiter_post(waiter);
+                count--;
+            } else if (expected == CHANNEL_WAITER_BUSY) {
+                channel_waiter_post(waiter);
+            }
+        }
+        node = list_next(node);
+    }
+}
+
+// Same as channel_notify_locked but called from outside the channel mutex
+// Only takes the mutex if somebody is registered; the seq_cst load pairs with the seq_cst ring updates and
+// waiter registration so a waiter either sees the new item/slot or is seen here
+static void channel_notify(channel_t* channel, enum direction dir, size_t count, const channel_waiter_t* self)
+{
+    if (atomic_load(&channel->waiting[dir]) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    channel_notify_locked(channel, dir, count, self);
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+// Stamps the count items just sent at positions pos and up with the current time (dir == SEND), or records the
+// time the count items about to be released at positions pos and up spent in the channel (dir == RECV)
+// Senders stamp before they publish the slots and receivers record before they release them, so a stamp is
+// always read by the receive that matches its send
+static void channel_sojourn(channel_t* channel, enum direction dir, size_t pos, size_t count)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    size_t mask = channel->buffer->mask;
+    for (size_t i = 0; i < count; i++) {
+        if (dir == SEND) {
+            channel->stamps[(pos + i) & mask] = ns;
+        } else {
+            uint64_t stamp = channel->stamps[(pos + i) & mask];
+            histogram_record(channel->sojourn, (ns > stamp) ? ns - stamp : 0);
+        }
+    }
+}
+
+// Claims up to count consecutive free slots of the lock-free ring with a single CAS and publishes items in them
+// seq has one entry per unit of capacity while the buffer_t slot array is rounded up to a power of two; position
+// pos can only be claimed once pos - capacity was consumed, so all the positions in flight use distinct slots
+// Returns the number of items sent, 0 if the ring is full
+static size_t mpmc_push(channel_t* channel, void** items, size_t count)
+{
+    buffer_t* buffer = channel->buffer;
+    size_t pos = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+    while (true) {
+        intptr_t diff = (intptr_t)atomic_load(&channel->seq[pos % buffer->capacity]) - (intptr_t)pos;
+        if (diff == 0) {
+            size_t n = 1;
+            while (n < count && n < buffer->capacity && atomic_load(&channel->seq[(pos + n) % buffer->capacity]) == pos + n) {
+                n++;
+            }
+            if (atomic_compare_exchange_weak_explicit(&channel->tail, &pos, pos + n, memory_order_relaxed, memory_order_relaxed)) {
+                buffer_write_at(buffer, pos, items, n);
+                if (channel->stamps != NULL) {
+                    channel_sojourn(channel, SEND, pos, n);
+                }
+                for (size_t i = 0; i < n; i++) {
+                    atomic_store(&channel->seq[(pos + i) % buffer->capacity], pos + i + 1);
+                }
+                return n;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// Claims up to max consecutive published slots of the lock-free ring with a single CAS and releases them back to senders
+// Returns the number of items received, 0 if the ring is empty
+static size_t mpmc_pop(channel_t* channel, void** out, size_t max)
+{
+    buffer_t* buffer = channel->buffer;
+    size_t pos = atomic_load_explicit(&channel->head, memory_order_relaxed);
+    while (true) {
+        intptr_t diff = (intptr_t)atomic_load(&channel->seq[pos % buffer->capacity]) - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            size_t n = 1;
+            while (n < max && n < buffer->capacity && atomic_load(&channel->seq[(pos + n) % buffer->capacity]) == pos + n + 1) {
+                n++;
+            }
+            if (atomic_compare_exchange_weak_explicit(&channel->head, &pos, pos + n, memory_order_relaxed, memory_order_relaxed)) {
+                buffer_read_at(buffer, pos, out, n);
+                if (channel->stamps != NULL) {
+                    channel_sojourn(channel, RECV, pos, n);
+                }
+                for (size_t i = 0; i < n; i++) {
+                    atomic_store(&channel->seq[(pos + i) % buffer->capacity], pos + i + buffer->capacity);
+                }
+                return n;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&channel->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Appends up to count items to the single-producer ring; only ever called by the sending thread
+// head is only re-read when the cached copy says there is not enough room
+// Returns the number of items sent, 0 if the ring is full
+static size_t spsc_push(channel_t* channel, void** items, size_t count)
+{
+    buffer_t* buffer = channel->buffer;
+    size_t tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+    size_t space = buffer->capacity - (tail - channel->cached_head);
+    if (space < count) {
+        channel->cached_head = atomic_load(&channel->head);
+        space = buffer->capacity - (tail - channel->cached_head);
+    }
+    size_t n = (count < space) ? count : space;
+    if (n == 0) {
+        return 0;
+    }
+    buffer_write_at(buffer, tail, items, n);
+    if (channel->stamps != NULL) {
+        channel_sojourn(channel, SEND, tail, n);
+    }
+    atomic_store(&channel->tail, tail + n);
+    return n;
+}
+
+// Takes up to max of the oldest items from the single-consumer ring; only ever called by the receiving thread
+// tail is only re-read when the cached copy says there are fewer than max items
+// Returns the number of items received, 0 if the ring is empty
+static size_t spsc_pop(channel_t* channel, void** out, size_t max)
+{
+    buffer_t* buffer = channel->buffer;
+    size_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+    size_t available = channel->cached_tail - head;
+    if (available < max) {
+        channel->cached_tail = atomic_load(&channel->tail);
+        available = channel->cached_tail - head;
+    }
+    size_t n = (max < available) ? max : available;
+    if (n == 0) {
+        return 0;
+    }
+    buffer_read_at(buffer, head, out, n);
+    if (channel->stamps != NULL) {
+        channel_sojourn(channel, RECV, head, n);
+    }
+    atomic_store(&channel->head, head + n);
+    return n;
+}
+
+// Priority levels of a channel; level 0 lives in channel->buffer and levels 1 and up in ring
+// All levels share the channel size, so a freed slot or a new item is good for any waiter, whatever its level
+struct channel_priority {
+    size_t levels;
+    size_t aging; // see channel_options_t.priority_aging
+    size_t queued; // items on all levels
+    uint64_t nonempty; // bit l is set while level l holds items
+    buffer_t* ring[CHANNEL_MAX_PRIORITIES];
+    size_t skipped[CHANNEL_MAX_PRIORITIES]; // receives in a row that passed level l over while it held items
+};
+
+static buffer_t* channel_priority_ring(channel_t* channel, size_t level)
+{
+    return (level == 0) ? channel->buffer : channel->priority->ring[level];
+}
+
+// Queues up to count items at the given level (clamped to the highest one) of a priority channel
+// Returns the number of items queued, limited by the room left in the channel
+// The channel mutex must be held
+static size_t channel_priority_push(channel_t* channel, size_t level, void** items, size_t count)
+{
+    struct channel_priority* priority = channel->priority;
+    if (level >= priority->levels) {
+        level = priority->levels - 1;
+    }
+    size_t room = channel->buffer->capacity - priority->queued;
+    if (count > room) {
+        count = room;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    count = buffer_add_batch(channel_priority_ring(channel, level), items, count);
+    priority->queued += count;
+    priority->nonempty |= UINT64_C(1) << level;
+    return count;
+}
+
+// Picks the level the next receive takes from: the highest non-empty one, unless aging is on and a lower level
+// has been passed over priority_aging times, in which case the highest such level goes first
+// Counts the pass for every other non-empty level
+// The channel mutex must be held and the channel must hold items
+static size_t channel_priority_pick(struct channel_priority* priority)
+{
+    uint64_t nonempty = priority->nonempty;
+    size_t level = (size_t)(63 - __builtin_clzll(nonempty));
+    if (priority->aging == 0) {
+        return level;
+    }
+    for (uint64_t below = nonempty & ((UINT64_C(1) << level) - 1); below != 0; below &= below - 1) {
+        size_t lower = (size_t)__builtin_ctzll(below);
+        if (priority->skipped[lower] >= priority->aging) {
+            // Walking up from the lowest level, so the last aged level found is the highest one
+            level = lower;
+        }
+    }
+    for (uint64_t others = nonempty & ~(UINT64_C(1) << level); others != 0; others &= others - 1) {
+        priority->skipped[__builtin_ctzll(others)]++;
+    }
+    priority->skipped[level] = 0;
+    return level;
+}
+
+// Takes up to max items off a priority channel, one pick per item
+// Returns the number of items taken
+// The channel mutex must be held
+static size_t channel_priority_pop(channel_t* channel, void** out, size_t max)
+{
+    struct channel_priority* priority = channel->priority;
+    size_t count = 0;
+    while (count < max && priority->queued != 0) {
+        size_t level = channel_priority_pick(priority);
+        buffer_t* ring = channel_priority_ring(channel, level);
+        buffer_remove(ring, &out[count]);
+        if (buffer_current_size(ring) == 0) {
+            priority->nonempty &= ~(UINT64_C(1) << level);
+            priority->skipped[level] = 0;
+        }
+        priority->queued--;
+        count++;
+    }
+    return count;
+}
+
+// Creates the rings of the levels above 0 of a channel with the given number of levels (at least 2)
+// Returns NULL if they could not be allocated
+static struct channel_priority* channel_priority_create(size_t levels, size_t aging, size_t size, size_t elem_size)
+{
+    struct channel_priority* priority = (struct channel_priority*)calloc(1, sizeof(struct channel_priority));
+    if (priority == NULL) {
+        return NULL;
+    }
+    priority->levels = levels;
+    priority->aging = aging;
+    for (size_t level = 1; level < levels; level++) {
+        priority->ring[level] = buffer_create_sized(size, elem_size);
+        if (priority->ring[level] == NULL) {
+            while (--level > 0) {
+                buffer_free(priority->ring[level]);
+            }
+            free(priority);
+            return NULL;
+        }
+    }
+    return priority;
+}
+
+static void channel_priority_free(struct channel_priority* priority)
+{
+    if (priority == NULL) {
+        return;
+    }
+    for (size_t level = 1; level < priority->levels; level++) {
+        buffer_free(priority->ring[level]);
+    }
+    free(priority);
+}
+
+// Moves up to count items in or out of a CHANNEL_GROWABLE ring, doubling it (up to max_size) while sends find it
+// full and halving it (down to min_size) once receives leave it at most a quarter full, so a load that hovers
+// around one size does not keep resizing the ring
+// Returns the number of items moved
+// The channel mutex must be held
+static size_t channel_growable_transfer(channel_t* channel, enum direction dir, void** items, size_t count)
+{
+    buffer_t* buffer = channel->buffer;
+    if (dir == SEND) {
+        size_t moved = buffer_add_batch(buffer, items, count);
+        while (moved < count && buffer->capacity < channel->max_size) {
+            size_t capacity = (buffer->capacity > channel->max_size / 2) ? channel->max_size : buffer->capacity * 2;
+            if (buffer_resize(buffer, capacity) != BUFFER_SUCCESS) {
+                break;
+            }
+            moved += buffer_add_batch(buffer, items + moved, count - moved);
+        }
+        return moved;
+    }
+    size_t moved = buffer_remove_batch(buffer, items, count);
+    size_t size = buffer_current_size(buffer);
+    if (buffer->capacity > channel->min_size && size <= buffer->capacity / 4) {
+        size_t capacity = buffer->capacity / 2;
+        // Failing to shrink only costs memory
+        buffer_resize(buffer, (capacity < channel->min_size) ? channel->min_size : capacity);
+    }
+    return moved;
+}
+
+// Moves up to count items in or out of a CHANNEL_UNBOUNDED or CHANNEL_SPILL channel: sends go to the ring while it
+// has room and nothing overflowed, and to the overflow or spill queue otherwise; receives take the ring first, as
+// it holds the oldest items
+// Returns the number of items moved, which for sends is only short of count if memory or disk space ran out
+// The channel mutex must be held
+static size_t channel_unbounded_transfer(channel_t* channel, enum direction dir, void** items, size_t count)
+{
+    spill_queue_t* spill = channel->spill;
+    if (dir == SEND) {
+        size_t moved = 0;
+        if (((spill != NULL) ? spill_queue_size(spill) : chunk_queue_size(channel->overflow)) == 0) {
+            moved = buffer_add_batch(channel->buffer, items, count);
+        }
+        return moved + ((spill != NULL) ? spill_queue_push_batch(spill, items + moved, count - moved)
+                                        : chunk_queue_push_batch(channel->overflow, items + moved, count - moved));
+    }
+    size_t moved = buffer_remove_batch(channel->buffer, items, count);
+    return moved + ((spill != NULL) ? spill_queue_pop_batch(spill, items + moved, count - moved)
+                                    : chunk_queue_pop_batch(channel->overflow, items + moved, count - moved));
+}
+
+// Moves up to count items in (dir == SEND, at level priority of a priority channel) or out (dir == RECV) of the
+// channel storage without any wakeups
+// The channel mutex must be held for CHANNEL_LOCKED
+// Returns the number of items moved
+static size_t channel_transfer(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority)
+{
+    if (channel->priority != NULL) {
+        return (dir == SEND) ? channel_priority_push(channel, priority, items, count) : channel_priority_pop(channel, items, count);
+    }
+    if (channel->growth == CHANNEL_GROWABLE) {
+        return channel_growable_transfer(channel, dir, items, count);
+    }
+    if (channel->growth == CHANNEL_UNBOUNDED || channel->growth == CHANNEL_SPILL) {
+        return channel_unbounded_transfer(channel, dir, items, count);
+    }
+    if (channel->kind == CHANNEL_LOCK_FREE) {
+        return (dir == SEND) ? mpmc_push(channel, items, count) : mpmc_pop(channel, items, count);
+    }
+    if (channel->kind == CHANNEL_SPSC) {
+        return (dir == SEND) ? spsc_push(channel, items, count) : spsc_pop(channel, items, count);
+    }
+    if (channel->stamps != NULL) {
+        size_t pos = (dir == SEND) ? channel->buffer->tail : channel->buffer->head;
+        size_t moved = (dir == SEND) ? buffer_add_batch(channel->buffer, items, count) : buffer_remove_batch(channel->buffer, items, count);
+        channel_sojourn(channel, dir, pos, moved);
+        return moved;
+    }
+    if (count == 1) {
+        if (dir == SEND) {
+            return buffer_add(channel->buffer, *items) == BUFFER_SUCCESS;
+        }
+        return buffer_remove(channel->buffer, items) == BUFFER_SUCCESS;
+    }
+    if (dir == SEND) {
+        return buffer_add_batch(channel->buffer, items, count);
+    }
+    return buffer_remove_batch(channel->buffer, items, count);
+}
+
+#ifdef CHANNEL_STATS
+// Returns the number of items the channel holds
+// The channel mutex must be held on CHANNEL_LOCKED channels; on the lock-free rings receives may be in flight, and
+// CHANNEL_SPSC goes by the sender's last view of head so that counting does not pull in the receiver's cache line
+static size_t channel_depth(channel_t* channel)
+{
+    if (channel->kind == CHANNEL_LOCK_FREE) {
+        size_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+        return atomic_load_explicit(&channel->tail, memory_order_relaxed) - head;
+    }
+    if (channel->kind == CHANNEL_SPSC) {
+        return atomic_load_explicit(&channel->tail, memory_order_relaxed) - channel->cached_head;
+    }
+    if (channel->priority != NULL) {
+        return channel->priority->queued;
+    }
+    size_t depth = buffer_current_size(channel->buffer);
+    if (channel->overflow != NULL) {
+        depth += chunk_queue_size(channel->overflow);
+    }
+    if (channel->spill != NULL) {
+        depth += spill_queue_size(channel->spill);
+    }
+    return depth;
+}
+
+// Counts count items moved in dir and, for sends on buffered channels, the depth they left the channel at
+// The channel mutex must be held on CHANNEL_LOCKED channels, so the item count needs no locked increment
+// The lock-free rings already count their items in tail and head, see channel_get_stats
+static void channel_stats_moved(channel_t* channel, enum direction dir, size_t count)
+{
+    channel_counters_t* counters = &channel->counters[dir];
+    if (channel->kind == CHANNEL_LOCKED) {
+        size_t items = atomic_load_explicit(&counters->items, memory_order_relaxed);
+        atomic_store_explicit(&counters->items, items + count, memory_order_relaxed);
+    }
+    if (dir == SEND && channel->buffer->capacity != 0) {
+        size_t depth = channel_depth(channel);
+        size_t max = atomic_load_explicit(&counters->max_depth, memory_order_relaxed);
+        while (depth > max && !atomic_compare_exchange_weak_explicit(&counters->max_depth, &max, depth, memory_order_relaxed, memory_order_relaxed)) {
+        }
+    }
+}
+
+// Counts a non-blocking call in dir that found the channel full or empty
+static void channel_stats_failure(channel_t* channel, enum direction dir, enum channel_status status)
+{
+    if (status == CHANNEL_EMPTY) {
+        atomic_fetch_add_explicit(&channel->counters[dir].failures, 1, memory_order_relaxed);
+    }
+}
+
+// Stores the time a blocking call starts waiting
+static void channel_stats_start(struct timespec* start)
+{
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+// Counts a blocking call in dir that waited since start
+static void channel_stats_waited(channel_t* channel, enum direction dir, const struct timespec* start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t ns = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000u + (uint64_t)end.tv_nsec - (uint64_t)start->tv_nsec;
+    atomic_fetch_add_explicit(&channel->counters[dir].waits, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&channel->counters[dir].blocked_ns, ns, memory_order_relaxed);
+}
+
+// Counts a select woken for an item or slot of the channel in dir
+static void channel_stats_select_wakeup(channel_t* channel, enum direction dir)
+{
+    atomic_fetch_add_explicit(&channel->counters[dir].select_wakeups, 1, memory_order_relaxed);
+}
+#else
+// Built without CHANNEL_STATS: the counters are compiled out
+static void channel_stats_moved(channel_t* channel, enum direction dir, size_t count)
+{
+    (void)channel, (void)dir, (void)count;
+}
+
+static void channel_stats_failure(channel_t* channel, enum direction dir, enum channel_status status)
+{
+    (void)channel, (void)dir, (void)status;
+}
+
+static void channel_stats_start(struct timespec* start)
+{
+    (void)start;
+}
+
+static void channel_stats_waited(channel_t* channel, enum direction dir, const struct timespec* start)
+{
+    (void)channel, (void)dir, (void)start;
+}
+
+static void channel_stats_select_wakeup(channel_t* channel, enum direction dir)
+{
+    (void)channel, (void)dir;
+}
+#endif
+
+// Copies one message from *from into *to: the void* itself, or elem_size bytes between the memory they point at
+// on sized channels
+static void channel_copy_value(const channel_t* channel, void** to, void** from)
+{
+    if (channel->buffer->elem_size != 0) {
+        memcpy(*to, *from, channel->buffer->elem_size);
+    } else {
+        *to = *from;
+    }
+}
+
+// Opposite direction of dir, i.e. the waiters that a successful dir operation may unblock
+static enum direction channel_peer(enum direction dir)
+{
+    return (dir == SEND) ? RECV : SEND;
+}
+
+// Hands *data straight to (dir == SEND) or takes it from (dir == RECV) the oldest waiter parked on the other side
+// of an unbuffered channel; registrations of self are skipped
+// A waiter is claimed by moving its fired from CHANNEL_WAITER_OPEN to the case index, so a select completes only one case
+// A select that is busy re-checking its cases (or about to) is posted instead, so it looks again once the caller has parked
+// Returns true if the value was handed over
+// The channel mutex must be held
+static bool channel_handoff_locked(channel_t* channel, enum direction dir, void** data, const channel_waiter_t* self)
+{
+    enum direction peer = channel_peer(dir);
+    list_node_t* node = list_head(channel->waiters[peer]);
+    while (node != NULL) {
+        list_node_t* next = list_next(node);
+        channel_registration_t* registration = (channel_registration_t*)list_data(node);
+        channel_waiter_t* waiter = registration->waiter;
+        if (waiter != self) {
+            if (waiter->select) {
+                channel_registration_ready(registration);
+            }
+            size_t expected = CHANNEL_WAITER_OPEN;
+            if (atomic_compare_exchange_strong(&waiter->fired, &expected, registration->index)) {
+                if (dir == SEND) {
+                    channel_copy_value(channel, registration->data, data);
+                } else {
+                    channel_copy_value(channel, data, registration->data);
+                }
+                if (!waiter->select) {
+                    registration->node = NULL;
+                    channel_dequeue_locked(channel, peer, node);
+                }
+                channel_waiter_post(waiter);
+                return true;
+            }
+            if (expected == CHANNEL_WAITER_BUSY || (expected & CHANNEL_WAITER_NOTIFIED) != 0) {
+                channel_waiter_post(waiter);
+            }
+        }
+        node = next;
+    }
+    return false;
+}
+
+// Attempts to send (dir == SEND) or receive (dir == RECV) up to count items, storing the number moved in moved
+// Unbuffered channels move items by handing them to parked waiters other than self
+// Notifies registered peers other than self but leaves the plain calls sleeping on events to the caller, see channel_wake_parked
+// Returns SUCCESS if at least one item was moved, CHANNEL_FULL/CHANNEL_EMPTY if it would block, or CLOSED_ERROR
+// The channel mutex must be held
+static enum channel_status channel_try_locked(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved, const channel_waiter_t* self)
+{
+    if (atomic_load(&channel->closed)) {
+        return CLOSED_ERROR;
+    }
+    if (channel->buffer->capacity == 0) {
+        *moved = 0;
+        while (*moved < count && channel_handoff_locked(channel, dir, items + *moved, self)) {
+            (*moved)++;
+        }
+        if (*moved == 0) {
+            return CHANNEL_EMPTY;
+        }
+        // Every handoff completes the peer's operation as well
+        channel_stats_moved(channel, dir, *moved);
+        channel_stats_moved(channel, channel_peer(dir), *moved);
+        return SUCCESS;
+    }
+    *moved = channel_transfer(channel, dir, items, count, priority);
+    if (*moved == 0) {
+        return CHANNEL_EMPTY;
+    }
+    channel_stats_moved(channel, dir, *moved);
+    channel_notify_locked(channel, channel_peer(dir), *moved, self);
+    return SUCCESS;
+}
+
+// Same as channel_try_locked but takes the mutex itself, or skips it entirely on the lock-free rings
+// Also wakes the plain calls sleeping on the peer's events word, after the mutex has been released
+static enum channel_status channel_try(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved, const channel_waiter_t* self)
+{
+    *moved = 0;
+    if (channel == NULL) {
+        return GEN_ERROR;
+    }
+    if (channel->buffer->elem_size != 0) {
+        // Every message of a sized channel is copied through its pointer
+        for (size_t i = 0; i < count; i++) {
+            if (items[i] == NULL) {
+                return GEN_ERROR;
+            }
+        }
+    }
+    if (channel->kind != CHANNEL_LOCKED) {
+        if (atomic_load(&channel->closed)) {
+            return CLOSED_ERROR;
+        }
+        *moved = channel_transfer(channel, dir, items, count, priority);
+        if (*moved == 0) {
+            return CHANNEL_EMPTY;
+        }
+        channel_stats_moved(channel, dir, *moved);
+        channel_notify(channel, channel_peer(dir), *moved, self);
+        channel_wake_parked(channel, channel_peer(dir), *moved);
+        return SUCCESS;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    enum channel_status status = channel_try_locked(channel, dir, items, count, priority, moved, self);
+    pthread_mutex_unlock(&channel->mutex);
+    if (status == SUCCESS) {
+        channel_wake_parked(channel, channel_peer(dir), *moved);
+    }
+    return status;
+}
+
+// Moves the CHANNEL_WAIT_ADAPTIVE spin budget towards twice the polls a wait needed, or shrinks it if
+// spinning did not help (spins == 0); updates from concurrent waiters may overwrite each other, which is fine
+static void channel_adapt_spin(channel_t* channel, size_t spins)
+{
+    size_t budget = atomic_load_explicit(&channel->spin_budget, memory_order_relaxed);
+    if (spins == 0) {
+        budget -= budget / 4;
+    } else if (2 * spins > budget) {
+        budget += (2 * spins - budget) / 8;
+    } else {
+        budget -= (budget - 2 * spins) / 8;
+    }
+    if (budget < CHANNEL_SPIN_MIN) {
+        budget = CHANNEL_SPIN_MIN;
+    } else if (budget > channel->spin_limit) {
+        budget = channel->spin_limit;
+    }
+    atomic_store_explicit(&channel->spin_budget, budget, memory_order_relaxed);
+}
+
+// Polls the channel according to its wait policy before a blocking call goes to sleep
+// Returns CHANNEL_EMPTY if the call still has to sleep, otherwise the result of the successful channel_try
+static enum channel_status channel_spin(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved)
+{
+    size_t limit = channel->spin_limit;
+    if (channel->wait_policy == CHANNEL_WAIT_ADAPTIVE) {
+        limit = atomic_load_explicit(&channel->spin_budget, memory_order_relaxed);
+    }
+    for (size_t spins = 1; spins <= limit; spins++) {
+        channel_cpu_relax();
+        enum channel_status status = channel_try(channel, dir, items, count, priority, moved, NULL);
+        if (status != CHANNEL_EMPTY) {
+            if (channel->wait_policy == CHANNEL_WAIT_ADAPTIVE) {
+                channel_adapt_spin(channel, spins);
+            }
+            return status;
+        }
+    }
+    if (channel->wait_policy == CHANNEL_WAIT_ADAPTIVE) {
+        channel_adapt_spin(channel, 0);
+    }
+    return CHANNEL_EMPTY;
+}
+
+// Blocking counterpart of channel_try for buffered channels: sleeps on the channel's events word for dir
+// until at least one item can be moved or the deadline (NULL for none) passes
+// The sleeper announces itself in parked and samples events before its last re-check, so a peer that moves
+// an item or slot after that re-check either bumps events before futex_wait compares it or is not needed
+// A sleeper whose deadline passed may have been picked by such a peer, so it re-checks once more before giving up
+static enum channel_status channel_park(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved, const struct timespec* deadline)
+{
+    while (true) {
+        atomic_fetch_add(&channel->parked[dir], 1);
+        unsigned int events = atomic_load(&channel->events[dir]);
+        enum channel_status status = channel_try(channel, dir, items, count, priority, moved, NULL);
+        if (status != CHANNEL_EMPTY) {
+            atomic_fetch_sub(&channel->parked[dir], 1);
+            return status;
+        }
+        bool timed_out = !futex_wait(&channel->events[dir], events, deadline);
+        atomic_fetch_sub(&channel->parked[dir], 1);
+        if (timed_out) {
+            status = channel_try(channel, dir, items, count, priority, moved, NULL);
+            return (status == CHANNEL_EMPTY) ? TIMEOUT : status;
+        }
+    }
+}
+
+// Waits until at least one item can be moved or the deadline (NULL for none) passes, in which case it returns TIMEOUT
+// Buffered channels sleep on the channel's events word, see channel_park
+// Unbuffered channels register the waiter and re-check under the mutex, so a waker can only dequeue a waiter
+// that is committed to sleeping; the peer that dequeues it has already moved the first item for it
+static enum channel_status channel_block(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved, const struct timespec* deadline)
+{
+    enum channel_status status;
+    if (channel->buffer->capacity != 0) {
+        if (channel->spin_limit != 0) {
+            status = channel_spin(channel, dir, items, count, priority, moved);
+            if (status != CHANNEL_EMPTY) {
+                return status;
+            }
+        }
+        return channel_park(channel, dir, items, count, priority, moved, deadline);
+    }
+
+    channel_waiter_t waiter;
+    channel_waiter_init(&waiter, false);
+    channel_registration_t registration;
+    channel_registration_init(&registration, &waiter, 0, items);
+    while (true) {
+        pthread_mutex_lock(&channel->mutex);
+        channel_enqueue_locked(channel, dir, &registration);
+        status = channel_try_locked(channel, dir, items, count, priority, moved, NULL);
+        if (status != CHANNEL_EMPTY) {
+            if (registration.node != NULL) {
+                channel_dequeue_locked(channel, dir, registration.node);
+            }
+            pthread_mutex_unlock(&channel->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&channel->mutex);
+        if (!channel_waiter_park(&waiter, deadline)) {
+            // Still registered means that no peer took the waiter; otherwise the peer completed it or close woke it
+            pthread_mutex_lock(&channel->mutex);
+            bool registered = registration.node != NULL;
+            if (registered) {
+                channel_dequeue_locked(channel, dir, registration.node);
+            }
+            pthread_mutex_unlock(&channel->mutex);
+            if (registered) {
+                status = TIMEOUT;
+                break;
+            }
+        }
+        if (atomic_load(&waiter.fired) != CHANNEL_WAITER_OPEN) {
+            *moved = 1;
+            status = SUCCESS;
+            break;
+        }
+    }
+    return status;
+}
+
+// Blocking counterpart of channel_try: tries once, then waits in channel_block until at least one item can be
+// moved or the deadline (NULL for none) passes, in which case it returns TIMEOUT
+static enum channel_status channel_wait(channel_t* channel, enum direction dir, void** items, size_t count, size_t priority, size_t* moved, const struct timespec* deadline)
+{
+    enum channel_status status = channel_try(channel, dir, items, count, priority, moved, NULL);
+    if (status != CHANNEL_EMPTY) {
+        return status;
+    }
+    struct timespec start;
+    channel_stats_start(&start);
+    status = channel_block(channel, dir, items, count, priority, moved, deadline);
+    channel_stats_waited(channel, dir, &start);
+    return status;
+}
 
 // Creates a new channel with the provided size and returns it to the caller
 // A 0 size indicates an unbuffered channel, whereas a positive size indicates a buffered channel
 channel_t* channel_create(size_t size)
-{   //Create channel object, buffer and initilaze mutex
-    channel_t* channel = (channel_t*)malloc(sizeof(channel_t));
-    channel->buffer = buffer_create(size);
-    channel->size = size;
-    channel->status = 0;
-    channel->sem_select = NULL;
-    //channel->chan_data = NULL;
-    //list_node_t* node = channel->list->head->data;
-    channel->list = list_create(); // may or may not need, currently causing problems with the valgrind tests
-    sem_init(&channel->sem_send, 0, (unsigned int)size);
-    sem_init(&channel->sem_receive, 0, 0);
-    pthread_mutex_init(&(channel->mutex), NULL);
-    //in case memory allocation fails
-    if(channel == NULL)
-    {
+{
+    return channel_create_kind(size, CHANNEL_LOCKED);
+}
+
+// Creates a new channel with the provided size using the given storage backend
+// Unbuffered (0 size) channels always use CHANNEL_LOCKED
+// Returns NULL if the channel could not be allocated
+channel_t* channel_create_kind(size_t size, enum channel_kind kind)
+{
+    channel_options_t options;
+    channel_options_init(&options);
+    options.kind = kind;
+    return channel_create_options(size, &options);
+}
+
+// Creates a new channel with the provided size whose messages are elem_size bytes copied inline into the ring,
+// so senders need not keep their messages alive (or allocate them) until they are received
+// Returns NULL if the channel could not be allocated or elem_size is 0
+channel_t* channel_create_sized(size_t size, size_t elem_size)
+{
+    if (elem_size == 0) {
+        return NULL;
+    }
+    channel_options_t options;
+    channel_options_init(&options);
+    options.elem_size = elem_size;
+    return channel_create_options(size, &options);
+}
+
+// Fills options with the defaults: CHANNEL_LOCKED storage, CHANNEL_WAIT_PARK, void* messages, no message pool,
+// a single priority level, a fixed capacity and no sojourn histogram
+void channel_options_init(channel_options_t* options)
+{
+    options->kind = CHANNEL_LOCKED;
+    options->wait_policy = CHANNEL_WAIT_PARK;
+    options->spin_limit = 0;
+    options->elem_size = 0;
+    options->msg_size = 0;
+    options->priorities = 0;
+    options->priority_aging = 0;
+    options->growth = CHANNEL_FIXED;
+    options->max_size = 0;
+    options->spill_dir = NULL;
+    options->sojourn = false;
+}
+
+// Creates a new channel with the provided size and options
+// Unbuffered (0 size) channels always use CHANNEL_LOCKED and CHANNEL_WAIT_PARK, and so do priority channels and
+// channels that are not CHANNEL_FIXED
+// Returns NULL if the channel could not be allocated, options is NULL or the options do not go together
+channel_t* channel_create_options(size_t size, const channel_options_t* options)
+{
+    if (options == NULL || options->priorities > CHANNEL_MAX_PRIORITIES) {
+        return NULL;
+    }
+    bool prioritized = size != 0 && options->priorities > 1;
+    enum channel_growth growth = (size == 0) ? CHANNEL_FIXED : options->growth;
+    if ((prioritized && growth != CHANNEL_FIXED) || (growth == CHANNEL_GROWABLE && options->max_size < size) ||
+        (growth == CHANNEL_SPILL && options->elem_size == 0) ||
+        (options->sojourn && (prioritized || growth != CHANNEL_FIXED))) {
+        return NULL;
+    }
+    enum channel_kind kind = (prioritized || growth != CHANNEL_FIXED) ? CHANNEL_LOCKED : options->kind;
+    // The ring indices are cache line aligned inside channel_t, so the struct itself has to be too
+    channel_t* channel = (channel_t*)aligned_alloc(CHANNEL_CACHE_LINE, sizeof(channel_t));
+    if (channel == NULL) {
+        return NULL;
+    }
+    channel->kind = (size == 0) ? CHANNEL_LOCKED : kind;
+    channel->wait_policy = (size == 0) ? CHANNEL_WAIT_PARK : options->wait_policy;
+    channel->spin_limit = (options->spin_limit == 0) ? CHANNEL_SPIN_LIMIT : options->spin_limit;
+    // With a single CPU the peer cannot run while we spin, so every wait parks right away
+    if (channel->wait_policy == CHANNEL_WAIT_PARK || sysconf(_SC_NPROCESSORS_ONLN) <= 1) {
+        channel->spin_limit = 0;
+    }
+    channel->buffer = buffer_create_sized(size, options->elem_size);
+    channel->waiters[SEND] = list_create();
+    channel->waiters[RECV] = list_create();
+    channel->pool = (options->msg_size == 0) ? NULL : msg_pool_create(options->msg_size);
+    channel->priority = prioritized ? channel_priority_create(options->priorities, options->priority_aging, size, options->elem_size) : NULL;
+    channel->growth = growth;
+    channel->min_size = size;
+    channel->max_size = (growth == CHANNEL_GROWABLE) ? options->max_size : size;
+    channel->overflow = (growth == CHANNEL_UNBOUNDED) ? chunk_queue_create(options->elem_size) : NULL;
+    channel->spill = (growth == CHANNEL_SPILL) ? spill_queue_create(options->spill_dir, options->elem_size) : NULL;
+    channel->stamps = NULL;
+    if (options->sojourn && size != 0 && channel->buffer != NULL) {
+        channel->stamps = (uint64_t*)malloc(sizeof(uint64_t) * (channel->buffer->mask + 1));
+    }
+    channel->sojourn = options->sojourn ? histogram_create() : NULL;
+    channel->seq = NULL;
+    if (channel->kind == CHANNEL_LOCK_FREE) {
+        channel->seq = (atomic_size_t*)malloc(sizeof(atomic_size_t) * size);
+        if (channel->seq != NULL) {
+            for (size_t i = 0; i < size; i++) {
+                atomic_init(&channel->seq[i], i);
+            }
+        }
+    }
+    if (channel->buffer == NULL || channel->waiters[SEND] == NULL || channel->waiters[RECV] == NULL ||
+        (channel->kind == CHANNEL_LOCK_FREE && channel->seq == NULL) || (options->msg_size != 0 && channel->pool == NULL) ||
+        (prioritized && channel->priority == NULL) || (growth == CHANNEL_UNBOUNDED && channel->overflow == NULL) ||
+        (growth == CHANNEL_SPILL && channel->spill == NULL) ||
+        (options->sojourn && (channel->sojourn == NULL || (size != 0 && channel->stamps == NULL)))) {
+        if (channel->buffer != NULL) {
+            buffer_free(channel->buffer);
+        }
+        if (channel->waiters[SEND] != NULL) {
+            list_destroy(channel->waiters[SEND]);
+        }
+        if (channel->waiters[RECV] != NULL) {
+            list_destroy(channel->waiters[RECV]);
+        }
+        msg_pool_destroy(channel->pool);
+        channel_priority_free(channel->priority);
+        chunk_queue_destroy(channel->overflow);
+        spill_queue_destroy(channel->spill);
+        free(channel->stamps);
+        histogram_destroy(channel->sojourn);
+        free(channel->seq);
+        free(channel);
+        return NULL;
+    }
+    atomic_init(&channel->closed, false);
+    atomic_init(&channel->waiting[SEND], 0);
+    atomic_init(&channel->waiting[RECV], 0);
+    atomic_init(&channel->events[SEND], 0);
+    atomic_init(&channel->events[RECV], 0);
+    atomic_init(&channel->parked[SEND], 0);
+    atomic_init(&channel->parked[RECV], 0);
+    atomic_init(&channel->head, 0);
+    atomic_init(&channel->tail, 0);
+    channel->cached_tail = 0;
+    channel->cached_head = 0;
+    atomic_init(&channel->spin_budget, channel->spin_limit);
+#ifdef CHANNEL_STATS
+    for (size_t dir = 0; dir < 2; dir++) {
+        atomic_init(&channel->counters[dir].items, 0);
+        atomic_init(&channel->counters[dir].failures, 0);
+        atomic_init(&channel->counters[dir].waits, 0);
+        atomic_init(&channel->counters[dir].blocked_ns, 0);
+        atomic_init(&channel->counters[dir].select_wakeups, 0);
+        atomic_init(&channel->counters[dir].max_depth, 0);
+    }
+#endif
+    pthread_mutex_init(&channel->mutex, NULL);
+    return channel;
+}
+
+// Writes data to the given channel
+// This is a blocking call i.e., the function only returns on a successful completion of send
+// In case the channel is full, the function waits till the channel has space to write the new data
+// Returns SUCCESS for successfully writing data to the channel,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send(channel_t *channel, void* data)
+{
+    size_t moved;
+    return channel_wait(channel, SEND, &data, 1, 0, &moved, NULL);
+}
+
+// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
+// This is a blocking call i.e., the function only returns on a successful completion of receive
+// In case the channel is empty, the function waits till the channel has some data to read
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive(channel_t* channel, void** data)
+{
+    if (data == NULL) {
+        return GEN_ERROR;
+    }
+    size_t moved;
+    return channel_wait(channel, RECV, data, 1, 0, &moved, NULL);
+}
+
+// Returns true if deadline is a valid absolute CLOCK_MONOTONIC time
+static bool channel_deadline_valid(const struct timespec* deadline)
+{
+    return deadline != NULL && deadline->tv_sec >= 0 && deadline->tv_nsec >= 0 && deadline->tv_nsec < 1000000000;
+}
+
+// Same as channel_send but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns SUCCESS, CLOSED_ERROR or GEN_ERROR like channel_send, or
+// TIMEOUT if the deadline passed before the data could be sent
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline)
+{
+    if (!channel_deadline_valid(deadline)) {
+        return GEN_ERROR;
+    }
+    size_t moved;
+    return channel_wait(channel, SEND, &data, 1, 0, &moved, deadline);
+}
+
+// Same as channel_receive but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns SUCCESS, CLOSED_ERROR or GEN_ERROR like channel_receive, or
+// TIMEOUT if the deadline passed before any data arrived
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline)
+{
+    if (data == NULL || !channel_deadline_valid(deadline)) {
+        return GEN_ERROR;
+    }
+    size_t moved;
+    return channel_wait(channel, RECV, data, 1, 0, &moved, deadline);
+}
+
+// Writes data to the given channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS for successfully writing data to the channel,
+// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+{
+    size_t moved;
+    enum channel_status status = channel_try(channel, SEND, &data, 1, 0, &moved, NULL);
+    channel_stats_failure(channel, SEND, status);
+    return status;
+}
+
+// Same as channel_send but queues data at the given priority level of a priority channel, where it overtakes
+// every item of the lower levels; levels above the highest one of the channel are clamped to it
+// Plain channels ignore the priority, and channel_send sends at level 0
+enum channel_status channel_send_priority(channel_t* channel, void* data, size_t priority)
+{
+    size_t moved;
+    return channel_wait(channel, SEND, &data, 1, priority, &moved, NULL);
+}
+
+// Same as channel_non_blocking_send at the given priority level, see channel_send_priority
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, size_t priority)
+{
+    size_t moved;
+    enum channel_status status = channel_try(channel, SEND, &data, 1, priority, &moved, NULL);
+    channel_stats_failure(channel, SEND, status);
+    return status;
+}
+
+// Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS for successful retrieval of data,
+// CHANNEL_EMPTY if the channel is empty and nothing was stored in data,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+{
+    if (data == NULL) {
+        return GEN_ERROR;
+    }
+    size_t moved;
+    enum channel_status status = channel_try(channel, RECV, data, 1, 0, &moved, NULL);
+    channel_stats_failure(channel, RECV, status);
+    return status;
+}
+
+// Sends the n items in order, blocking until all of them are in the channel
+// Each round moves as many items as currently fit under one lock or ring reservation and wakes receivers once
+// The number of items actually sent is stored in sent, also when an error is returned
+// Returns SUCCESS once all items were sent,
+// CLOSED_ERROR if the channel is closed before that, and
+// GEN_ERROR if n is 0 or on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t n, size_t* sent)
+{
+    if (channel == NULL || items == NULL || sent == NULL || n == 0) {
+        return GEN_ERROR;
+    }
+    *sent = 0;
+    while (*sent < n) {
+        size_t moved;
+        enum channel_status status = channel_wait(channel, SEND, items + *sent, n - *sent, 0, &moved, NULL);
+        if (status != SUCCESS) {
+            return status;
+        }
+        *sent += moved;
+    }
+    return SUCCESS;
+}
+
+// Receives up to max items in FIFO order into out, blocking until at least one item is available
+// Takes everything available (up to max) under one lock or ring reservation and wakes senders once
+// The number of items received is stored in received
+// Returns SUCCESS if at least one item was received,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* received)
+{
+    if (out == NULL || received == NULL || max == 0) {
+        return GEN_ERROR;
+    }
+    return channel_wait(channel, RECV, out, max, 0, received, NULL);
+}
+
+// Sends as many of the n items, in order, as currently fit in the channel without blocking
+// The number of items sent is stored in sent
+// Returns SUCCESS if at least one item was sent,
+// CHANNEL_FULL if the channel is full and nothing was sent,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send_batch(channel_t* channel, void** items, size_t n, size_t* sent)
+{
+    if (items == NULL || sent == NULL || n == 0) {
+        return GEN_ERROR;
+    }
+    enum channel_status status = channel_try(channel, SEND, items, n, 0, sent, NULL);
+    channel_stats_failure(channel, SEND, status);
+    return status;
+}
+
+// Receives up to max items in FIFO order into out without blocking
+// The number of items received is stored in received
+// Returns SUCCESS if at least one item was received,
+// CHANNEL_EMPTY if the channel is empty and nothing was received,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_receive_batch(channel_t* channel, void** out, size_t max, size_t* received)
+{
+    if (out == NULL || received == NULL || max == 0) {
+        return GEN_ERROR;
+    }
+    enum channel_status status = channel_try(channel, RECV, out, max, 0, received, NULL);
+    channel_stats_failure(channel, RECV, status);
+    return status;
+}
+
+// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
+// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GEN_ERROR in any other error case
+enum channel_status channel_close(channel_t* channel)
+{
+    if (channel == NULL) {
+        return GEN_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (atomic_exchange(&channel->closed, true)) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    channel_wake_all_locked(channel, SEND);
+    channel_wake_all_locked(channel, RECV);
+    pthread_mutex_unlock(&channel->mutex);
+    channel_wake_parked(channel, SEND, SIZE_MAX);
+    channel_wake_parked(channel, RECV, SIZE_MAX);
+    return SUCCESS;
+}
+
+// Frees all the memory allocated to the channel
+// The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
+// Returns SUCCESS if destroy is successful,
+// DESTROY_ERROR if channel_destroy is called on an open channel, and
+// GEN_ERROR in any other error case
+enum channel_status channel_destroy(channel_t* channel)
+{
+    if (channel == NULL) {
+        return GEN_ERROR;
+    }
+    if (!atomic_load(&channel->closed)) {
+        return DESTROY_ERROR;
+    }
+    pthread_mutex_destroy(&channel->mutex);
+    list_destroy(channel->waiters[SEND]);
+    list_destroy(channel->waiters[RECV]);
+    buffer_free(channel->buffer);
+    channel_priority_free(channel->priority);
+    chunk_queue_destroy(channel->overflow);
+    spill_queue_destroy(channel->spill);
+    free(channel->stamps);
+    histogram_destroy(channel->sojourn);
+    msg_pool_destroy(channel->pool);
+    free(channel->seq);
+    free(channel);
+    return SUCCESS;
+}
+
+// Returns the bytes the channel currently holds allocated for queued items: its rings and overflow chunks
+size_t channel_storage_bytes(channel_t* channel)
+{
+    if (channel == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    size_t bytes = buffer_bytes(channel->buffer);
+    if (channel->priority != NULL) {
+        for (size_t level = 1; level < channel->priority->levels; level++) {
+            bytes += buffer_bytes(channel->priority->ring[level]);
+        }
+    }
+    if (channel->overflow != NULL) {
+        bytes += chunk_queue_bytes(channel->overflow);
+    }
+    if (channel->spill != NULL) {
+        bytes += spill_queue_bytes(channel->spill);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return bytes;
+}
+
+// Stores a snapshot of the channel's counters in stats; counters keep running while it is taken, so they may be
+// a few operations apart from each other
+// Returns SUCCESS, or GEN_ERROR if an argument is NULL or the counters were compiled out, in which case stats is zeroed
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats)
+{
+    if (stats == NULL) {
+        return GEN_ERROR;
+    }
+    memset(stats, 0, sizeof(channel_stats_t));
+#ifdef CHANNEL_STATS
+    if (channel == NULL) {
+        return GEN_ERROR;
+    }
+    channel_counters_t* send = &channel->counters[SEND];
+    channel_counters_t* recv = &channel->counters[RECV];
+    stats->sends = atomic_load_explicit(&send->items, memory_order_relaxed);
+    stats->receives = atomic_load_explicit(&recv->items, memory_order_relaxed);
+    if (channel->kind != CHANNEL_LOCKED) {
+        // items holds tail and head as of the last reset
+        stats->sends = atomic_load_explicit(&channel->tail, memory_order_relaxed) - stats->sends;
+        stats->receives = atomic_load_explicit(&channel->head, memory_order_relaxed) - stats->receives;
+    }
+    stats->send_failures = atomic_load_explicit(&send->failures, memory_order_relaxed);
+    stats->receive_failures = atomic_load_explicit(&recv->failures, memory_order_relaxed);
+    stats->send_waits = atomic_load_explicit(&send->waits, memory_order_relaxed);
+    stats->receive_waits = atomic_load_explicit(&recv->waits, memory_order_relaxed);
+    stats->send_blocked_ns = atomic_load_explicit(&send->blocked_ns, memory_order_relaxed);
+    stats->receive_blocked_ns = atomic_load_explicit(&recv->blocked_ns, memory_order_relaxed);
+    stats->max_depth = atomic_load_explicit(&send->max_depth, memory_order_relaxed);
+    stats->select_wakeups = atomic_load_explicit(&send->select_wakeups, memory_order_relaxed) +
+                            atomic_load_explicit(&recv->select_wakeups, memory_order_relaxed);
+    return SUCCESS;
+#else
+    (void)channel;
+    return GEN_ERROR;
+#endif
+}
+
+// Sets all the counters of the channel back to 0
+// Takes the mutex so it does not race with the counters updated under it; updates from the lock-free rings
+// that run at the same time may land before or after the reset
+// Returns SUCCESS, or GEN_ERROR if channel is NULL or the counters were compiled out
+enum channel_status channel_reset_stats(channel_t* channel)
+{
+#ifdef CHANNEL_STATS
+    if (channel == NULL) {
+        return GEN_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    for (size_t dir = 0; dir < 2; dir++) {
+        channel_counters_t* counters = &channel->counters[dir];
+        size_t items = 0;
+        if (channel->kind != CHANNEL_LOCKED) {
+            items = atomic_load_explicit((dir == SEND) ? &channel->tail : &channel->head, memory_order_relaxed);
+        }
+        atomic_store_explicit(&counters->items, items, memory_order_relaxed);
+        atomic_store_explicit(&counters->failures, 0, memory_order_relaxed);
+        atomic_store_explicit(&counters->waits, 0, memory_order_relaxed);
+        atomic_store_explicit(&counters->blocked_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&counters->select_wakeups, 0, memory_order_relaxed);
+        atomic_store_explicit(&counters->max_depth, 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+#else
+    (void)channel;
+    return GEN_ERROR;
+#endif
+}
+
+// Returns the histogram of the nanoseconds items spent in a channel created with options.sojourn, or NULL
+histogram_t* channel_sojourn_histogram(channel_t* channel)
+{
+    return (channel == NULL) ? NULL : channel->sojourn;
+}
+
+// Returns a message of options.msg_size bytes from the channel's message pool, to be sent as a void* on it
+// Returns NULL if the channel has no message pool or no memory is left
+void* channel_msg_alloc(channel_t* channel)
+{
+    if (channel == NULL || channel->pool == NULL) {
         return NULL;
     }
-    return channel;
+    return msg_pool_alloc(channel->pool);
 }
 
-// Writes data to the given channel
-// This is a blocking call i.e., the function only returns on a successful completion of send
-// In case the channel is full, the function waits till the channel has space to write the new data
-// Returns SUCCESS for successfully writing data to the channel,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
-enum channel_status channel_send(channel_t *channel, void* data)
+// Gives a message of channel_msg_alloc back to the channel's message pool; does nothing if msg is NULL
+void channel_msg_release(channel_t* channel, void* msg)
 {
-    //sem_post(&channel->sem_select);
-    if(channel == NULL)//channel shouldn't have nothing
-    {
-        return GEN_ERROR;
+    if (channel == NULL || channel->pool == NULL) {
+        return;
     }
-    //Need mutex in case of multiple thread access
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    
-    if(channel->status == -2)// check if channel is closed
-    {
-        pthread_mutex_unlock(&channel->mutex);
-        return CLOSED_ERROR;
+    msg_pool_release(channel->pool, msg);
+}
+
+// Tries one select case once, skipping unbuffered peers that belong to self
+static enum channel_status channel_select_case(select_t* entry, const channel_waiter_t* self)
+{
+    // Receive into a temporary so a failed attempt leaves the caller's data untouched
+    void* data = entry->data;
+    size_t moved;
+    enum channel_status status = channel_try(entry->channel, entry->dir, &data, 1, entry->priority, &moved, self);
+    if (status == SUCCESS) {
+        entry->data = data;
     }
-    pthread_mutex_unlock(&channel->mutex);
+    return status;
+}
 
-    sem_wait(&channel->sem_send);// need to wait
-    
-    pthread_mutex_lock(&channel->mutex);// lock before adding to share memory
-    if(channel->status == -2)// check if currenct channel is closed
-    {
-        //chain effect
-        pthread_mutex_unlock(&channel->mutex);
-        sem_post(&channel->sem_send);//need to wait up every other thread 
-        //sem_post(&channel->sem_select);
-        return CLOSED_ERROR;
+// Returns a random number below bound (which must not be 0) from the generator state in seed
+static size_t channel_random(unsigned int* seed, size_t bound)
+{
+    size_t value = (size_t)rand_r(seed);
+    if (bound > RAND_MAX) {
+        value = (value << 31) | (size_t)rand_r(seed);
+    }
+    return value % bound;
+}
+
+// Picks the case a select with the given options starts at; the cases are tried in cyclic order from there
+// SELECT_WEIGHTED selects only go in cyclic order while registering, from a random case
+static size_t channel_select_start(select_options_t* options, size_t channel_count)
+{
+    if (options == NULL || channel_count == 0) {
+        return 0;
+    }
+    switch (options->policy) {
+    case SELECT_RANDOM:
+    case SELECT_WEIGHTED:
+        return channel_random(&options->seed, channel_count);
+    case SELECT_ROUND_ROBIN:
+        return options->cursor % channel_count;
+    default:
+        return 0;
+    }
+}
+
+static bool channel_select_weighted(const select_options_t* options)
+{
+    return options != NULL && options->policy == SELECT_WEIGHTED;
+}
+
+// Tries the *count cases listed in cases in weighted random order, taking each case of channel_list (or of entries,
+// if not NULL) from its index
+// Every draw picks one of the cases not tried yet in proportion to its weight, and a case that would block is
+// dropped from the draws, so each case that can proceed wins with its share of the total weight of those cases,
+// however much weight the blocked cases have; cases of weight 0 are drawn evenly once no weighted case is left
+// Leaves the cases that were not found blocked, including the one that proceeded, in the first *count of cases
+// Returns CHANNEL_EMPTY if none of them could proceed, otherwise the status of the case that did
+static enum channel_status channel_select_draw(select_t* channel_list, select_t** entries, size_t* cases, size_t* count, unsigned int* seed, const channel_waiter_t* self, size_t* selected_index)
+{
+    size_t total = 0;
+    for (size_t k = 0; k < *count; k++) {
+        total += (entries != NULL) ? entries[cases[k]]->weight : channel_list[cases[k]].weight;
     }
-    buffer_add(channel->buffer, data);
-    sem_post(&channel->sem_receive);//increment recieve to keep track of the number of messages
-    //sem_post(&channel->sem_select);
-    if(channel->sem_select != NULL)
-    {
-       list_node_t* node = channel->list->head;
-       while(node) {
-            sem_post(node->data);
-            node = node->next;
+    while (*count > 0) {
+        size_t k = 0;
+        if (total == 0) {
+            k = channel_random(seed, *count);
+        } else {
+            size_t pick = channel_random(seed, total);
+            while (true) {
+                unsigned int weight = (entries != NULL) ? entries[cases[k]]->weight : channel_list[cases[k]].weight;
+                if (pick < weight) {
+                    break;
+                }
+                pick -= weight;
+                k++;
             }
-        
+        }
+        size_t i = cases[k];
+        select_t* entry = (entries != NULL) ? entries[i] : &channel_list[i];
+        enum channel_status status = channel_select_case(entry, self);
+        if (status != CHANNEL_EMPTY) {
+            *selected_index = i;
+            return status;
+        }
+        total -= entry->weight;
+        cases[k] = cases[--*count];
     }
-    pthread_mutex_unlock(&channel->mutex);//unlock after
-    return SUCCESS;
+    return CHANNEL_EMPTY;
+}
 
+// Tries every case of the select list once, in cyclic order from case start
+// Returns CHANNEL_EMPTY if none of them could proceed, otherwise the status of the first case that did
+static enum channel_status channel_select_try(select_t* channel_list, size_t channel_count, size_t start, size_t* selected_index)
+{
+    for (size_t k = 0; k < channel_count; k++) {
+        size_t i = (start + k) % channel_count;
+        enum channel_status status = channel_select_case(&channel_list[i], NULL);
+        if (status != CHANNEL_EMPTY) {
+            *selected_index = i;
+            return status;
+        }
+    }
+    return CHANNEL_EMPTY;
 }
 
-// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
-// This is a blocking call i.e., the function only returns on a successful completion of receive
-// In case the channel is empty, the function waits till the channel has some data to read
-// Returns SUCCESS for successful retrieval of data,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
-enum channel_status channel_receive(channel_t* channel, void** data)
+static int channel_compare_index(const void* a, const void* b)
 {
-    //sem_post(&channel->sem_select);
-    if(channel == NULL)//channel shouldn't have nothing
-    {
-        return GEN_ERROR;
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Empties the waiter's ready list into cases, lowest index first, and returns the number of cases
+// The cases are taken off the list before they are tried, so a channel that becomes ready again pushes them back
+static size_t channel_take_ready(channel_waiter_t* waiter, size_t* cases)
+{
+    size_t count = 0;
+    channel_registration_t* registration = atomic_exchange(&waiter->ready, NULL);
+    while (registration != NULL) {
+        channel_registration_t* next = registration->next_ready;
+        atomic_store(&registration->queued, false);
+        cases[count++] = registration->index;
+        registration = next;
+    }
+    if (count > 1) {
+        qsort(cases, count, sizeof(size_t), channel_compare_index);
+    }
+    return count;
+}
+
+// Returns the position of the first of the count sorted cases that is at least start, i.e. where a cyclic walk
+// from case start begins, or 0 if there is none
+static size_t channel_ready_start(const size_t* cases, size_t count, size_t start)
+{
+    size_t first = 0;
+    while (first < count && cases[first] < start) {
+        first++;
+    }
+    return (first == count) ? 0 : first;
+}
+
+// Takes the waiter's ready list and tries those cases once, in cyclic order from case start (or drawn by weight for
+// SELECT_WEIGHTED options), using cases as scratch space
+// Returns CHANNEL_EMPTY if none of them could proceed, otherwise the status of the first case that did
+static enum channel_status channel_select_ready(select_t* channel_list, channel_waiter_t* waiter, size_t* cases, size_t start, select_options_t* options, size_t* selected_index)
+{
+    size_t count = channel_take_ready(waiter, cases);
+    if (channel_select_weighted(options)) {
+        return channel_select_draw(channel_list, NULL, cases, &count, &options->seed, waiter, selected_index);
+    }
+    size_t first = channel_ready_start(cases, count, start);
+    for (size_t k = 0; k < count; k++) {
+        size_t i = cases[(first + k) % count];
+        enum channel_status status = channel_select_case(&channel_list[i], waiter);
+        if (status != CHANNEL_EMPTY) {
+            *selected_index = i;
+            return status;
+        }
+    }
+    return CHANNEL_EMPTY;
+}
+
+// Marks a registered select waiter as busy so no unbuffered peer completes one of its cases behind its back
+// If a buffered channel notified the waiter, its case is stored in notified
+// Returns false and stores the case in selected_index if a peer already completed one
+static bool channel_select_claim(channel_waiter_t* waiter, size_t* selected_index, size_t* notified)
+{
+    size_t expected = atomic_load(&waiter->fired);
+    while (expected == CHANNEL_WAITER_OPEN || (expected & CHANNEL_WAITER_NOTIFIED) != 0) {
+        if (atomic_compare_exchange_weak(&waiter->fired, &expected, CHANNEL_WAITER_BUSY)) {
+            if (expected != CHANNEL_WAITER_OPEN) {
+                *notified = expected & ~CHANNEL_WAITER_NOTIFIED;
+            }
+            return true;
+        }
     }
-    //Need mutex in case of multiple thread access
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    
-    if(channel->status == -2)// check if channel is closed
-    {
+    *selected_index = expected;
+    return false;
+}
+
+// Registers a select case on its channel and tries it once, like channel_select_case
+// Locked channels are tried under the same mutex hold as the registration, so registering a case costs one lock
+// round trip instead of two; the lock-free rings are tried after the registration, without the mutex
+static enum channel_status channel_select_register(select_t* entry, channel_registration_t* registration)
+{
+    channel_t* channel = entry->channel;
+    pthread_mutex_lock(&channel->mutex);
+    channel_enqueue_locked(channel, entry->dir, registration);
+    if (channel->kind != CHANNEL_LOCKED || (channel->buffer->elem_size != 0 && entry->data == NULL)) {
         pthread_mutex_unlock(&channel->mutex);
-        return CLOSED_ERROR;
+        return channel_select_case(entry, registration->waiter);
     }
+    void* data = entry->data;
+    size_t moved;
+    enum channel_status status = channel_try_locked(channel, entry->dir, &data, 1, entry->priority, &moved, registration->waiter);
     pthread_mutex_unlock(&channel->mutex);
+    if (status == SUCCESS) {
+        entry->data = data;
+        channel_wake_parked(channel, channel_peer(entry->dir), moved);
+    }
+    return status;
+}
 
-    sem_wait(&channel->sem_receive);// need to wait
-    
-    pthread_mutex_lock(&channel->mutex);// lock before adding to share memory
-    if(channel->status == -2)// check if currenct channel is closed
-    {
-        //chain effect
-        pthread_mutex_unlock(&channel->mutex);
-        sem_post(&channel->sem_receive);
-        //sem_post(&channel->sem_select);
-        return CLOSED_ERROR;
+// The waiter of a blocking select with its registrations and the scratch space for its ready cases, one of each per case
+// channel_select and friends keep one on the stack with room for CHANNEL_SELECT_STACK_CASES cases, and callers of
+// channel_select_with keep one between calls, so a select that fits allocates nothing
+// Registrations are tied to the waiter and to their case index once, the first time a select has that many cases;
+// every select only points them at the data of its own cases
+struct select_waiter {
+    channel_waiter_t waiter;
+    size_t capacity;
+    size_t initialized; // registrations tied to the waiter, from index 0
+    channel_registration_t* registrations;
+    size_t* cases;
+    bool allocated; // registrations and cases share one allocation of the waiter
+};
+
+static void select_waiter_init(select_waiter_t* waiter, channel_registration_t* registrations, size_t* cases, size_t capacity)
+{
+    channel_waiter_init(&waiter->waiter, true);
+    waiter->capacity = capacity;
+    waiter->initialized = 0;
+    waiter->registrations = registrations;
+    waiter->cases = cases;
+    waiter->allocated = false;
+}
+
+// Makes room for count cases in the waiter, at least doubling its room when it has to grow
+// Returns false if the room could not be allocated
+static bool select_waiter_reserve(select_waiter_t* waiter, size_t count)
+{
+    if (count > waiter->capacity) {
+        size_t capacity = (count > 2 * waiter->capacity) ? count : 2 * waiter->capacity;
+        channel_registration_t* registrations = (channel_registration_t*)malloc((sizeof(channel_registration_t) + sizeof(size_t)) * capacity);
+        if (registrations == NULL) {
+            return false;
+        }
+        if (waiter->allocated) {
+            free(waiter->registrations);
+        }
+        waiter->registrations = registrations;
+        waiter->cases = (size_t*)(registrations + capacity);
+        waiter->capacity = capacity;
+        waiter->initialized = 0;
+        waiter->allocated = true;
     }
-    buffer_remove(channel->buffer, data);
-    sem_post(&channel->sem_send);// keep track of open slots
-    //sem_post(*&channel->sem_select);
-    if(channel->sem_select != NULL)
-    {
-       list_node_t* node = channel->list->head;
-       while(node) {
-            sem_post(node->data);
-            node = node->next;
-            }
-        
+    while (waiter->initialized < count) {
+        channel_registration_init(&waiter->registrations[waiter->initialized], &waiter->waiter, waiter->initialized, NULL);
+        waiter->initialized++;
     }
-    pthread_mutex_unlock(&channel->mutex);//unlock after
-    return SUCCESS;
+    return true;
 }
 
-// Writes data to the given channel
-// This is a non-blocking call i.e., the function simply returns if the channel is full
-// Returns SUCCESS for successfully writing data to the channel,
-// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+static void select_waiter_free(select_waiter_t* waiter)
+{
+    if (waiter->allocated) {
+        free(waiter->registrations);
+    }
+}
+
+// Blocks until one of the cases can proceed and performs it, trying the cases in the order of options->policy
+// (SELECT_FIRST for NULL options)
+// Registers with select_waiter, which must not be in use by another select
+// Gives up with TIMEOUT once the deadline (NULL for none) has passed, leaving selected_index alone
+// The body of channel_select_options, channel_select_until and channel_select_with
+static enum channel_status channel_select_from(select_waiter_t* select_waiter, select_t* channel_list, size_t channel_count, select_options_t* options, size_t* selected_index, const struct timespec* deadline)
 {
-    //void* local_pointer = &data;
-    //sem_post(&channel->sem_select);
-    if(channel == NULL)//channel shouldn't have nothing
-    {
+    size_t start = channel_select_start(options, channel_count);
+    enum channel_status status;
+    if (channel_select_weighted(options)) {
+        // The draws need scratch space for every case before anything is registered
+        if (!select_waiter_reserve(select_waiter, channel_count)) {
+            return GEN_ERROR;
+        }
+        size_t count = channel_count;
+        for (size_t i = 0; i < count; i++) {
+            select_waiter->cases[i] = i;
+        }
+        status = channel_select_draw(channel_list, NULL, select_waiter->cases, &count, &options->seed, NULL, selected_index);
+    } else {
+        status = channel_select_try(channel_list, channel_count, start, selected_index);
+    }
+    if (status != CHANNEL_EMPTY) {
+        return status;
+    }
+
+    // Nothing is ready: register on the channels one by one, checking each case right after its registration
+    if (!select_waiter_reserve(select_waiter, channel_count)) {
         return GEN_ERROR;
     }
-    //Basically same as send but without waiting 
-    //Need mutex in case of multiple thread access
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    
-    if(channel->status == -2)// check if channel is closed
-    {
-        pthread_mutex_unlock(&channel->mutex);
-        return CLOSED_ERROR;
+    channel_registration_t* registrations = select_waiter->registrations;
+    size_t* cases = select_waiter->cases;
+    channel_waiter_t* waiter = &select_waiter->waiter;
+    // Busy while registering, so unbuffered peers cannot complete a case and only push it on the ready list
+    atomic_store(&waiter->state, CHANNEL_WAITER_IDLE);
+    atomic_store(&waiter->fired, CHANNEL_WAITER_BUSY);
+    size_t registered = 0;
+    while (registered < channel_count && status == CHANNEL_EMPTY) {
+        size_t i = (start + registered) % channel_count;
+        registrations[i].data = &channel_list[i].data;
+        status = channel_select_register(&channel_list[i], &registrations[i]);
+        if (status != CHANNEL_EMPTY) {
+            *selected_index = i;
+        }
+        registered++;
     }
-    pthread_mutex_unlock(&channel->mutex);
 
-    
-    int trywait = sem_trywait(&channel->sem_send);// need to wait
-    
-    if(trywait == 0)
-    {
-    pthread_mutex_lock(&channel->mutex);// lock before adding to share memory
-    //sem_post(channel->sem_select);
-    buffer_add(channel->buffer, data);
-    sem_post(&channel->sem_receive);//increment recieve to keep track of the number of messages
-   if(channel->sem_select != NULL)
-    {
-       list_node_t* node = channel->list->head;
-       while(node) {
-            sem_post(node->data);
-            node = node->next;
-            }
-        
+    // From now on only the cases whose channels pushed them on the ready list need another look
+    // Once the deadline has passed the waiter is claimed back and the ready cases get one last look
+    size_t notified = CHANNEL_WAITER_OPEN;
+    bool timed_out = false;
+    while (status == CHANNEL_EMPTY) {
+        status = channel_select_ready(channel_list, waiter, cases, start, options, selected_index);
+        if (status != CHANNEL_EMPTY) {
+            break;
+        }
+        if (timed_out) {
+            status = TIMEOUT;
+            break;
+        }
+        // The item or slot we were notified for has been taken by somebody else
+        notified = CHANNEL_WAITER_OPEN;
+        atomic_store(&waiter->fired, CHANNEL_WAITER_OPEN);
+        timed_out = !channel_waiter_park(waiter, deadline);
+        if (!channel_select_claim(waiter, selected_index, &notified)) {
+            channel_stats_select_wakeup(channel_list[*selected_index].channel, channel_list[*selected_index].dir);
+            status = SUCCESS;
+        } else if (notified != CHANNEL_WAITER_OPEN) {
+            channel_stats_select_wakeup(channel_list[notified].channel, channel_list[notified].dir);
+        }
+    }
+    if (status != TIMEOUT && atomic_load(&waiter->fired) == CHANNEL_WAITER_BUSY) {
+        atomic_store(&waiter->fired, *selected_index);
     }
-    //sem_post(channel->sem_select);
 
-    pthread_mutex_unlock(&channel->mutex);//unlock after
+    // Peers only touch the waiter under the mutex of a channel it is registered on, so it is unused after this
+    for (size_t k = 0; k < registered; k++) {
+        size_t i = (start + k) % channel_count;
+        channel_t* channel = channel_list[i].channel;
+        pthread_mutex_lock(&channel->mutex);
+        channel_dequeue_locked(channel, channel_list[i].dir, registrations[i].node);
+        pthread_mutex_unlock(&channel->mutex);
     }
-    else {
-        return CHANNEL_FULL;
+    // Channels may have pushed cases on the ready list that were never taken off; clear it for the next select
+    channel_registration_t* registration = atomic_exchange(&waiter->ready, NULL);
+    while (registration != NULL) {
+        atomic_store(&registration->queued, false);
+        registration = registration->next_ready;
     }
-    
-    return SUCCESS;
+    // We were woken for an item or slot that we did not take, so hand the wakeup to the next select in line
+    if (notified != CHANNEL_WAITER_OPEN && (status == TIMEOUT || notified != *selected_index)) {
+        channel_notify(channel_list[notified].channel, channel_list[notified].dir, 1, NULL);
+    }
+    return status;
+}
 
+// Runs channel_select_from with a select waiter on the stack, which only allocates for more than
+// CHANNEL_SELECT_STACK_CASES cases
+static enum channel_status channel_select_local(select_t* channel_list, size_t channel_count, select_options_t* options, size_t* selected_index, const struct timespec* deadline)
+{
+    channel_registration_t registrations[CHANNEL_SELECT_STACK_CASES];
+    size_t cases[CHANNEL_SELECT_STACK_CASES];
+    select_waiter_t waiter;
+    select_waiter_init(&waiter, registrations, cases, CHANNEL_SELECT_STACK_CASES);
+    enum channel_status status = channel_select_from(&waiter, channel_list, channel_count, options, selected_index, deadline);
+    select_waiter_free(&waiter);
+    return status;
 }
 
-// Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
-// This is a non-blocking call i.e., the function simply returns if the channel is empty
-// Returns SUCCESS for successful retrieval of data,
-// CHANNEL_EMPTY if the channel is empty and nothing was stored in data,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
+// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
+// If multiple options are available, it selects the first option and performs its corresponding action
+// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
+// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
+// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
+// Additionally, selected_index is set to the index of the channel that generated the error
+enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
 {
-    //data = &channel->chan_data;//Data is set equal to the respective channel in sem select
-     //Need mutex in case of multiple thread access
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    if(channel == NULL)//channel shouldn't have nothing
-    {
-        pthread_mutex_unlock(&channel->mutex);
+    return channel_select_options(channel_list, channel_count, selected_index, NULL);
+}
+
+// Same as channel_select but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns the same as channel_select, or TIMEOUT without touching selected_index if the deadline passed before
+// any case could proceed
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline)
+{
+    if (channel_list == NULL || selected_index == NULL || !channel_deadline_valid(deadline)) {
         return GEN_ERROR;
     }
+    return channel_select_local(channel_list, channel_count, NULL, selected_index, deadline);
+}
 
-    if(channel->status == -2)// check if channel is closed
-    {
-        pthread_mutex_unlock(&channel->mutex);
-        return CLOSED_ERROR;
+// Same as channel_select but never blocks, like a Go select with a default case
+// Tries every case once, in order, without registering on any channel
+// Returns SUCCESS and sets selected_index if a case was performed,
+// CHANNEL_EMPTY if none of the cases could proceed,
+// CLOSED_ERROR and sets selected_index if a closed channel comes before any case that can proceed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_try_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    if (channel_list == NULL || selected_index == NULL) {
+        return GEN_ERROR;
     }
-    pthread_mutex_unlock(&channel->mutex);
+    return channel_select_try(channel_list, channel_count, 0, selected_index);
+}
 
-    int trywait = sem_trywait(&channel->sem_receive);// need to wait
-
-    if(trywait == 0)
-    {
-    pthread_mutex_lock(&channel->mutex);// lock before adding to share memory
-    buffer_remove(channel->buffer, data);
-    if(channel->sem_select != NULL)
-    {
-       list_node_t* node = channel->list->head;
-       while(node) {
-            sem_post(node->data);
-            node = node->next;
-            }
-        
+// Fills options with the defaults: SELECT_FIRST, a zero cursor and a seed that differs between calls
+void select_options_init(select_options_t* options)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    options->policy = SELECT_FIRST;
+    options->cursor = 0;
+    options->seed = (unsigned int)now.tv_nsec ^ (unsigned int)(uintptr_t)options;
+}
+
+// The body of channel_select_options and channel_select_with, with a select waiter on the stack if waiter is NULL
+static enum channel_status channel_select_policy(select_waiter_t* waiter, select_t* channel_list, size_t channel_count, size_t* selected_index, select_options_t* options)
+{
+    enum channel_status status;
+    if (waiter == NULL) {
+        status = channel_select_local(channel_list, channel_count, options, selected_index, NULL);
+    } else {
+        status = channel_select_from(waiter, channel_list, channel_count, options, selected_index, NULL);
     }
-    sem_post(&channel->sem_send);// keep track of open slots
-    //sem_post(channel->sem_select);
-    pthread_mutex_unlock(&channel->mutex);//unlock after
+    if (options != NULL && (status == SUCCESS || status == CLOSED_ERROR)) {
+        options->cursor = *selected_index + 1;
     }
-    else {
-        return CHANNEL_EMPTY;
+    return status;
+}
+
+// Same as channel_select but tries the cases in the order given by options->policy
+// options is updated by the call (round-robin cursor and random state), so each thread needs its own
+// NULL options behave like SELECT_FIRST
+enum channel_status channel_select_options(select_t* channel_list, size_t channel_count, size_t* selected_index, select_options_t* options)
+{
+    if (channel_list == NULL || selected_index == NULL) {
+        return GEN_ERROR;
     }
-    return SUCCESS;
+    return channel_select_policy(NULL, channel_list, channel_count, selected_index, options);
+}
 
+// Creates an empty select waiter
+// Returns NULL if it could not be allocated
+select_waiter_t* select_waiter_create(void)
+{
+    select_waiter_t* waiter = (select_waiter_t*)malloc(sizeof(select_waiter_t));
+    if (waiter == NULL) {
+        return NULL;
+    }
+    select_waiter_init(waiter, NULL, NULL, 0);
+    return waiter;
 }
 
-// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
-// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
-// Returns SUCCESS if close is successful,
-// CLOSED_ERROR if the channel is already closed, and
-// GEN_ERROR in any other error case
-enum channel_status channel_close(channel_t* channel)
+// Same as channel_select_options but keeps the registrations in waiter, so selects on as many cases as an earlier
+// call on the same waiter allocate nothing
+// Returns the same as channel_select_options
+enum channel_status channel_select_with(select_waiter_t* waiter, select_t* channel_list, size_t channel_count, size_t* selected_index, select_options_t* options)
 {
-    
-    //channel->thread_num++; // inspired by barrier example, should count the amount of threads that call this function
-    //int count = 0;
-    if(channel == NULL)//channel shouldn't have nothing
-    {
+    if (waiter == NULL || channel_list == NULL || selected_index == NULL) {
         return GEN_ERROR;
     }
+    return channel_select_policy(waiter, channel_list, channel_count, selected_index, options);
+}
 
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    if(channel->status == -2)// check if channel is closed
-    {
-        pthread_mutex_unlock(&channel->mutex);
-        return CLOSED_ERROR;
+// Frees the waiter; does nothing if waiter is NULL
+void select_waiter_destroy(select_waiter_t* waiter)
+{
+    if (waiter == NULL) {
+        return;
     }
-    pthread_mutex_unlock(&channel->mutex); 
-    
-    pthread_mutex_lock(&channel->mutex);
-    channel->status = -2;
-    //sem_post(*&channel->sem_select);
-    sem_post(&channel->sem_send);
-    sem_post(&channel->sem_receive);
-    //sem_post(channel->sem_select);
-    if(channel->sem_select != NULL)
-    {
-       list_node_t* node = channel->list->head;
-       while(node) {
-            sem_post(node->data);
-            node = node->next;
-            }
-        
+    select_waiter_free(waiter);
+    free(waiter);
+}
+
+// A select waiter that stays registered on its channels between waits, see select_set_create
+// Between waits fired stays CHANNEL_WAITER_BUSY, so channels only push their cases on the ready list and
+// unbuffered peers never complete a case while nobody is waiting
+// The ready list is level-triggered: a case that completed, or that was taken off the list but not tried,
+// is pushed back since its channel may still be ready; a case that was tried and would block is dropped
+struct select_set {
+    channel_waiter_t waiter;
+    size_t capacity;
+    select_t** entries; // caller's case of each slot, NULL for free slots
+    bool* enabled; // registered on the channel of its case
+    size_t enabled_count;
+    channel_registration_t* registrations;
+    size_t* cases; // scratch space for the ready cases
+    select_options_t options;
+};
+
+// Creates an empty select set with room for capacity cases
+// Returns NULL if the set could not be allocated
+select_set_t* select_set_create(size_t capacity)
+{
+    select_set_t* set = (select_set_t*)malloc(sizeof(select_set_t));
+    if (set == NULL) {
+        return NULL;
     }
-    pthread_mutex_unlock(&channel->mutex);
+    set->entries = (select_t**)calloc(capacity, sizeof(select_t*));
+    set->enabled = (bool*)calloc(capacity, sizeof(bool));
+    set->registrations = (channel_registration_t*)malloc(sizeof(channel_registration_t) * capacity);
+    set->cases = (size_t*)malloc(sizeof(size_t) * capacity);
+    if ((set->entries == NULL || set->enabled == NULL || set->registrations == NULL || set->cases == NULL) && capacity > 0) {
+        free(set->entries);
+        free(set->enabled);
+        free(set->registrations);
+        free(set->cases);
+        free(set);
+        return NULL;
+    }
+    set->capacity = capacity;
+    set->enabled_count = 0;
+    select_options_init(&set->options);
+    channel_waiter_init(&set->waiter, true);
+    atomic_store(&set->waiter.fired, CHANNEL_WAITER_BUSY);
+    // A slot may still be on the ready list after its case was removed, so slots are only initialized once
+    for (size_t i = 0; i < capacity; i++) {
+        channel_registration_init(&set->registrations[i], &set->waiter, i, NULL);
+    }
+    return set;
+}
+
+// Registers slot index on the channel of its case and marks it as possibly ready
+static void select_set_register(select_set_t* set, size_t index)
+{
+    select_t* entry = set->entries[index];
+    channel_registration_t* registration = &set->registrations[index];
+    pthread_mutex_lock(&entry->channel->mutex);
+    channel_enqueue_locked(entry->channel, entry->dir, registration);
+    pthread_mutex_unlock(&entry->channel->mutex);
+    set->enabled[index] = true;
+    set->enabled_count++;
+    channel_registration_ready(registration);
+}
+
+static void select_set_unregister(select_set_t* set, size_t index)
+{
+    select_t* entry = set->entries[index];
+    pthread_mutex_lock(&entry->channel->mutex);
+    channel_dequeue_locked(entry->channel, entry->dir, set->registrations[index].node);
+    pthread_mutex_unlock(&entry->channel->mutex);
+    set->registrations[index].node = NULL;
+    set->enabled[index] = false;
+    set->enabled_count--;
+}
+
+// Adds entry as an enabled case of the set and stores its index in index, the lowest free one
+// The set keeps using entry, which must stay valid until the case is removed or the set is destroyed
+// Returns SUCCESS if the case was added, or GEN_ERROR if the set is full or the arguments are invalid
+enum channel_status select_set_add(select_set_t* set, select_t* entry, size_t* index)
+{
+    if (set == NULL || entry == NULL || entry->channel == NULL || index == NULL) {
+        return GEN_ERROR;
+    }
+    size_t slot = 0;
+    while (slot < set->capacity && set->entries[slot] != NULL) {
+        slot++;
+    }
+    if (slot == set->capacity) {
+        return GEN_ERROR;
+    }
+    set->entries[slot] = entry;
+    set->registrations[slot].data = &entry->data;
+    select_set_register(set, slot);
+    *index = slot;
     return SUCCESS;
 }
 
-// Frees all the memory allocated to the channel
-// The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
-// Returns SUCCESS if destroy is successful,
-// DESTROY_ERROR if channel_destroy is called on an open channel, and
-// GEN_ERROR in any other error case
-enum channel_status channel_destroy(channel_t* channel)
+// Removes case index from the set, freeing its index for later adds
+// Returns SUCCESS if the case was removed, or GEN_ERROR if there is no such case
+enum channel_status select_set_remove(select_set_t* set, size_t index)
 {
-    if(channel == NULL)//channel shouldn't have nothing
-    {
+    if (set == NULL || index >= set->capacity || set->entries[index] == NULL) {
         return GEN_ERROR;
     }
+    if (set->enabled[index]) {
+        select_set_unregister(set, index);
+    }
+    set->entries[index] = NULL;
+    return SUCCESS;
+}
 
-    pthread_mutex_lock(&channel->mutex); // need to lock then unlock later for single thread access
-    if(channel->status != -2)// check if channel is not closed
-    {
-        pthread_mutex_unlock(&channel->mutex);
-        return DESTROY_ERROR;
+// Lets select_set_wait pick case index again after select_set_disable
+// Returns SUCCESS if the case is enabled, or GEN_ERROR if there is no such case
+enum channel_status select_set_enable(select_set_t* set, size_t index)
+{
+    if (set == NULL || index >= set->capacity || set->entries[index] == NULL) {
+        return GEN_ERROR;
     }
-    pthread_mutex_unlock(&channel->mutex);
-    
-    sem_destroy(&channel->sem_send);
-    sem_destroy(&channel->sem_receive);
-    //sem_destroy(channel->sem_select);
-    pthread_mutex_destroy(&channel->mutex);
-    list_destroy(channel->list);
-    buffer_free(channel->buffer);
-    free(channel);
+    if (!set->enabled[index]) {
+        select_set_register(set, index);
+    }
+    return SUCCESS;
+}
 
+// Stops select_set_wait from picking case index until it is enabled again
+// Returns SUCCESS if the case is disabled, or GEN_ERROR if there is no such case
+enum channel_status select_set_disable(select_set_t* set, size_t index)
+{
+    if (set == NULL || index >= set->capacity || set->entries[index] == NULL) {
+        return GEN_ERROR;
+    }
+    if (set->enabled[index]) {
+        select_set_unregister(set, index);
+    }
     return SUCCESS;
 }
 
-// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
-// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
-// If multiple options are available, it selects the first option and performs its corresponding action
-// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
-// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
-// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
-// Additionally, selected_index is set to the index of the channel that generated the error
-enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+// Takes the ready list and tries the enabled cases on it once, in cyclic order from case start (or drawn by weight
+// under SELECT_WEIGHTED)
+// Cases after the one that could proceed are pushed back untried, and so is that case itself
+// Returns CHANNEL_EMPTY if none of them could proceed, otherwise the status of the first case that did
+static enum channel_status select_set_try(select_set_t* set, size_t start, size_t* selected_index)
 {
-    sem_t local_sem;
-    //channel_status local_select 
-    //channel_t local_channel;
-    //Need to keep tract of channels in case of multiple select calls
-    sem_init(&local_sem, 0, 0);
-    for(size_t i = 0; i < channel_count; i++)
-    {
-    pthread_mutex_lock(&channel_list[i].channel->mutex);
-    list_insert(channel_list[i].channel->list, &local_sem); // insert into a sem list
-    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-    }
-    while(true){  //Always needs to be true because when it's not it'll return
-        for(size_t i = 0; i < channel_count; i++)
-        {
-            pthread_mutex_lock(&channel_list[i].channel->mutex);
-            channel_list[i].channel->sem_select = &local_sem;
-            pthread_mutex_unlock(&channel_list[i].channel->mutex);
-            //channel_list[i].channel->chan_data = &channel_list[i].data;
-            //list_insert(channel_list[i].channel->list, &local_sem);
-            if(channel_list[i].dir == SEND)
-            {
-                enum channel_status send = channel_non_blocking_send(channel_list[i].channel, channel_list[i].data);
-                
-                if(send == SUCCESS)
-                {
-                    *selected_index = i;
-                    for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                    sem_destroy(&local_sem);
-                    pthread_mutex_lock(&channel_list[i].channel->mutex);
-                    channel_list[i].channel->sem_select = NULL;
-                    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                    return SUCCESS;
-                }
-                else if(send == CLOSED_ERROR){
-                    *selected_index = i;
-                    for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                    sem_destroy(&local_sem);
-                    pthread_mutex_lock(&channel_list[i].channel->mutex);
-                    channel_list[i].channel->sem_select = NULL;
-                    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                    return CLOSED_ERROR;
-                }
-                
-                else if(send == GEN_ERROR)
-                {
-                    *selected_index = i;
-                    for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                    sem_destroy(&local_sem);
-                    pthread_mutex_lock(&channel_list[i].channel->mutex);
-                    channel_list[i].channel->sem_select = NULL;
-                    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                    return GEN_ERROR;
-                }
-                
-                
+    size_t count = channel_take_ready(&set->waiter, set->cases);
+    if (channel_select_weighted(&set->options)) {
+        size_t enabled = 0;
+        for (size_t k = 0; k < count; k++) {
+            if (set->enabled[set->cases[k]]) {
+                set->cases[enabled++] = set->cases[k];
             }
-            if(channel_list[i].dir == RECV)
-            {
-                enum channel_status receive = channel_non_blocking_receive(channel_list[i].channel, &channel_list[i].data); // Call recieve
-                if(receive == SUCCESS)
-                {
-                *selected_index = i;
-                for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                sem_destroy(&local_sem);
-                pthread_mutex_lock(&channel_list[i].channel->mutex);
-                channel_list[i].channel->sem_select = NULL;
-                pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                return SUCCESS;
-                }
-                else if(receive == CLOSED_ERROR){
-                    *selected_index = i;
-                   for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                    sem_destroy(&local_sem);
-                    pthread_mutex_lock(&channel_list[i].channel->mutex);
-                    channel_list[i].channel->sem_select = NULL;
-                    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                    return CLOSED_ERROR;
-                }
-                
-                else if(receive == GEN_ERROR)
-                {
-                    *selected_index = i;
-                    for(size_t j = 0; j < channel_count; j++) {
-                        pthread_mutex_lock(&channel_list[j].channel->mutex);
-                        list_remove(channel_list[j].channel->list, list_find(channel_list[j].channel->list, &local_sem));
-                        pthread_mutex_unlock(&channel_list[j].channel->mutex);
-                    }
-                    sem_destroy(&local_sem);
-                    pthread_mutex_lock(&channel_list[i].channel->mutex);
-                    channel_list[i].channel->sem_select = NULL;
-                    pthread_mutex_unlock(&channel_list[i].channel->mutex);
-                    return GEN_ERROR;
-                }
+        }
+        enum channel_status status = channel_select_draw(NULL, set->entries, set->cases, &enabled, &set->options.seed, &set->waiter, selected_index);
+        if (status != CHANNEL_EMPTY) {
+            for (size_t k = 0; k < enabled; k++) {
+                channel_registration_ready(&set->registrations[set->cases[k]]);
             }
         }
+        return status;
+    }
+    size_t first = channel_ready_start(set->cases, count, start);
+    enum channel_status status = CHANNEL_EMPTY;
+    for (size_t k = 0; k < count; k++) {
+        size_t index = set->cases[(first + k) % count];
+        if (!set->enabled[index]) {
+            continue;
+        }
+        if (status != CHANNEL_EMPTY) {
+            channel_registration_ready(&set->registrations[index]);
+            continue;
+        }
+        status = channel_select_case(set->entries[index], &set->waiter);
+        if (status != CHANNEL_EMPTY) {
+            *selected_index = index;
+            channel_registration_ready(&set->registrations[index]);
+        }
+    }
+    return status;
+}
 
-    //After checking every channel, need to check if it was unsuccessful. If so we wait
-    sem_wait(&local_sem); // when posted it starts all over again
+// Blocks until one of the enabled cases of the set can proceed and performs it, like channel_select
+// Received values are stored in the data of the case's select_t; sent values are taken from it
+// Only re-checks the cases whose channels changed since the last wait, and allocates nothing
+// Returns SUCCESS and stores the case in selected_index once an operation has been performed,
+// CLOSED_ERROR and stores the case in selected_index if the channel of a case is closed, and
+// GEN_ERROR if the set has no enabled cases or on any other generic error
+enum channel_status select_set_wait(select_set_t* set, size_t* selected_index)
+{
+    if (set == NULL || selected_index == NULL || set->enabled_count == 0) {
+        return GEN_ERROR;
+    }
+    channel_waiter_t* waiter = &set->waiter;
+    size_t start = channel_select_start(&set->options, set->capacity);
+    size_t notified = CHANNEL_WAITER_OPEN;
+    enum channel_status status;
+    while (true) {
+        status = select_set_try(set, start, selected_index);
+        if (status != CHANNEL_EMPTY) {
+            break;
+        }
+        // The item or slot we were notified for has been taken by somebody else
+        notified = CHANNEL_WAITER_OPEN;
+        atomic_store(&waiter->fired, CHANNEL_WAITER_OPEN);
+        channel_waiter_park(waiter, NULL);
+        if (!channel_select_claim(waiter, selected_index, &notified)) {
+            // An unbuffered peer completed the case and its channel may have more peers waiting
+            atomic_store(&waiter->fired, CHANNEL_WAITER_BUSY);
+            channel_registration_ready(&set->registrations[*selected_index]);
+            channel_stats_select_wakeup(set->entries[*selected_index]->channel, set->entries[*selected_index]->dir);
+            status = SUCCESS;
+            break;
+        }
+        if (notified != CHANNEL_WAITER_OPEN) {
+            channel_stats_select_wakeup(set->entries[notified]->channel, set->entries[notified]->dir);
+        }
+    }
+    // We were woken for an item or slot that we did not take, so hand the wakeup to the next select in line
+    if (notified != CHANNEL_WAITER_OPEN && notified != *selected_index) {
+        select_t* entry = set->entries[notified];
+        channel_notify(entry->channel, entry->dir, 1, waiter);
     }
+    set->options.cursor = *selected_index + 1;
+    return status;
+}
 
-    //May need to implement goto to clean up
-    
-    //sem_post(&local_sem);
-    //Use send post when channel is not full, modify functions
-    
+// Makes select_set_wait try the cases in the order given by options, which is copied into the set
+// Returns SUCCESS, or GEN_ERROR if an argument is NULL
+enum channel_status select_set_options(select_set_t* set, const select_options_t* options)
+{
+    if (set == NULL || options == NULL) {
+        return GEN_ERROR;
+    }
+    set->options = *options;
+    return SUCCESS;
 }
 
-/*
-(gdb) r test_channel_close_with_send 10 doesn't have to be 10
-CRTL + z
-thread apply all bt */
\ No newline at end of file
+// Unregisters every case of the set and frees it
+// Must be called before any channel of its cases is destroyed
+void select_set_destroy(select_set_t* set)
+{
+    if (set == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->entries[i] != NULL && set->enabled[i]) {
+            select_set_unregister(set, i);
+        }
+    }
+    free(set->entries);
+    free(set->enabled);
+    free(set->registrations);
+    free(set->cases);
+    free(set);
+}
@@ -9,7 +9,14 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
 #include "linked_list.h"
+#include "msg_pool.h"
+#include "chunk_queue.h"
+#include "spill_queue.h"
+#include "histogram.h"
 
 
 // Defines possible return values from channel functions
@@ -19,9 +26,130 @@ enum channel_status {
     SUCCESS = 1,
     CLOSED_ERROR = -2,
     GEN_ERROR = -1,
-    DESTROY_ERROR = -3
+    DESTROY_ERROR = -3,
+    TIMEOUT = -4
 };
 
+// Defines the storage backends a channel can be created with
+enum channel_kind {
+    // buffer_t guarded by the channel mutex
+    CHANNEL_LOCKED,
+    // Bounded ring with a sequence counter per buffer_t slot; send/receive only take the mutex to park or wake
+    CHANNEL_LOCK_FREE,
+    // Wait-free ring for exactly one sending and one receiving thread at a time
+    // Handing either side over to another thread requires the threads to synchronize with each other first
+    CHANNEL_SPSC,
+};
+
+// Defines how blocking send/receive calls on buffered channels wait for an item or slot
+enum channel_wait_policy {
+    // Sleep on the channel right away
+    CHANNEL_WAIT_PARK,
+    // Poll the channel up to spin_limit times, with a pause instruction in between, then sleep
+    // The spinning policies park right away on machines with a single CPU
+    CHANNEL_WAIT_SPIN,
+    // Like CHANNEL_WAIT_SPIN, but the number of polls follows how many recent waits needed, up to spin_limit
+    CHANNEL_WAIT_ADAPTIVE,
+};
+
+// Defines how the capacity of a buffered channel follows its load
+enum channel_growth {
+    // Fixed at the size the channel was created with
+    CHANNEL_FIXED,
+    // Doubles whenever a send finds the ring full, up to max_size, and halves again once the ring is at most a
+    // quarter full, down to the size the channel was created with; growing copies the queued items once
+    CHANNEL_GROWABLE,
+    // Items that do not fit in the ring queue up in linked chunks of CHUNK_QUEUE_SLOTS, so sends never wait for room
+    CHANNEL_UNBOUNDED,
+    // Like CHANNEL_UNBOUNDED, but the items that do not fit in the ring are copied into memory-mapped segment files
+    // in spill_dir, see spill_queue_t; sized channels (elem_size != 0) only
+    CHANNEL_SPILL,
+};
+
+// Default spin_limit for the spinning wait policies
+#define CHANNEL_SPIN_LIMIT 2000
+
+// Defines the options a channel can be created with, see channel_options_init for the defaults
+typedef struct {
+    enum channel_kind kind;
+    enum channel_wait_policy wait_policy;
+    // Most polls a blocking call makes before it sleeps, 0 selects CHANNEL_SPIN_LIMIT
+    size_t spin_limit;
+    // Bytes of every message, copied into and out of the channel storage; 0 passes void* values as they are
+    // See channel_create_sized for how the data arguments of a sized channel are used
+    size_t elem_size;
+    // Bytes of the messages channel_msg_alloc hands out, 0 for a channel without a message pool
+    // Any size is supported; the pool grows by 64 KiB or 32 messages at a time, whichever is more, see msg_pool_create
+    // Each pool takes one of the process's PTHREAD_KEYS_MAX pthread keys for its per-thread caches; pools created
+    // after the keys ran out still work, but every channel_msg_alloc and channel_msg_release takes the pool mutex
+    size_t msg_size;
+    // Number of priority levels (at most CHANNEL_MAX_PRIORITIES), 0 or 1 for a plain FIFO channel
+    // A buffered channel with several levels keeps one ring per level and always uses CHANNEL_LOCKED; the levels
+    // share the channel size, and receives take the oldest item of the highest non-empty level
+    // See channel_send_priority; unbuffered channels hand values over directly and ignore the levels
+    size_t priorities;
+    // Priority channels only: a non-empty level is served once priority_aging receives in a row have passed it
+    // over for higher levels, so bulk traffic keeps moving under a steady stream of urgent items; 0 never ages
+    size_t priority_aging;
+    // Capacity policy of buffered channels, which always use CHANNEL_LOCKED unless it is CHANNEL_FIXED
+    // Unbuffered channels ignore it, and it cannot be combined with several priorities
+    enum channel_growth growth;
+    // CHANNEL_GROWABLE only: most items the ring grows to, at least the channel size
+    size_t max_size;
+    // CHANNEL_SPILL only: directory of the segment files, NULL for P_tmpdir; only used while creating the channel
+    const char* spill_dir;
+    // Stamp every item as it is sent and record the time it spent in the channel when it is received, see
+    // channel_sojourn_histogram; buffered CHANNEL_FIXED channels with a single priority level only
+    bool sojourn;
+} channel_options_t;
+
+// Most priority levels a channel can have
+#define CHANNEL_MAX_PRIORITIES 64
+
+// Size of the cache lines the ring indices are spread over
+#define CHANNEL_CACHE_LINE 64
+
+// Defines channel list structure for channel_select function
+enum direction {
+    SEND,
+    RECV,
+};
+
+#ifdef CHANNEL_STATS
+// Counters of one direction of a channel, on a cache line of their own, see channel_get_stats
+// Updated with relaxed atomics: a plain load and store under the mutex, and a fetch_add otherwise
+typedef struct {
+    // Items moved; the lock-free rings count them in tail and head instead, and keep their value as of the last
+    // reset here
+    _Alignas(CHANNEL_CACHE_LINE) atomic_size_t items;
+    atomic_size_t failures;
+    atomic_size_t waits;
+    atomic_uint_fast64_t blocked_ns;
+    atomic_size_t select_wakeups;
+    // SEND only
+    atomic_size_t max_depth;
+} channel_counters_t;
+#endif
+
+// Snapshot of the counters of a channel, see channel_get_stats
+typedef struct {
+    // Items sent and received, also through batches and select
+    size_t sends;
+    size_t receives;
+    // Non-blocking calls that found the channel full (sends) or empty (receives)
+    size_t send_failures;
+    size_t receive_failures;
+    // Blocking calls that could not complete right away, and the time they spent waiting
+    size_t send_waits;
+    size_t receive_waits;
+    uint64_t send_blocked_ns;
+    uint64_t receive_blocked_ns;
+    // Most items the channel held right after a send; an estimate on CHANNEL_LOCK_FREE and CHANNEL_SPSC, where
+    // receives may be in flight
+    size_t max_depth;
+    // Times the channel woke a select waiting for one of its items or slots
+    size_t select_wakeups;
+} channel_stats_t;
 
 // Defines channel object
 typedef struct {
@@ -30,23 +158,62 @@ typedef struct {
     buffer_t* buffer;
 
     /* ADD ANY STRUCT ENTRIES YOU NEED HERE */
-    int thread_num;
+    enum channel_kind kind;
+    enum channel_wait_policy wait_policy;
+    // Most polls before sleeping; 0 if blocking calls park right away (CHANNEL_WAIT_PARK, or a single CPU)
+    size_t spin_limit;
+    // CHANNEL_WAIT_ADAPTIVE only: number of polls the next blocking call makes before it sleeps
+    atomic_size_t spin_budget;
+    // Guards the CHANNEL_LOCKED buffer and the waiter lists
     pthread_mutex_t mutex;
-    enum channel_status status; 
-    size_t size;
-    sem_t sem_send; 
-    sem_t sem_receive;
-    sem_t* sem_select;
-    void* chan_data;
-    list_t* list;
-    list_node_t* node;
+    atomic_bool closed;
+    // Threads parked in send/select (index SEND) or receive/select (index RECV)
+    list_t* waiters[2];
+    // Length of each waiter list, readable without the mutex so the lock-free path can skip waking nobody
+    atomic_size_t waiting[2];
+    // Futex words that plain send (index SEND) and receive (index RECV) calls on buffered channels sleep on
+    // A peer that frees a slot or publishes an item bumps the word before waking, so no wakeup is lost
+    atomic_uint events[2];
+    // Number of threads sleeping on events, so the peer only issues FUTEX_WAKE when somebody is actually asleep
+    atomic_size_t parked[2];
+
+    // Messages of channel_msg_alloc, NULL if the channel was created without msg_size
+    msg_pool_t* pool;
+
+    // Rings of the priority levels above 0 and their bookkeeping, NULL unless created with several priorities
+    // Level 0 is stored in buffer; guarded by the mutex like the buffer
+    struct channel_priority* priority;
+
+    // Capacity policy and bounds of the ring (CHANNEL_GROWABLE), and CHANNEL_UNBOUNDED's (overflow) or
+    // CHANNEL_SPILL's (spill) queue that holds the items sent while the ring was full, all newer than the ones in
+    // the ring; guarded by the mutex
+    enum channel_growth growth;
+    size_t min_size;
+    size_t max_size;
+    chunk_queue_t* overflow;
+    spill_queue_t* spill;
+
+    // CHANNEL_LOCK_FREE only: slot i is writable when seq[i] == tail and readable when seq[i] == head + 1
+    atomic_size_t* seq;
+
+    // Ring indices of CHANNEL_LOCK_FREE and CHANNEL_SPSC, each on its own cache line
+    // CHANNEL_SPSC keeps the receiver's last view of tail next to head and the sender's last view of head next to tail
+    _Alignas(CHANNEL_CACHE_LINE) atomic_size_t head;
+    size_t cached_tail;
+    _Alignas(CHANNEL_CACHE_LINE) atomic_size_t tail;
+    size_t cached_head;
+
+    // Sojourn mode only: CLOCK_MONOTONIC nanoseconds at which every queued item was sent, indexed like its slot
+    // in buffer, and the histogram of the nanoseconds items spent in the channel; both NULL otherwise
+    uint64_t* stamps;
+    histogram_t* sojourn;
+
+#ifdef CHANNEL_STATS
+    // Counters of senders (index SEND) and receivers (index RECV)
+    channel_counters_t counters[2];
+#endif
 } channel_t;
 
-// Defines channel list structure for channel_select function
-enum direction {
-    SEND,
-    RECV,
-};
 typedef struct {
     // Channel on which we want to perform operation
     channel_t* channel;
@@ -55,12 +222,62 @@ typedef struct {
     // If dir is RECV, then the message received from the channel is stored as an output in this parameter, data
     // If dir is SEND, then the message that needs to be sent is given as input in this parameter, data
     void* data;
+    // Only read by SEND cases on priority channels: the level data is sent at, see channel_send_priority
+    size_t priority;
+    // Only read by SELECT_WEIGHTED selects: the share of the picks this case gets while it can proceed
+    unsigned int weight;
 } select_t;
 
+// Defines the order in which a select tries its cases, which decides who wins when several are ready
+enum select_policy {
+    // Lowest index first, as channel_select does; later cases may starve under load
+    SELECT_FIRST,
+    // Start at a random case and wrap around, like Go's select
+    SELECT_RANDOM,
+    // Start right after the case picked by the previous call with the same options
+    SELECT_ROUND_ROBIN,
+    // Pick among the cases that can proceed at random, in proportion to the weight of their select_t; cases of
+    // weight 0 are only picked when no weighted case can proceed
+    SELECT_WEIGHTED,
+};
+
+// Defines the options of channel_select_options and select_set_options, see select_options_init for the defaults
+typedef struct {
+    enum select_policy policy;
+    // SELECT_ROUND_ROBIN only: case the next call starts at, advanced by every call that picks a case
+    size_t cursor;
+    // State of the random number generator used by SELECT_RANDOM and SELECT_WEIGHTED
+    unsigned int seed;
+} select_options_t;
+
 // Creates a new channel with the provided size and returns it to the caller
 // A 0 size indicates an unbuffered channel, whereas a positive size indicates a buffered channel
+// On an unbuffered channel a send waits for a receiver (and vice versa) and the value is handed over directly
 channel_t* channel_create(size_t size);
 
+// Creates a new channel with the provided size using the given storage backend
+// Unbuffered (0 size) channels always use CHANNEL_LOCKED
+// Returns NULL if the channel could not be allocated
+channel_t* channel_create_kind(size_t size, enum channel_kind kind);
+
+// Creates a new channel with the provided size whose messages are elem_size bytes copied inline into the ring,
+// so senders need not keep their messages alive (or allocate them) until they are received
+// On a sized channel every data argument points at the message: send copies elem_size bytes from data, and
+// receive copies them into the memory that *data (or data of a select_t, or each out[i] of a batch) points at,
+// which the caller must set up beforehand and which keeps its value when nothing is received
+// Calls with a NULL message pointer return GEN_ERROR
+// Returns NULL if the channel could not be allocated or elem_size is 0
+channel_t* channel_create_sized(size_t size, size_t elem_size);
+
+// Fills options with the defaults: CHANNEL_LOCKED storage, CHANNEL_WAIT_PARK, void* messages, no message pool and
+// a single priority level
+void channel_options_init(channel_options_t* options);
+
+// Creates a new channel with the provided size and options
+// Unbuffered (0 size) channels always use CHANNEL_LOCKED and CHANNEL_WAIT_PARK
+// Returns NULL if the channel could not be allocated or options is NULL
+channel_t* channel_create_options(size_t size, const channel_options_t* options);
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -77,6 +294,16 @@ enum channel_status channel_send(channel_t* channel, void* data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_receive(channel_t* channel, void** data);
 
+// Same as channel_send but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns SUCCESS, CLOSED_ERROR or GEN_ERROR like channel_send, or
+// TIMEOUT if the deadline passed before the data could be sent
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline);
+
+// Same as channel_receive but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns SUCCESS, CLOSED_ERROR or GEN_ERROR like channel_receive, or
+// TIMEOUT if the deadline passed before any data arrived
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline);
+
 // Writes data to the given channel
 // This is a non-blocking call i.e., the function simply returns if the channel is full
 // Returns SUCCESS for successfully writing data to the channel,
@@ -85,6 +312,14 @@ enum channel_status channel_receive(channel_t* channel, void** data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 
+// Same as channel_send but queues data at the given priority level of a priority channel, where it overtakes
+// every item of the lower levels; levels above the highest one of the channel are clamped to it
+// Plain channels ignore the priority, and channel_send sends at level 0
+enum channel_status channel_send_priority(channel_t* channel, void* data, size_t priority);
+
+// Same as channel_non_blocking_send at the given priority level, see channel_send_priority
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, size_t priority);
+
 // Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
 // This is a non-blocking call i.e., the function simply returns if the channel is empty
 // Returns SUCCESS for successful retrieval of data,
@@ -93,6 +328,38 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
 
+// Sends the n items in order, blocking until all of them are in the channel
+// Each round moves as many items as currently fit under one lock or ring reservation and wakes receivers once
+// The number of items actually sent is stored in sent, also when an error is returned
+// Returns SUCCESS once all items were sent,
+// CLOSED_ERROR if the channel is closed before that, and
+// GEN_ERROR if n is 0 or on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t n, size_t* sent);
+
+// Receives up to max items in FIFO order into out, blocking until at least one item is available
+// Takes everything available (up to max) under one lock or ring reservation and wakes senders once
+// The number of items received is stored in received
+// Returns SUCCESS if at least one item was received,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* received);
+
+// Sends as many of the n items, in order, as currently fit in the channel without blocking
+// The number of items sent is stored in sent
+// Returns SUCCESS if at least one item was sent,
+// CHANNEL_FULL if the channel is full and nothing was sent,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send_batch(channel_t* channel, void** items, size_t n, size_t* sent);
+
+// Receives up to max items in FIFO order into out without blocking
+// The number of items received is stored in received
+// Returns SUCCESS if at least one item was received,
+// CHANNEL_EMPTY if the channel is empty and nothing was received,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_receive_batch(channel_t* channel, void** out, size_t max, size_t* received);
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -107,6 +374,38 @@ enum channel_status channel_close(channel_t* channel);
 // GEN_ERROR in any other error case
 enum channel_status channel_destroy(channel_t* channel);
 
+// Returns the bytes the channel currently holds allocated for queued items: its rings and overflow chunks
+// Spilled items live in files and are not counted
+size_t channel_storage_bytes(channel_t* channel);
+
+// Stores a snapshot of the channel's counters in stats; counters keep running while it is taken, so they may be
+// a few operations apart from each other
+// The counters only exist when built with CHANNEL_STATS (the default, make STATS=0 compiles them out)
+// Returns SUCCESS, or GEN_ERROR if an argument is NULL or the counters were compiled out, in which case stats is zeroed
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats);
+
+// Sets all the counters of the channel back to 0
+// Returns SUCCESS, or GEN_ERROR if channel is NULL or the counters were compiled out
+enum channel_status channel_reset_stats(channel_t* channel);
+
+// Returns the histogram of the nanoseconds items spent in a channel created with options.sojourn, from the send
+// that put them in to the receive that took them out, or NULL for other channels
+// Query it with histogram_percentile, or histogram_merge it with those of other channels; items of unbuffered
+// channels are handed over without waiting in the channel, so their histogram stays empty
+// The histogram belongs to the channel and is freed by channel_destroy
+histogram_t* channel_sojourn_histogram(channel_t* channel);
+
+// Returns a message of options.msg_size bytes from the channel's message pool, to be sent as a void* on it
+// The receiver gives it back with channel_msg_release once done with it, so neither side calls malloc or free;
+// each thread allocates from and releases into its own cache of free messages, see msg_pool_t
+// The pool is freed with the channel, including the messages that were never released
+// Returns NULL if the channel has no message pool or no memory is left
+void* channel_msg_alloc(channel_t* channel);
+
+// Gives a message of channel_msg_alloc back to the channel's message pool; does nothing if msg is NULL
+// Any thread may release the message, not only the one that allocated it
+void channel_msg_release(channel_t* channel, void* msg);
+
 // Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
 // This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
 // If multiple options are available, it selects the first option and performs its corresponding action
@@ -116,4 +415,85 @@ enum channel_status channel_destroy(channel_t* channel);
 // Additionally, selected_index is set to the index of the channel that generated the error
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 
+// Same as channel_select but gives up once the absolute CLOCK_MONOTONIC time deadline has passed
+// Returns the same as channel_select, or TIMEOUT without touching selected_index if the deadline passed before
+// any case could proceed
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline);
+
+// Same as channel_select but never blocks, like a Go select with a default case
+// Tries every case once, in order, without registering on any channel
+// Returns SUCCESS and sets selected_index if a case was performed,
+// CHANNEL_EMPTY if none of the cases could proceed,
+// CLOSED_ERROR and sets selected_index if a closed channel comes before any case that can proceed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_try_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
+
+// Fills options with the defaults: SELECT_FIRST, a zero cursor and a seed that differs between calls
+void select_options_init(select_options_t* options);
+
+// Same as channel_select but tries the cases in the order given by options->policy
+// options is updated by the call (round-robin cursor and random state), so each thread needs its own
+// NULL options behave like SELECT_FIRST
+enum channel_status channel_select_options(select_t* channel_list, size_t channel_count, size_t* selected_index, select_options_t* options);
+
+// The registrations and scratch space of a blocking select, kept by the caller between calls to channel_select_with
+// Starts out empty; the first select makes room for its cases and later ones only grow it when they have more
+// cases, so a loop that keeps selecting on the same number of cases does no allocation after the first call
+// Unlike select_set_t it registers anew on every call, so the cases may change freely between calls
+// A waiter must only be used by one thread at a time
+typedef struct select_waiter select_waiter_t;
+
+// Creates an empty select waiter
+// Returns NULL if it could not be allocated
+select_waiter_t* select_waiter_create(void);
+
+// Same as channel_select_options but keeps the registrations in waiter, so selects on as many cases as an earlier
+// call on the same waiter allocate nothing
+// Returns the same as channel_select_options
+enum channel_status channel_select_with(select_waiter_t* waiter, select_t* channel_list, size_t channel_count, size_t* selected_index, select_options_t* options);
+
+// Frees the waiter; does nothing if waiter is NULL
+void select_waiter_destroy(select_waiter_t* waiter);
+
+// A long-lived set of select cases that stays registered on its channels between waits
+// Meant for event loops that select on the same cases over and over; a set must only be used by one thread at a time
+typedef struct select_set select_set_t;
+
+// Creates an empty select set with room for capacity cases
+// Returns NULL if the set could not be allocated
+select_set_t* select_set_create(size_t capacity);
+
+// Adds entry as an enabled case of the set and stores its index in index, the lowest free one
+// The set keeps using entry, which must stay valid until the case is removed or the set is destroyed
+// Returns SUCCESS if the case was added, or GEN_ERROR if the set is full or the arguments are invalid
+enum channel_status select_set_add(select_set_t* set, select_t* entry, size_t* index);
+
+// Removes case index from the set, freeing its index for later adds
+// Returns SUCCESS if the case was removed, or GEN_ERROR if there is no such case
+enum channel_status select_set_remove(select_set_t* set, size_t index);
+
+// Lets select_set_wait pick case index again after select_set_disable
+// Returns SUCCESS if the case is enabled, or GEN_ERROR if there is no such case
+enum channel_status select_set_enable(select_set_t* set, size_t index);
+
+// Stops select_set_wait from picking case index until it is enabled again
+// Returns SUCCESS if the case is disabled, or GEN_ERROR if there is no such case
+enum channel_status select_set_disable(select_set_t* set, size_t index);
+
+// Blocks until one of the enabled cases of the set can proceed and performs it, like channel_select
+// Received values are stored in the data of the case's select_t; sent values are taken from it
+// Only re-checks the cases whose channels changed since the last wait, and allocates nothing
+// Returns SUCCESS and stores the case in selected_index once an operation has been performed,
+// CLOSED_ERROR and stores the case in selected_index if the channel of a case is closed, and
+// GEN_ERROR if the set has no enabled cases or on any other generic error
+enum channel_status select_set_wait(select_set_t* set, size_t* selected_index);
+
+// Makes select_set_wait try the cases in the order given by options, which is copied into the set
+// Returns SUCCESS, or GEN_ERROR if an argument is NULL
+enum channel_status select_set_options(select_set_t* set, const select_options_t* options);
+
+// Unregisters every case of the set and frees it
+// Must be called before any channel of its cases is destroyed
+void select_set_destroy(select_set_t* set);
+
 #endif // CHANNEL_H
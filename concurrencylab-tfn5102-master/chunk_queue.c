@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_queue.h"
+
+typedef struct chunk {
+    struct chunk* next;
+    // CHUNK_QUEUE_SLOTS values of slot_size bytes
+    char values[];
+} chunk_t;
+
+struct chunk_queue {
+    size_t elem_size; // 0 for void* values
+    size_t slot_size; // bytes per value in a chunk
+    chunk_t* head; // chunk of the oldest value, NULL while the queue is empty
+    chunk_t* tail; // chunk the next value goes into
+    size_t head_index; // slot of the oldest value in head
+    size_t tail_index; // slot of the next value in tail
+    size_t size;
+    size_t chunks; // chunks allocated, including the spare
+    chunk_t* spare;
+};
+
+// Returns the memory of slot index of chunk
+static void* chunk_slot(const chunk_queue_t* queue, chunk_t* chunk, size_t index)
+{
+    return chunk->values + index * queue->slot_size;
+}
+
+// Returns a chunk to append to the queue, the spare one if there is one
+// Returns NULL if it could not be allocated
+static chunk_t* chunk_get(chunk_queue_t* queue)
+{
+    chunk_t* chunk = queue->spare;
+    if (chunk != NULL) {
+        queue->spare = NULL;
+    } else {
+        chunk = (chunk_t*)malloc(sizeof(chunk_t) + CHUNK_QUEUE_SLOTS * queue->slot_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        queue->chunks++;
+    }
+    chunk->next = NULL;
+    return chunk;
+}
+
+// Keeps a drained chunk as the spare, or frees it if there already is one
+static void chunk_put(chunk_queue_t* queue, chunk_t* chunk)
+{
+    if (queue->spare == NULL) {
+        queue->spare = chunk;
+    } else {
+        free(chunk);
+        queue->chunks--;
+    }
+}
+
+// Creates an empty queue of void* values, or of elem_size bytes per value if elem_size is not 0
+// Returns NULL if the queue could not be allocated
+chunk_queue_t* chunk_queue_create(size_t elem_size)
+{
+    chunk_queue_t* queue = (chunk_queue_t*)malloc(sizeof(chunk_queue_t));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->elem_size = elem_size;
+    queue->slot_size = (elem_size == 0) ? sizeof(void*) : elem_size;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->head_index = 0;
+    queue->tail_index = 0;
+    queue->size = 0;
+    queue->chunks = 0;
+    queue->spare = NULL;
+    return queue;
+}
+
+// Appends up to count values from items in order
+// Returns the number of values appended, less than count only if a chunk could not be allocated
+size_t chunk_queue_push_batch(chunk_queue_t* queue, void** items, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (queue->tail == NULL || queue->tail_index == CHUNK_QUEUE_SLOTS) {
+            chunk_t* chunk = chunk_get(queue);
+            if (chunk == NULL) {
+                return i;
+            }
+            if (queue->tail == NULL) {
+                queue->head = chunk;
+                queue->head_index = 0;
+            } else {
+                queue->tail->next = chunk;
+            }
+            queue->tail = chunk;
+            queue->tail_index = 0;
+        }
+        void* slot = chunk_slot(queue, queue->tail, queue->tail_index++);
+        if (queue->elem_size != 0) {
+            memcpy(slot, items[i], queue->elem_size);
+        } else {
+            *(void**)slot = items[i];
+        }
+        queue->size++;
+    }
+    return count;
+}
+
+// Removes up to max values in FIFO order into out
+// Returns the number of values removed
+size_t chunk_queue_pop_batch(chunk_queue_t* queue, void** out, size_t max)
+{
+    size_t count = 0;
+    while (count < max && queue->size != 0) {
+        void* slot = chunk_slot(queue, queue->head, queue->head_index++);
+        if (queue->elem_size != 0) {
+            memcpy(out[count], slot, queue->elem_size);
+        } else {
+            out[count] = *(void**)slot;
+        }
+        count++;
+        queue->size--;
+        if (queue->size == 0) {
+            // Drained: start over at the beginning of the tail chunk instead of allocating a new one
+            queue->head = queue->tail;
+            queue->head_index = 0;
+            queue->tail_index = 0;
+        } else if (queue->head_index == CHUNK_QUEUE_SLOTS) {
+            chunk_t* drained = queue->head;
+            queue->head = drained->next;
+            queue->head_index = 0;
+            chunk_put(queue, drained);
+        }
+    }
+    return count;
+}
+
+// Returns the number of values in the queue
+size_t chunk_queue_size(const chunk_queue_t* queue)
+{
+    return queue->size;
+}
+
+// Returns the bytes the queue holds allocated, including its spare chunk
+size_t chunk_queue_bytes(const chunk_queue_t* queue)
+{
+    return sizeof(chunk_queue_t) + queue->chunks * (sizeof(chunk_t) + CHUNK_QUEUE_SLOTS * queue->slot_size);
+}
+
+// Frees the queue and its chunks
+void chunk_queue_destroy(chunk_queue_t* queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    chunk_t* chunk = queue->head;
+    while (chunk != NULL) {
+        chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(queue->spare);
+    free(queue);
+}
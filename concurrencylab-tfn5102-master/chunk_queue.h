@@ -0,0 +1,37 @@
+#ifndef CHUNK_QUEUE_H
+#define CHUNK_QUEUE_H
+
+#include <stddef.h>
+
+// Number of values in one chunk of a chunk queue
+#define CHUNK_QUEUE_SLOTS 256
+
+// Unbounded FIFO queue made of linked chunks of CHUNK_QUEUE_SLOTS values, allocated as the queue grows and freed
+// as it drains, except for one spare chunk kept so a queue hovering around a chunk boundary does not keep
+// calling malloc and free
+// Values are void* like in buffer_t, or elem_size bytes copied in and out through the caller's pointers
+// The queue does no locking of its own
+typedef struct chunk_queue chunk_queue_t;
+
+// Creates an empty queue of void* values, or of elem_size bytes per value if elem_size is not 0
+// Returns NULL if the queue could not be allocated
+chunk_queue_t* chunk_queue_create(size_t elem_size);
+
+// Appends up to count values from items in order
+// Returns the number of values appended, less than count only if a chunk could not be allocated
+size_t chunk_queue_push_batch(chunk_queue_t* queue, void** items, size_t count);
+
+// Removes up to max values in FIFO order into out
+// Returns the number of values removed
+size_t chunk_queue_pop_batch(chunk_queue_t* queue, void** out, size_t max);
+
+// Returns the number of values in the queue
+size_t chunk_queue_size(const chunk_queue_t* queue);
+
+// Returns the bytes the queue holds allocated, including its spare chunk
+size_t chunk_queue_bytes(const chunk_queue_t* queue);
+
+// Frees the queue and its chunks
+void chunk_queue_destroy(chunk_queue_t* queue);
+
+#endif // CHUNK_QUEUE_H
@@ -0,0 +1,36 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Sleeps until word no longer holds expected, somebody calls futex_wake on it or the absolute CLOCK_MONOTONIC
+// deadline passes (NULL for none); may return spuriously
+// Returns false if the deadline passed
+static inline bool futex_wait(atomic_uint* word, unsigned int expected, const struct timespec* deadline)
+{
+    if (deadline == NULL) {
+        syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+        return true;
+    }
+    // Unlike FUTEX_WAIT, FUTEX_WAIT_BITSET takes an absolute timeout, measured on CLOCK_MONOTONIC by default
+    if (syscall(SYS_futex, word, FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY) == 0) {
+        return true;
+    }
+    return errno != ETIMEDOUT;
+}
+
+// Wakes up to count threads sleeping in futex_wait on word
+static inline void futex_wake(atomic_uint* word, size_t count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, (count > INT_MAX) ? INT_MAX : (int)count, NULL, NULL, 0);
+}
+
+#endif // FUTEX_H
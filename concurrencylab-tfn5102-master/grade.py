@@ -20,6 +20,7 @@ timeout_too_many_wakeups = 40 * timeout_multiplier
 timeout_stress_send_recv = 20 * timeout_multiplier
 timeout_non_blocking_receive = 10 * timeout_multiplier
 timeout_select_mixed_buffered_unbuffered = 10 * timeout_multiplier
+timeout_throughput = 60 * timeout_multiplier
 timeout_make = 60 * timeout_multiplier
 
 # Number of iterations to run tests
@@ -81,26 +82,76 @@ add_test_cases("test_select_response_time", iters_one, timeout_response_time)
 add_test_cases("test_cpu_utilization_select", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_one, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
-#add_test_case_channel("test_unbuffered", iters_slow)
-#add_test_case_sanitize("test_unbuffered", iters_slow)
-#add_test_case_valgrind("test_unbuffered", iters_slow, timeout_valgrind * 5)
-#add_test_case_channel("test_non_blocking_unbuffered", iters_slow, timeout_channel * 3)
-#add_test_case_sanitize("test_non_blocking_unbuffered", iters_slow, timeout_sanitize * 3)
-#add_test_case_valgrind("test_non_blocking_unbuffered", iters_slow, timeout_valgrind * 3)
-#add_test_cases("test_stress_send_recv_unbuffered", iters_one, timeout_stress_send_recv)
-#add_test_cases("test_select_and_non_blocking_send_unbuffered", iters_slow)
-#add_test_cases("test_select_and_non_blocking_receive_unbuffered", iters_slow)
-#add_test_cases("test_select_with_select_unbuffered", iters_slow)
-#add_test_cases("test_select_with_same_channel_unbuffered")
-#add_test_cases("test_select_with_send_receive_on_same_channel_unbuffered")
-#add_test_cases("test_select_with_duplicate_channel_unbuffered", iters_slow)
-#add_test_cases("test_select_mixed_buffered_unbuffered", iters_slow, timeout_select_mixed_buffered_unbuffered)
-#add_test_case_channel("test_stress_unbuffered", iters_one, timeout_channel * 3)
-#add_test_case_sanitize("test_stress_unbuffered", iters_one, timeout_sanitize * 3)
-#add_test_case_valgrind("test_stress_unbuffered", iters_one, timeout_valgrind * 3)
-#add_test_case_channel("test_stress_mixed_buffered_unbuffered", iters_one, timeout_channel * 3)
-#add_test_case_sanitize("test_stress_mixed_buffered_unbuffered", iters_one, timeout_sanitize * 3)
-#add_test_case_valgrind("test_stress_mixed_buffered_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_cases("test_lock_free", iters_slow)
+add_test_case_channel("test_throughput_lock_free", iters_one, timeout_throughput)
+add_test_cases("test_spsc", iters_slow)
+add_test_case_channel("test_stress_send_recv_spsc", iters_one, timeout_throughput)
+add_test_cases("test_batch", iters_slow)
+add_test_case_channel("test_throughput_batch", iters_one, timeout_throughput)
+add_test_case_channel("test_unbuffered", iters_slow)
+add_test_case_sanitize("test_unbuffered", iters_slow)
+add_test_case_valgrind("test_unbuffered", iters_slow, timeout_valgrind * 5)
+add_test_case_channel("test_non_blocking_unbuffered", iters_slow, timeout_channel * 3)
+add_test_case_sanitize("test_non_blocking_unbuffered", iters_slow, timeout_sanitize * 3)
+add_test_case_valgrind("test_non_blocking_unbuffered", iters_slow, timeout_valgrind * 3)
+add_test_cases("test_stress_send_recv_unbuffered", iters_one, timeout_stress_send_recv)
+add_test_cases("test_select_and_non_blocking_send_unbuffered", iters_slow)
+add_test_cases("test_select_and_non_blocking_receive_unbuffered", iters_slow)
+add_test_cases("test_select_with_select_unbuffered", iters_slow)
+add_test_cases("test_select_with_same_channel_unbuffered")
+add_test_cases("test_select_with_send_receive_on_same_channel_unbuffered")
+add_test_cases("test_select_with_duplicate_channel_unbuffered", iters_slow)
+add_test_cases("test_select_mixed_buffered_unbuffered", iters_slow, timeout_select_mixed_buffered_unbuffered)
+add_test_case_channel("test_stress_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_case_channel("test_stress_mixed_buffered_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_mixed_buffered_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_mixed_buffered_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_case_channel("test_ping_pong", iters_one, timeout_throughput)
+add_test_cases("test_wait_policy", iters_one, timeout_cpu_utilization)
+add_test_case_channel("test_buffer_layout", iters_one, timeout_throughput)
+add_test_case_channel("test_select_herd", iters_one, timeout_throughput)
+add_test_case_channel("test_select_scale", iters_one, timeout_throughput)
+add_test_cases("test_select_set")
+add_test_cases("test_deadline", iters_slow)
+add_test_case_channel("test_deadline_overhead", iters_one, timeout_throughput)
+add_test_cases("test_try_select")
+add_test_cases("test_timer", iters_slow)
+add_test_case_channel("test_timer_wheel", iters_one, timeout_throughput)
+add_test_cases("test_sized_channel")
+add_test_case_channel("test_sized_throughput", iters_one, timeout_throughput)
+add_test_cases("test_msg_pool")
+add_test_case_channel("test_msg_pool_throughput", iters_one, timeout_throughput)
+add_test_cases("test_select_policy")
+add_test_case_channel("test_select_fairness", iters_one, timeout_throughput)
+add_test_cases("test_list_nodes")
+add_test_cases("test_list_find")
+add_test_case_channel("test_select_crowd", iters_one, timeout_throughput)
+add_test_case_channel("test_select_overhead", iters_one, timeout_throughput)
+add_test_cases("test_broadcast")
+add_test_case_channel("test_broadcast_throughput", iters_one, timeout_throughput)
+add_test_cases("test_priority_channel")
+add_test_case_channel("test_priority_latency", iters_one, timeout_throughput)
+add_test_cases("test_channel_growth")
+add_test_case_channel("test_burst", iters_one, timeout_throughput)
+add_test_cases("test_spill_channel")
+add_test_case_channel("test_spill", iters_one, timeout_throughput)
+add_test_cases("test_channel_stats")
+add_test_case_channel("test_stats_overhead", iters_one, timeout_throughput)
+add_test_cases("test_histogram")
+add_test_cases("test_sojourn_channel")
+add_test_case_channel("test_pipeline_sojourn", iters_one, timeout_throughput)
+add_test_cases("test_select_waiter")
+add_test_case_channel("test_stress_select_set_buffered", iters_one, timeout_channel * 5)
+add_test_case_sanitize("test_stress_select_set_buffered", iters_one, timeout_sanitize * 5)
+add_test_case_valgrind("test_stress_select_set_buffered", iters_one, timeout_valgrind * 5)
+add_test_case_channel("test_stress_select_set_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_select_set_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_select_set_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_case_channel("test_stress_select_set_mixed_buffered_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_select_set_mixed_buffered_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_select_set_mixed_buffered_unbuffered", iters_one, timeout_valgrind * 3)
 
 # Score distribution
 point_breakdown_checkpoint = [
@@ -304,7 +355,7 @@ def make_assignment():
 
 def check_global_variables():
     global_variables = []
-    for name in ["channel", "linked_list"]:
+    for name in ["channel", "linked_list", "timer", "msg_pool", "broadcast", "chunk_queue", "spill_queue", "histogram"]:
         error = ""
         args = ["nm", "-f", "posix", f"{name}.o"]
         try:
@@ -0,0 +1,140 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "histogram.h"
+
+// Buckets per power of two, and the number of buckets needed to cover the whole uint64_t range
+#define HISTOGRAM_SUB ((uint64_t)1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((size_t)(65 - HISTOGRAM_SUB_BITS) << HISTOGRAM_SUB_BITS)
+
+struct histogram {
+    atomic_size_t count;
+    atomic_uint_fast64_t max;
+    atomic_size_t buckets[HISTOGRAM_BUCKETS];
+};
+
+// Returns the bucket of value: values below 2 * HISTOGRAM_SUB are their own bucket, larger ones keep their
+// HISTOGRAM_SUB_BITS + 1 most significant bits, the top one of which the bucket row already implies
+static size_t histogram_bucket(uint64_t value)
+{
+    if (value < 2 * HISTOGRAM_SUB) {
+        return (size_t)value;
+    }
+    unsigned int shift = (unsigned int)(63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BITS;
+    return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) + (size_t)((value >> shift) - HISTOGRAM_SUB);
+}
+
+// Returns the highest value that falls into bucket
+static uint64_t histogram_bucket_top(size_t bucket)
+{
+    if (bucket < 2 * HISTOGRAM_SUB) {
+        return bucket;
+    }
+    unsigned int shift = (unsigned int)(bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t base = (((uint64_t)bucket & (HISTOGRAM_SUB - 1)) + HISTOGRAM_SUB) << shift;
+    return base + (((uint64_t)1 << shift) - 1);
+}
+
+// Raises the recorded maximum of histogram to value if it is larger
+static void histogram_raise_max(histogram_t* histogram, uint64_t value)
+{
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Creates an empty histogram
+// Returns NULL if it could not be allocated
+histogram_t* histogram_create(void)
+{
+    histogram_t* histogram = (histogram_t*)malloc(sizeof(histogram_t));
+    if (histogram == NULL) {
+        return NULL;
+    }
+    atomic_init(&histogram->count, 0);
+    atomic_init(&histogram->max, 0);
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        atomic_init(&histogram->buckets[i], 0);
+    }
+    return histogram;
+}
+
+// Records one occurrence of value
+void histogram_record(histogram_t* histogram, uint64_t value)
+{
+    atomic_fetch_add_explicit(&histogram->buckets[histogram_bucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    histogram_raise_max(histogram, value);
+}
+
+// Returns the number of values recorded
+size_t histogram_count(const histogram_t* histogram)
+{
+    return atomic_load_explicit(&histogram->count, memory_order_relaxed);
+}
+
+// Returns the largest value recorded, 0 if there is none
+uint64_t histogram_max(const histogram_t* histogram)
+{
+    return atomic_load_explicit(&histogram->max, memory_order_relaxed);
+}
+
+// Returns the value below or at which percentile (between 0 and 100) percent of the recorded values are, as the
+// highest value of its bucket but no more than the largest value recorded; 0 if nothing was recorded
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile)
+{
+    size_t count = histogram_count(histogram);
+    uint64_t max = histogram_max(histogram);
+    if (count == 0) {
+        return 0;
+    }
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+    // Rank of the value we are after, counting from 1
+    double rank = percentile / 100 * (double)count;
+    size_t target = (size_t)rank;
+    if ((double)target < rank || target == 0) {
+        target++;
+    }
+    size_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t top = histogram_bucket_top(i);
+            return (top < max) ? top : max;
+        }
+    }
+    // Values recorded while we were counting made count run ahead of the buckets we saw
+    return max;
+}
+
+// Adds every value recorded in from to into, as if they had been recorded there too
+void histogram_merge(histogram_t* into, const histogram_t* from)
+{
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        size_t count = atomic_load_explicit(&from->buckets[i], memory_order_relaxed);
+        if (count != 0) {
+            atomic_fetch_add_explicit(&into->buckets[i], count, memory_order_relaxed);
+            atomic_fetch_add_explicit(&into->count, count, memory_order_relaxed);
+        }
+    }
+    histogram_raise_max(into, histogram_max(from));
+}
+
+// Forgets every recorded value
+void histogram_reset(histogram_t* histogram)
+{
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        atomic_store_explicit(&histogram->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&histogram->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+}
+
+// Frees the histogram
+void histogram_destroy(histogram_t* histogram)
+{
+    free(histogram);
+}
@@ -0,0 +1,44 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Each power of two is split into 2^HISTOGRAM_SUB_BITS equal buckets, so a recorded value is off by at most
+// 1 / 2^HISTOGRAM_SUB_BITS of itself (about 1.6%)
+#define HISTOGRAM_SUB_BITS 6
+
+// Log-linear (HDR-style) histogram of uint64_t values: values below 2^(HISTOGRAM_SUB_BITS + 1) get a bucket each,
+// and every power of two above that is split into 2^HISTOGRAM_SUB_BITS buckets, which covers the whole uint64_t
+// range in a fixed array of counters with the same relative precision everywhere
+// Recording is one relaxed atomic increment, so any number of threads may record, query and merge at once; a
+// query that runs during recording sees some of the concurrent values and not others
+typedef struct histogram histogram_t;
+
+// Creates an empty histogram
+// Returns NULL if it could not be allocated
+histogram_t* histogram_create(void);
+
+// Records one occurrence of value
+void histogram_record(histogram_t* histogram, uint64_t value);
+
+// Returns the number of values recorded
+size_t histogram_count(const histogram_t* histogram);
+
+// Returns the largest value recorded, 0 if there is none
+uint64_t histogram_max(const histogram_t* histogram);
+
+// Returns the value below or at which percentile (between 0 and 100) percent of the recorded values are, as the
+// highest value of its bucket but no more than the largest value recorded; 0 if nothing was recorded
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile);
+
+// Adds every value recorded in from to into, as if they had been recorded there too
+void histogram_merge(histogram_t* into, const histogram_t* from);
+
+// Forgets every recorded value
+void histogram_reset(histogram_t* histogram);
+
+// Frees the histogram
+void histogram_destroy(histogram_t* histogram);
+
+#endif // HISTOGRAM_H
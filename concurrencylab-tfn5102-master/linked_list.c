@@ -1,6 +1,63 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include "linked_list.h"
 
+// Smallest number of buckets of a list index
+#define LIST_INDEX_MIN 16
+
+// Returns the index bucket of data
+static size_t list_bucket(const list_t* list, const void* data)
+{
+    // Pointers are aligned, so the low bits carry little information; a multiplicative hash spreads them out
+    uint64_t hash = (uint64_t)(uintptr_t)data * UINT64_C(0x9E3779B97F4A7C15);
+    return (size_t)(hash >> 32) & list->index_mask;
+}
+
+// Replaces the index with one of the given number of buckets holding every node of the list
+// Returns false, leaving the old index in place, if the buckets could not be allocated
+static bool list_rebuild_index(list_t* list, size_t buckets)
+{
+    list_node_t** index = (list_node_t**)calloc(buckets, sizeof(list_node_t*));
+    if (index == NULL) {
+        return false;
+    }
+    free(list->index);
+    list->index = index;
+    list->index_mask = buckets - 1;
+    // Pushing the nodes from the tail keeps every bucket in list order, so list_find returns the first match
+    for (list_node_t* node = list->tail; node != NULL; node = node->prev) {
+        size_t bucket = list_bucket(list, node->data);
+        node->index_next = index[bucket];
+        index[bucket] = node;
+    }
+    return true;
+}
+
+// Adds a node just linked at the tail of the list to the end of its bucket
+static void list_index_add(list_t* list, list_node_t* node)
+{
+    if (list->count > 2 * (list->index_mask + 1) && list_rebuild_index(list, 2 * (list->index_mask + 1))) {
+        return;
+    }
+    node->index_next = NULL;
+    list_node_t** link = &list->index[list_bucket(list, node->data)];
+    while (*link != NULL) {
+        link = &(*link)->index_next;
+    }
+    *link = node;
+}
+
+// Takes a node out of its bucket
+static void list_index_remove(list_t* list, list_node_t* node)
+{
+    list_node_t** link = &list->index[list_bucket(list, node->data)];
+    while (*link != node) {
+        link = &(*link)->index_next;
+    }
+    *link = node->index_next;
+    node->index_next = NULL;
+}
+
 /*
 // Initializes a singly linked list
 // If compare is NULL, the list is unsorted and new nodes are inserted at the head of the list
@@ -88,12 +145,24 @@ void linked_list_remove(linked_list_t* list, shape_t* shape)
 */
 // Creates and returns a new list
 list_t* list_create()
+{
+    return list_create_pooled(0);
+}
+
+// Creates and returns a new list that keeps up to spare_limit removed nodes and hands them to later inserts,
+// so a list whose length goes up and down stops calling malloc and free once it has grown
+list_t* list_create_pooled(size_t spare_limit)
 {
     list_t* list = (list_t*)malloc(sizeof(list_t));
     if (list != NULL) {
         list->head = NULL;
         list->tail = NULL;
         list->count = 0;
+        list->spare = NULL;
+        list->spare_count = 0;
+        list->spare_limit = spare_limit;
+        list->index = NULL;
+        list->index_mask = 0;
     }
     return list;
 }
@@ -108,6 +177,12 @@ void list_destroy(list_t* list)
         free(current);
         current = next;
     }
+    while (list->spare != NULL) {
+        list_node_t* next = list->spare->next;
+        free(list->spare);
+        list->spare = next;
+    }
+    free(list->index);
 
     free(list);
     
@@ -161,6 +236,7 @@ size_t list_count(list_t* list)
 }
 
 // Finds the first node in the list with the given data
+// Walks the list, or only the nodes with the same hash once list_enable_index has been called
 // Returns NULL if data could not be found
 list_node_t* list_find(list_t* list, void* data)
 {
@@ -169,8 +245,16 @@ list_node_t* list_find(list_t* list, void* data)
         return NULL;
       }
 
+    if (list->index != NULL) {
+        for (list_node_t* node = list->index[list_bucket(list, data)]; node != NULL; node = node->index_next) {
+            if (node->data == data) {
+                return node;
+            }
+        }
+        return NULL;
+    }
     list_node_t* new_node = list->head;
-    while(data != NULL)
+    while(new_node != NULL)
     {
         if(new_node->data == data)
         {
@@ -181,37 +265,61 @@ list_node_t* list_find(list_t* list, void* data)
     return NULL; // Couldn't be found
 }
 
+// Keeps a hash index of the nodes by data from now on, so list_find takes constant time on average
+// Returns false if the index could not be allocated, in which case list_find keeps walking the list
+bool list_enable_index(list_t* list)
+{
+    if (list->index != NULL) {
+        return true;
+    }
+    size_t buckets = LIST_INDEX_MIN;
+    while (buckets < list->count) {
+        buckets <<= 1;
+    }
+    return list_rebuild_index(list, buckets);
+}
+
 // Inserts a new node in the list with the given data
 // Returns new node inserted
 list_node_t* list_insert(list_t* list, void* data)
 {
-    list_node_t* new_node = (list_node_t*)malloc(sizeof(list_node_t));
+    list_node_t* new_node = list->spare;
+    if (new_node != NULL) {
+        list->spare = new_node->next;
+        list->spare_count--;
+    } else {
+        new_node = (list_node_t*)malloc(sizeof(list_node_t));
+    }
      
     if(!new_node)
     {
         return NULL;
     }
-    new_node->data = data;
-    // If the list is empty, insert the node as the head and tail
-    if (list->head == NULL) {
-        new_node->next = NULL;// This was missing and thus causing segfaults
-        new_node->prev = NULL;
-        list->head = new_node;
-        list->tail = new_node; // Tail needs to have something 
-    }
-    else{
-        // Insert at the end
-        new_node->next = NULL;
-        new_node->prev = list->tail;
-        list->tail->next = new_node;
-        list->tail = new_node;
-    }
-
-    list->count++;
+    list_link(list, new_node, data);
 
     return new_node;
 }
 
+// Links node, which is owned by the caller, at the tail of the list with the given data without allocating
+// The node must stay valid until it is unlinked with list_unlink
+void list_link(list_t* list, list_node_t* node, void* data)
+{
+    node->data = data;
+    node->next = NULL;
+    node->prev = list->tail;
+    // If the list is empty, the node becomes the head as well as the tail
+    if (list->tail == NULL) {
+        list->head = node;
+    } else {
+        list->tail->next = node;
+    }
+    list->tail = node;
+    list->count++;
+    if (list->index != NULL) {
+        list_index_add(list, node);
+    }
+}
+
 // Removes a node from the list and frees the node resources
 void list_remove(list_t* list, list_node_t* node)
 {
@@ -220,6 +328,22 @@ void list_remove(list_t* list, list_node_t* node)
         return;
     }
 
+    list_unlink(list, node);
+    if (list->spare_count < list->spare_limit) {
+        node->next = list->spare;
+        list->spare = node;
+        list->spare_count++;
+    } else {
+        free(node);
+    }
+}
+
+// Unlinks a node added with list_link, leaving its memory to the caller
+void list_unlink(list_t* list, list_node_t* node)
+{
+    if (list->index != NULL) {
+        list_index_remove(list, node);
+    }
     /*
     if (node == list->head) {
         list->head = node->next;
@@ -249,7 +373,8 @@ void list_remove(list_t* list, list_node_t* node)
     }
 
     list->count--;
-    free(node);
+    node->next = NULL;
+    node->prev = NULL;
     
     /*
     if (list->count == 0) {
@@ -2,23 +2,36 @@
 #define LINKED_LIST_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
+// A node of a list; list_insert allocates one, while list_link uses one embedded in the caller's own struct
 typedef struct list_node {
     struct list_node* next; // next node in list
     struct list_node* prev; // prev node in list
     void* data; // generic user-specified data pointer
+    struct list_node* index_next; // next node in the same bucket of the list index
 } list_node_t;
 
 typedef struct {
     list_node_t* head; // head of the list
     list_node_t* tail; // tail of the list
     size_t count; // count of nodes in the list
+    list_node_t* spare; // removed nodes kept for later inserts, linked through next
+    size_t spare_count; // count of nodes in spare
+    size_t spare_limit; // most nodes kept in spare, 0 for a list that frees every removed node
+    list_node_t** index; // hash buckets of the nodes by data, in list order within a bucket; NULL without index
+    size_t index_mask; // number of buckets - 1
 } list_t;
 
 // Creates and returns a new list
 list_t* list_create();
 
+// Creates and returns a new list that keeps up to spare_limit removed nodes and hands them to later inserts,
+// so a list whose length goes up and down stops calling malloc and free once it has grown
+list_t* list_create_pooled(size_t spare_limit);
+
 // Destroys a list
+// Nodes added with list_link are not freed and must have been unlinked before
 void list_destroy(list_t* list);
 
 // Returns head of the list
@@ -43,9 +56,15 @@ void* list_data(list_node_t* node);
 size_t list_count(list_t* list);
 
 // Finds the first node in the list with the given data
+// Walks the list, or only the nodes with the same hash once list_enable_index has been called
 // Returns NULL if data could not be found
 list_node_t* list_find(list_t* list, void* data);
 
+// Keeps a hash index of the nodes by data from now on, so list_find takes constant time on average
+// The index grows with the list; inserts and removals update it in constant time on average
+// Returns false if the index could not be allocated, in which case list_find keeps walking the list
+bool list_enable_index(list_t* list);
+
 // Inserts a new node in the list with the given data
 // Returns new node inserted
 list_node_t* list_insert(list_t* list, void* data);
@@ -53,4 +72,11 @@ list_node_t* list_insert(list_t* list, void* data);
 // Removes a node from the list and frees the node resources
 void list_remove(list_t* list, list_node_t* node);
 
+// Links node, which is owned by the caller, at the tail of the list with the given data without allocating
+// The node must stay valid until it is unlinked with list_unlink
+void list_link(list_t* list, list_node_t* node, void* data);
+
+// Unlinks a node added with list_link, leaving its memory to the caller
+void list_unlink(list_t* list, list_node_t* node);
+
 #endif // LINKED_LIST_H
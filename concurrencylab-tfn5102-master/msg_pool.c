@@ -0,0 +1,269 @@
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "msg_pool.h"
+
+// Number of messages a cache takes from or hands back to the shared free list at a time
+#define MSG_POOL_BATCH 32
+// Bytes of messages carved out of one slab; slabs of larger messages hold MSG_POOL_BATCH messages instead
+#define MSG_POOL_SLAB_BYTES 65536
+
+// A free message; the link lives in the message itself
+typedef struct msg_block {
+    struct msg_block* next;
+} msg_block_t;
+
+// Header at the start of every slab, followed by its messages
+typedef struct msg_slab {
+    struct msg_slab* next;
+} msg_slab_t;
+
+// Free messages of one thread, reached through the pool's pthread key
+typedef struct msg_cache {
+    msg_pool_t* pool;
+    msg_block_t* head;
+    size_t count;
+    // Links in the pool's list of caches, so destroying the pool frees the caches of threads still alive
+    struct msg_cache* prev;
+    struct msg_cache* next;
+} msg_cache_t;
+
+struct msg_pool {
+    size_t block_size; // msg_size rounded up to the alignment of malloc
+    size_t slab_blocks; // messages per slab
+    pthread_key_t key; // msg_cache_t of the calling thread
+    bool has_key; // false if no pthread key was left, then every message goes through the shared free list
+    pthread_mutex_t mutex; // guards everything below
+    msg_block_t* shared; // free messages not in any cache
+    msg_slab_t* slabs;
+    msg_cache_t* caches;
+};
+
+// Offset of the first message of a slab, keeping messages aligned like malloc
+#define MSG_POOL_SLAB_HEADER ((sizeof(msg_slab_t) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+// Moves every message of the cache to the shared free list
+// The pool mutex must be held
+static void msg_cache_flush_locked(msg_pool_t* pool, msg_cache_t* cache)
+{
+    while (cache->head != NULL) {
+        msg_block_t* block = cache->head;
+        cache->head = block->next;
+        block->next = pool->shared;
+        pool->shared = block;
+    }
+    cache->count = 0;
+}
+
+// Removes the cache from the pool's list of caches
+// The pool mutex must be held
+static void msg_cache_unlink_locked(msg_pool_t* pool, msg_cache_t* cache)
+{
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        pool->caches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+}
+
+// Destructor of the pool's pthread key: hands the messages of an exiting thread back to the pool
+static void msg_cache_exit(void* arg)
+{
+    msg_cache_t* cache = (msg_cache_t*)arg;
+    msg_pool_t* pool = cache->pool;
+    pthread_mutex_lock(&pool->mutex);
+    msg_cache_flush_locked(pool, cache);
+    msg_cache_unlink_locked(pool, cache);
+    pthread_mutex_unlock(&pool->mutex);
+    free(cache);
+}
+
+// Returns the cache of the calling thread, creating it on first use
+// Returns NULL if the pool has no pthread key or the cache could not be allocated
+static msg_cache_t* msg_cache_get(msg_pool_t* pool)
+{
+    if (!pool->has_key) {
+        return NULL;
+    }
+    msg_cache_t* cache = (msg_cache_t*)pthread_getspecific(pool->key);
+    if (cache != NULL) {
+        return cache;
+    }
+    cache = (msg_cache_t*)malloc(sizeof(msg_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->pool = pool;
+    cache->head = NULL;
+    cache->count = 0;
+    cache->prev = NULL;
+    if (pthread_setspecific(pool->key, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    cache->next = pool->caches;
+    if (pool->caches != NULL) {
+        pool->caches->prev = cache;
+    }
+    pool->caches = cache;
+    pthread_mutex_unlock(&pool->mutex);
+    return cache;
+}
+
+// Carves a new slab into messages on the shared free list
+// Returns false if the slab could not be allocated
+// The pool mutex must be held
+static bool msg_pool_grow_locked(msg_pool_t* pool)
+{
+    msg_slab_t* slab = (msg_slab_t*)malloc(MSG_POOL_SLAB_HEADER + pool->slab_blocks * pool->block_size);
+    if (slab == NULL) {
+        return false;
+    }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    char* blocks = (char*)slab + MSG_POOL_SLAB_HEADER;
+    // Pushed in reverse so the messages come out of the slab in address order
+    for (size_t i = pool->slab_blocks; i > 0; i--) {
+        msg_block_t* block = (msg_block_t*)(blocks + (i - 1) * pool->block_size);
+        block->next = pool->shared;
+        pool->shared = block;
+    }
+    return true;
+}
+
+// Creates a pool of messages of msg_size bytes, aligned like malloc
+// Returns NULL if msg_size is 0 or the pool could not be created
+msg_pool_t* msg_pool_create(size_t msg_size)
+{
+    size_t align = alignof(max_align_t);
+    // A slab of MSG_POOL_BATCH messages of the rounded-up size must not overflow its allocation size
+    if (msg_size == 0 || msg_size > (SIZE_MAX - MSG_POOL_SLAB_HEADER) / MSG_POOL_BATCH - align) {
+        return NULL;
+    }
+    msg_pool_t* pool = (msg_pool_t*)malloc(sizeof(msg_pool_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    // Every process has only PTHREAD_KEYS_MAX keys; a pool that gets none still works, only without caches
+    pool->has_key = (pthread_key_create(&pool->key, msg_cache_exit) == 0);
+    pool->block_size = (msg_size < sizeof(msg_block_t)) ? sizeof(msg_block_t) : msg_size;
+    pool->block_size = (pool->block_size + align - 1) & ~(align - 1);
+    pool->slab_blocks = MSG_POOL_SLAB_BYTES / pool->block_size;
+    if (pool->slab_blocks < MSG_POOL_BATCH) {
+        pool->slab_blocks = MSG_POOL_BATCH;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->shared = NULL;
+    pool->slabs = NULL;
+    pool->caches = NULL;
+    return pool;
+}
+
+// Returns a message of the pool, or NULL if no memory is left
+// Takes MSG_POOL_BATCH messages from the shared free list when the cache of the calling thread runs dry
+void* msg_pool_alloc(msg_pool_t* pool)
+{
+    msg_cache_t* cache = msg_cache_get(pool);
+    if (cache == NULL) {
+        // Without a cache the message comes straight from the shared free list
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->shared == NULL && !msg_pool_grow_locked(pool)) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        msg_block_t* block = pool->shared;
+        pool->shared = block->next;
+        pthread_mutex_unlock(&pool->mutex);
+        return block;
+    }
+    if (cache->head == NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->shared == NULL && !msg_pool_grow_locked(pool)) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        while (pool->shared != NULL && cache->count < MSG_POOL_BATCH) {
+            msg_block_t* block = pool->shared;
+            pool->shared = block->next;
+            block->next = cache->head;
+            cache->head = block;
+            cache->count++;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    msg_block_t* block = cache->head;
+    cache->head = block->next;
+    cache->count--;
+    return block;
+}
+
+// Gives a message of the pool back to it; any thread may release a message allocated by any other
+// Hands MSG_POOL_BATCH messages back to the shared free list once the cache of the calling thread holds twice that
+void msg_pool_release(msg_pool_t* pool, void* msg)
+{
+    if (msg == NULL) {
+        return;
+    }
+    msg_block_t* block = (msg_block_t*)msg;
+    msg_cache_t* cache = msg_cache_get(pool);
+    if (cache == NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        block->next = pool->shared;
+        pool->shared = block;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+    block->next = cache->head;
+    cache->head = block;
+    cache->count++;
+    if (cache->count < 2 * MSG_POOL_BATCH) {
+        return;
+    }
+    // Cut the oldest MSG_POOL_BATCH messages off the cache outside the lock and splice them in with one update
+    msg_block_t* last = cache->head;
+    for (size_t i = 1; i < MSG_POOL_BATCH; i++) {
+        last = last->next;
+    }
+    msg_block_t* batch = last->next;
+    last->next = NULL;
+    msg_block_t* tail = batch;
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+    cache->count = MSG_POOL_BATCH;
+    pthread_mutex_lock(&pool->mutex);
+    tail->next = pool->shared;
+    pool->shared = batch;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// Frees the pool and all of its messages, including the ones that were never released
+// No thread may use the pool or its messages any more
+void msg_pool_destroy(msg_pool_t* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    // Deleting the key keeps the exit destructor from running for the threads that are still alive
+    if (pool->has_key) {
+        pthread_key_delete(pool->key);
+    }
+    while (pool->caches != NULL) {
+        msg_cache_t* cache = pool->caches;
+        pool->caches = cache->next;
+        free(cache);
+    }
+    while (pool->slabs != NULL) {
+        msg_slab_t* slab = pool->slabs;
+        pool->slabs = slab->next;
+        free(slab);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
@@ -0,0 +1,29 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include <stddef.h>
+
+// Allocator of fixed-size messages carved out of slabs, with a cache of free messages per thread
+// A thread allocates from and releases into its own cache without locking; caches only take the pool mutex to
+// trade a batch of messages with the shared free list, so a producer allocating and a consumer releasing
+// meet there once per batch instead of contending on the allocator for every message
+// Every pool uses one pthread key for its caches; once the process runs out of keys (PTHREAD_KEYS_MAX), new pools
+// work without caches and take the pool mutex for every message
+typedef struct msg_pool msg_pool_t;
+
+// Creates a pool of messages of msg_size bytes, aligned like malloc
+// Messages of any size are carved out of 64 KiB slabs, or out of slabs of 32 messages once they are larger than 2 KiB
+// Returns NULL if msg_size is 0 or the pool could not be created
+msg_pool_t* msg_pool_create(size_t msg_size);
+
+// Returns a message of the pool, or NULL if no memory is left
+void* msg_pool_alloc(msg_pool_t* pool);
+
+// Gives a message of the pool back to it; any thread may release a message allocated by any other
+void msg_pool_release(msg_pool_t* pool, void* msg);
+
+// Frees the pool and all of its messages, including the ones that were never released
+// No thread may use the pool or its messages any more
+void msg_pool_destroy(msg_pool_t* pool);
+
+#endif // MSG_POOL_H
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "spill_queue.h"
+
+typedef struct spill_segment {
+    struct spill_segment* next;
+    int fd;
+    // slots values of elem_size bytes, mapped from the segment file
+    char* values;
+} spill_segment_t;
+
+struct spill_queue {
+    size_t elem_size;
+    size_t slots; // values per segment
+    char* path; // mkstemp template of the segment files
+    char* name; // scratch copy of path that mkstemp fills in
+    spill_segment_t* head; // segment of the oldest value
+    spill_segment_t* tail; // segment the next value goes into, NULL while no segment was created
+    size_t head_index; // slot of the oldest value in head
+    size_t tail_index; // slot of the next value in tail
+    size_t size;
+    size_t segments; // segments created, including the spare
+    spill_segment_t* spare;
+};
+
+// Returns the bytes of one segment file
+static size_t segment_bytes(const spill_queue_t* queue)
+{
+    return queue->slots * queue->elem_size;
+}
+
+// Returns a segment to append to the queue, the spare one if there is one
+// New segments get a fresh file that is unlinked as soon as it is mapped
+// Returns NULL if it could not be created
+static spill_segment_t* segment_get(spill_queue_t* queue)
+{
+    spill_segment_t* segment = queue->spare;
+    if (segment != NULL) {
+        queue->spare = NULL;
+        segment->next = NULL;
+        return segment;
+    }
+    segment = (spill_segment_t*)malloc(sizeof(spill_segment_t));
+    if (segment == NULL) {
+        return NULL;
+    }
+    strcpy(queue->name, queue->path);
+    segment->fd = mkstemp(queue->name);
+    if (segment->fd < 0) {
+        free(segment);
+        return NULL;
+    }
+    unlink(queue->name);
+    size_t bytes = segment_bytes(queue);
+    void* values = MAP_FAILED;
+    if (ftruncate(segment->fd, (off_t)bytes) == 0) {
+        values = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    }
+    if (values == MAP_FAILED) {
+        close(segment->fd);
+        free(segment);
+        return NULL;
+    }
+    // Values are written and read back front to back
+    madvise(values, bytes, MADV_SEQUENTIAL);
+    segment->values = (char*)values;
+    segment->next = NULL;
+    queue->segments++;
+    return segment;
+}
+
+// Unmaps and closes a segment, which frees its file as it is already unlinked
+static void segment_free(spill_queue_t* queue, spill_segment_t* segment)
+{
+    munmap(segment->values, segment_bytes(queue));
+    close(segment->fd);
+    free(segment);
+}
+
+// Keeps a drained segment as the spare, or frees it if there already is one
+static void segment_put(spill_queue_t* queue, spill_segment_t* segment)
+{
+    if (queue->spare == NULL) {
+        queue->spare = segment;
+    } else {
+        segment_free(queue, segment);
+        queue->segments--;
+    }
+}
+
+// Creates an empty queue of elem_size (at least 1) byte values with its segments in dir, P_tmpdir if NULL
+// Returns NULL if elem_size is 0 or the queue could not be allocated
+spill_queue_t* spill_queue_create(const char* dir, size_t elem_size)
+{
+    if (elem_size == 0) {
+        return NULL;
+    }
+    if (dir == NULL) {
+        dir = P_tmpdir;
+    }
+    spill_queue_t* queue = (spill_queue_t*)malloc(sizeof(spill_queue_t));
+    if (queue == NULL) {
+        return NULL;
+    }
+    size_t length = strlen(dir) + sizeof("/channel-spill-XXXXXX");
+    queue->path = (char*)malloc(length);
+    queue->name = (char*)malloc(length);
+    if (queue->path == NULL || queue->name == NULL) {
+        free(queue->path);
+        free(queue->name);
+        free(queue);
+        return NULL;
+    }
+    snprintf(queue->path, length, "%s/channel-spill-XXXXXX", dir);
+    queue->elem_size = elem_size;
+    queue->slots = (elem_size < SPILL_QUEUE_SEGMENT_BYTES) ? SPILL_QUEUE_SEGMENT_BYTES / elem_size : 1;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->head_index = 0;
+    queue->tail_index = 0;
+    queue->size = 0;
+    queue->segments = 0;
+    queue->spare = NULL;
+    return queue;
+}
+
+// Appends up to count values from items in order
+// Returns the number of values appended, less than count only if a segment could not be created
+size_t spill_queue_push_batch(spill_queue_t* queue, void** items, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (queue->tail == NULL || queue->tail_index == queue->slots) {
+            spill_segment_t* segment = segment_get(queue);
+            if (segment == NULL) {
+                return i;
+            }
+            if (queue->tail == NULL) {
+                queue->head = segment;
+                queue->head_index = 0;
+            } else {
+                queue->tail->next = segment;
+            }
+            queue->tail = segment;
+            queue->tail_index = 0;
+        }
+        memcpy(queue->tail->values + queue->tail_index++ * queue->elem_size, items[i], queue->elem_size);
+        queue->size++;
+    }
+    return count;
+}
+
+// Removes up to max values in FIFO order into out
+// Returns the number of values removed
+size_t spill_queue_pop_batch(spill_queue_t* queue, void** out, size_t max)
+{
+    size_t count = 0;
+    while (count < max && queue->size != 0) {
+        memcpy(out[count], queue->head->values + queue->head_index++ * queue->elem_size, queue->elem_size);
+        count++;
+        queue->size--;
+        if (queue->size == 0) {
+            // Drained: start over at the beginning of the tail segment instead of creating a new one
+            queue->head = queue->tail;
+            queue->head_index = 0;
+            queue->tail_index = 0;
+        } else if (queue->head_index == queue->slots) {
+            spill_segment_t* drained = queue->head;
+            queue->head = drained->next;
+            queue->head_index = 0;
+            segment_put(queue, drained);
+        }
+    }
+    return count;
+}
+
+// Returns the number of values in the queue
+size_t spill_queue_size(const spill_queue_t* queue)
+{
+    return queue->size;
+}
+
+// Returns the bytes the queue holds allocated on the heap, which does not include its segments
+size_t spill_queue_bytes(const spill_queue_t* queue)
+{
+    return sizeof(spill_queue_t) + 2 * (strlen(queue->path) + 1) + queue->segments * sizeof(spill_segment_t);
+}
+
+// Returns the bytes of segment files the queue holds, including its spare segment
+size_t spill_queue_file_bytes(const spill_queue_t* queue)
+{
+    return queue->segments * segment_bytes(queue);
+}
+
+// Unmaps and closes every segment and frees the queue
+void spill_queue_destroy(spill_queue_t* queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    spill_segment_t* segment = queue->head;
+    while (segment != NULL) {
+        spill_segment_t* next = segment->next;
+        segment_free(queue, segment);
+        segment = next;
+    }
+    if (queue->spare != NULL) {
+        segment_free(queue, queue->spare);
+    }
+    free(queue->path);
+    free(queue->name);
+    free(queue);
+}
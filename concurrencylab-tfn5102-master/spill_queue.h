@@ -0,0 +1,40 @@
+#ifndef SPILL_QUEUE_H
+#define SPILL_QUEUE_H
+
+#include <stddef.h>
+
+// Bytes of one segment file of a spill queue
+#define SPILL_QUEUE_SEGMENT_BYTES (4 * 1024 * 1024)
+
+// Unbounded FIFO queue of elem_size byte values kept in append-only segment files that are memory-mapped while
+// they hold values, so what the queue holds is backed by disk rather than by anonymous memory
+// Segments are created in a directory and unlinked right away, so nothing is left behind if the process dies;
+// a drained segment is unmapped and closed, except for one spare segment kept for reuse like in chunk_queue_t
+// Values are copied in and out through the caller's pointers; the queue does no locking of its own
+typedef struct spill_queue spill_queue_t;
+
+// Creates an empty queue of elem_size (at least 1) byte values with its segments in dir, P_tmpdir if NULL
+// Returns NULL if elem_size is 0 or the queue could not be allocated
+spill_queue_t* spill_queue_create(const char* dir, size_t elem_size);
+
+// Appends up to count values from items in order
+// Returns the number of values appended, less than count only if a segment could not be created
+size_t spill_queue_push_batch(spill_queue_t* queue, void** items, size_t count);
+
+// Removes up to max values in FIFO order into out
+// Returns the number of values removed
+size_t spill_queue_pop_batch(spill_queue_t* queue, void** out, size_t max);
+
+// Returns the number of values in the queue
+size_t spill_queue_size(const spill_queue_t* queue);
+
+// Returns the bytes the queue holds allocated on the heap, which does not include its segments
+size_t spill_queue_bytes(const spill_queue_t* queue);
+
+// Returns the bytes of segment files the queue holds, including its spare segment
+size_t spill_queue_file_bytes(const spill_queue_t* queue);
+
+// Unmaps and closes every segment and frees the queue
+void spill_queue_destroy(spill_queue_t* queue);
+
+#endif // SPILL_QUEUE_H
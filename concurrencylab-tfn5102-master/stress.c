@@ -20,6 +20,7 @@ static size_t num_channel;
 static channel_t** channels;
 static channel_t* done_channel;
 static channel_t* completed_channel;
+static bool use_select_set;
 
 distance_t get_link_distance(size_t src, size_t dst) {
     return topology[src * num_channel + dst];
@@ -174,8 +175,25 @@ void* router(void* arg)
             select_count++;
         }
     }
+    // with a select set the cases are registered once; sends that went out are disabled until the next broadcast
+    select_set_t* select_set = NULL;
+    if (use_select_set) {
+        select_set = select_set_create(total_select_count);
+        assert(select_set != NULL);
+        for (size_t i = 0; i < select_count; i++) {
+            size_t added_index;
+            enum channel_status status = select_set_add(select_set, &select_list[i], &added_index);
+            assert(status == SUCCESS);
+            assert(added_index == i);
+        }
+    }
     while (true) {
-        enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        enum channel_status status;
+        if (use_select_set) {
+            status = select_set_wait(select_set, &selected_index);
+        } else {
+            status = channel_select(select_list, select_count, &selected_index);
+        }
         if (status == SUCCESS) {
             assert(selected_index != 0);
             if (selected_index == 1) {
@@ -199,10 +217,15 @@ void* router(void* arg)
                 }
             } else {
                 select_count--;
-                // swap last element and selected element
-                channel_t* temp = select_list[select_count].channel;
-                select_list[select_count].channel = select_list[selected_index].channel;
-                select_list[selected_index].channel = temp;
+                if (use_select_set) {
+                    status = select_set_disable(select_set, selected_index);
+                    assert(status == SUCCESS);
+                } else {
+                    // swap last element and selected element
+                    channel_t* temp = select_list[select_count].channel;
+                    select_list[select_count].channel = select_list[selected_index].channel;
+                    select_list[selected_index].channel = temp;
+                }
             }
             // check if we've sent to everyone
             if (select_count == 2) {
@@ -222,6 +245,10 @@ void* router(void* arg)
                     select_count = total_select_count;
                     for (size_t i = 2; i < select_count; i++) {
                         select_list[i].data = curr_state;
+                        if (use_select_set) {
+                            status = select_set_enable(select_set, i);
+                            assert(status == SUCCESS);
+                        }
                     }
                     changed = false;
                 }
@@ -233,6 +260,9 @@ void* router(void* arg)
             break;
         }
     }
+    if (use_select_set) {
+        select_set_destroy(select_set);
+    }
     free(select_list);
     free(prev_prev_state);
     free(prev_state);
@@ -300,6 +330,11 @@ bool check_done()
 }
 
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename)
+{
+    run_stress_kind(main_buffer_size, secondary_buffer_size, filename, false);
+}
+
+void run_stress_kind(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, bool select_set)
 {
     assert(main_buffer_size <= 1); // only support up to a buffer size of 1
     assert(secondary_buffer_size <= 1); // only support up to a buffer size of 1
@@ -317,6 +352,7 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     assert(done_channel != NULL);
     completed_channel = channel_create(secondary_buffer_size);
     assert(completed_channel != NULL);
+    use_select_set = select_set;
 
     pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
     assert(pid != NULL);
@@ -1,6 +1,12 @@
 #ifndef STRESS_H
 #define STRESS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename);
 
+// Same as run_stress with each router waiting on a persistent select set instead of calling channel_select
+void run_stress_kind(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, bool select_set);
+
 #endif // STRESS_H
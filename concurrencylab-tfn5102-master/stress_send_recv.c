@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdatomic.h>
+#include <time.h>
 #include "channel.h"
 #include "stress_send_recv.h"
 
@@ -11,6 +12,7 @@ static size_t num_channel;
 static channel_t** channels;
 static atomic_bool done;
 static channel_t* main_channel;
+static atomic_size_t num_hops;
 
 void* worker_thread(void* arg)
 {
@@ -22,6 +24,7 @@ void* worker_thread(void* arg)
     channel_t* my_channel = channels[index];
     channel_t* next_channel = channels[next_index];
     bool start = true;
+    size_t hops = 0;
     enum channel_status status;
     while (true) {
         void* data = NULL;
@@ -49,17 +52,26 @@ void* worker_thread(void* arg)
             // Pass along message to next thread in ring
             status = channel_send(next_channel, data);
             assert(status == SUCCESS);
+            hops++;
         }
     }
+    atomic_fetch_add(&num_hops, hops);
     return NULL;
 }
 
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
+{
+    run_stress_send_recv_kind(CHANNEL_LOCKED, buffer_size, num_threads, load, duration_usec);
+}
+
+double run_stress_send_recv_kind(enum channel_kind kind, size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
 {
     enum channel_status status;
+    struct timespec start_time, end_time;
     // setup
     num_channel = num_threads;
     atomic_store(&done, false);
+    atomic_store(&num_hops, 0);
     size_t num_msgs = (size_t)(((double)(num_channel * (buffer_size + 1))) * load);
     bool* msg_check = calloc(num_msgs + 1, sizeof(bool));
     assert(msg_check != NULL);
@@ -67,10 +79,12 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(buffer_size);
+        // ring links only have a single receiver and a single sender at a time
+        channels[i] = channel_create_kind(buffer_size, kind);
         assert(channels[i] != NULL);
     }
-    main_channel = channel_create(buffer_size);
+    // main_channel is read by every worker, so it cannot be single consumer
+    main_channel = channel_create_kind(buffer_size, (kind == CHANNEL_SPSC) ? CHANNEL_LOCKED : kind);
     assert(main_channel != NULL);
 
     pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
@@ -93,10 +107,12 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     }
 
     // wait for duration
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
     usleep(duration_usec);
 
     // stop test
     atomic_store(&done, true);
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
     for (size_t msg = 1; msg <= num_msgs; msg++) {
         // pull data from threads
         size_t data = 0;
@@ -133,4 +149,7 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     free(msg_check);
     free(pid);
     free(channels);
+
+    double seconds = (double)(end_time.tv_sec - start_time.tv_sec) + (double)(end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    return (double)atomic_load(&num_hops) / seconds;
 }
@@ -1,6 +1,12 @@
 #ifndef STRESS_SEND_RECV_H
 #define STRESS_SEND_RECV_H
 
+#include "channel.h"
+
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
 
+// Same as run_stress_send_recv with the ring links created as the given kind of channel
+// Returns the number of ring hops per second
+double run_stress_send_recv_kind(enum channel_kind kind, size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
+
 #endif // STRESS_SEND_RECV_H
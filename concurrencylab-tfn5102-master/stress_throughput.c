@@ -0,0 +1,1431 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+#include "channel.h"
+#include "stress_throughput.h"
+#include "timer.h"
+#include "broadcast.h"
+
+static channel_t* channel;
+static atomic_bool* msg_check;
+static size_t num_msgs;
+static size_t num_senders;
+static size_t batch_size;
+
+void* throughput_sender(void* arg)
+{
+    size_t index = (size_t)arg;
+    void** items = malloc(sizeof(void*) * batch_size);
+    assert(items != NULL);
+    // messages are numbered from 1 so NULL stays free as the stop message
+    size_t msg = index + 1;
+    while (msg <= num_msgs) {
+        size_t count = 0;
+        for (; count < batch_size && msg <= num_msgs; msg += num_senders) {
+            items[count++] = (void*)msg;
+        }
+        enum channel_status status;
+        if (batch_size == 1) {
+            status = channel_send(channel, items[0]);
+        } else {
+            size_t sent;
+            status = channel_send_batch(channel, items, count, &sent);
+            assert(sent == count);
+        }
+        assert(status == SUCCESS);
+    }
+    free(items);
+    return NULL;
+}
+
+void* throughput_receiver(void* arg)
+{
+    void** items = malloc(sizeof(void*) * batch_size);
+    assert(items != NULL);
+    size_t stops = 0;
+    while (stops == 0) {
+        size_t received = 1;
+        enum channel_status status;
+        if (batch_size == 1) {
+            status = channel_receive(channel, &items[0]);
+        } else {
+            status = channel_receive_batch(channel, items, batch_size, &received);
+        }
+        assert(status == SUCCESS);
+        for (size_t i = 0; i < received; i++) {
+            if (items[i] == NULL) {
+                stops++;
+                continue;
+            }
+            size_t msg = (size_t)items[i];
+            assert((1 <= msg) && (msg <= num_msgs));
+            bool duplicate = atomic_exchange(&msg_check[msg], true);
+            assert(!duplicate);
+        }
+    }
+    // a batch may have picked up the stop messages of other receivers, pass them back
+    for (size_t i = 1; i < stops; i++) {
+        enum channel_status status = channel_send(channel, NULL);
+        assert(status == SUCCESS);
+    }
+    free(items);
+    return NULL;
+}
+
+double run_stress_throughput(enum channel_kind kind, size_t buffer_size, size_t senders, size_t receivers, size_t msgs, size_t batch)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    // setup
+    num_msgs = msgs;
+    num_senders = senders;
+    batch_size = batch;
+    msg_check = calloc(num_msgs + 1, sizeof(atomic_bool));
+    assert(msg_check != NULL);
+    channel = channel_create_kind(buffer_size, kind);
+    assert(channel != NULL);
+    pthread_t* send_pid = malloc(sizeof(pthread_t) * senders);
+    assert(send_pid != NULL);
+    pthread_t* recv_pid = malloc(sizeof(pthread_t) * receivers);
+    assert(recv_pid != NULL);
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < receivers; i++) {
+        int pthread_status = pthread_create(&recv_pid[i], NULL, throughput_receiver, NULL);
+        assert(pthread_status == 0);
+    }
+    for (size_t i = 0; i < senders; i++) {
+        int pthread_status = pthread_create(&send_pid[i], NULL, throughput_sender, (void*)i);
+        assert(pthread_status == 0);
+    }
+    for (size_t i = 0; i < senders; i++) {
+        pthread_join(send_pid[i], NULL);
+    }
+    for (size_t i = 0; i < receivers; i++) {
+        // send stop message
+        status = channel_send(channel, NULL);
+        assert(status == SUCCESS);
+    }
+    for (size_t i = 0; i < receivers; i++) {
+        pthread_join(recv_pid[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // check that no message was lost
+    for (size_t msg = 1; msg <= num_msgs; msg++) {
+        assert(atomic_load(&msg_check[msg]));
+    }
+
+    // cleanup
+    status = channel_close(channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(channel);
+    assert(status == SUCCESS);
+    free(msg_check);
+    free(send_pid);
+    free(recv_pid);
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)num_msgs / seconds;
+}
+
+static channel_t* ping_channel;
+static channel_t* pong_channel;
+// deadline of the timed ping-pong, NULL for the untimed one
+static const struct timespec* ping_deadline;
+
+static enum channel_status ping_pong_send(channel_t* target, void* data)
+{
+    return (ping_deadline == NULL) ? channel_send(target, data) : channel_send_until(target, data, ping_deadline);
+}
+
+static enum channel_status ping_pong_receive(channel_t* source, void** data)
+{
+    return (ping_deadline == NULL) ? channel_receive(source, data) : channel_receive_until(source, data, ping_deadline);
+}
+
+void* ping_pong_responder(void* arg)
+{
+    size_t round_trips = (size_t)arg;
+    for (size_t i = 1; i <= round_trips; i++) {
+        void* data = NULL;
+        enum channel_status status = ping_pong_receive(ping_channel, &data);
+        assert(status == SUCCESS);
+        assert((size_t)data == i);
+        status = ping_pong_send(pong_channel, data);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+double run_ping_pong(const channel_options_t* options, size_t buffer_size, size_t round_trips, bool timed)
+{
+    enum channel_status status;
+    struct timespec start, end, deadline;
+    // setup
+    ping_channel = channel_create_options(buffer_size, options);
+    assert(ping_channel != NULL);
+    pong_channel = channel_create_options(buffer_size, options);
+    assert(pong_channel != NULL);
+    // a deadline that is never hit, so the timed run only measures the cost of carrying it
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += 3600;
+    ping_deadline = timed ? &deadline : NULL;
+    pthread_t pid;
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&pid, NULL, ping_pong_responder, (void*)round_trips);
+    assert(pthread_status == 0);
+    for (size_t i = 1; i <= round_trips; i++) {
+        void* data = NULL;
+        status = ping_pong_send(ping_channel, (void*)i);
+        assert(status == SUCCESS);
+        status = ping_pong_receive(pong_channel, &data);
+        assert(status == SUCCESS);
+        assert((size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    status = channel_close(ping_channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(ping_channel);
+    assert(status == SUCCESS);
+    status = channel_close(pong_channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(pong_channel);
+    assert(status == SUCCESS);
+
+    double nanoseconds = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return nanoseconds / (double)round_trips;
+}
+
+// Ring indices laid out like the old buffer_t, with both counters on one cache line
+typedef struct {
+    atomic_size_t head;
+    atomic_size_t tail;
+} packed_indices_t;
+
+// Ring indices laid out like buffer_t, with each counter on its own cache line
+typedef struct {
+    _Alignas(BUFFER_CACHE_LINE) atomic_size_t head;
+    _Alignas(BUFFER_CACHE_LINE) atomic_size_t tail;
+} padded_indices_t;
+
+static buffer_t* layout_buffer;
+static atomic_size_t* layout_head;
+static atomic_size_t* layout_tail;
+static size_t layout_msgs;
+static atomic_llong layout_misses;
+
+// Pins the calling thread to cpu, or to the last CPU if cpu is out of range
+static void pin_thread(long cpu)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu >= cpus) {
+        cpu = cpus - 1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Starts counting the hardware cache misses of the calling thread
+// Returns the counter, or -1 if the kernel or machine does not provide one
+static int cache_miss_counter_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Adds the misses counted by counter to layout_misses and closes it; marks the total unavailable if counter is -1
+static void cache_miss_counter_close(int counter)
+{
+    long long misses = 0;
+    if (counter < 0 || read(counter, &misses, sizeof(misses)) != sizeof(misses)) {
+        atomic_store(&layout_misses, -1);
+    } else if (atomic_load(&layout_misses) >= 0) {
+        atomic_fetch_add(&layout_misses, misses);
+    }
+    if (counter >= 0) {
+        close(counter);
+    }
+}
+
+void* layout_producer(void* arg)
+{
+    pin_thread(0);
+    int counter = cache_miss_counter_open();
+    for (size_t msg = 1; msg <= layout_msgs; msg++) {
+        size_t tail = atomic_load_explicit(layout_tail, memory_order_relaxed);
+        while (tail - atomic_load_explicit(layout_head, memory_order_acquire) == layout_buffer->capacity) {
+            sched_yield();
+        }
+        void* item = (void*)msg;
+        buffer_write_at(layout_buffer, tail, &item, 1);
+        atomic_store_explicit(layout_tail, tail + 1, memory_order_release);
+    }
+    cache_miss_counter_close(counter);
+    return NULL;
+}
+
+void* layout_consumer(void* arg)
+{
+    // the CPU furthest from the producer, which is on the other socket on typical 2-socket numbering
+    pin_thread(sysconf(_SC_NPROCESSORS_ONLN) - 1);
+    int counter = cache_miss_counter_open();
+    for (size_t msg = 1; msg <= layout_msgs; msg++) {
+        size_t head = atomic_load_explicit(layout_head, memory_order_relaxed);
+        while (atomic_load_explicit(layout_tail, memory_order_acquire) == head) {
+            sched_yield();
+        }
+        void* item;
+        buffer_read_at(layout_buffer, head, &item, 1);
+        assert((size_t)item == msg);
+        atomic_store_explicit(layout_head, head + 1, memory_order_release);
+    }
+    cache_miss_counter_close(counter);
+    return NULL;
+}
+
+double run_ring_layout(bool padded, size_t buffer_size, size_t msgs, double* misses_per_msg)
+{
+    struct timespec start, end;
+    // setup
+    packed_indices_t packed;
+    padded_indices_t padding;
+    if (padded) {
+        atomic_init(&padding.head, 0);
+        atomic_init(&padding.tail, 0);
+        layout_head = &padding.head;
+        layout_tail = &padding.tail;
+    } else {
+        atomic_init(&packed.head, 0);
+        atomic_init(&packed.tail, 0);
+        layout_head = &packed.head;
+        layout_tail = &packed.tail;
+    }
+    layout_buffer = buffer_create(buffer_size);
+    assert(layout_buffer != NULL);
+    layout_msgs = msgs;
+    atomic_store(&layout_misses, 0);
+    pthread_t producer, consumer;
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&consumer, NULL, layout_consumer, NULL);
+    assert(pthread_status == 0);
+    pthread_status = pthread_create(&producer, NULL, layout_producer, NULL);
+    assert(pthread_status == 0);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    buffer_free(layout_buffer);
+
+    long long misses = atomic_load(&layout_misses);
+    *misses_per_msg = (misses < 0) ? -1.0 : (double)misses / (double)msgs;
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)msgs / seconds;
+}
+
+static channel_t* herd_channel;
+
+void* herd_selector(void* arg)
+{
+    select_t list[1];
+    list[0].channel = herd_channel;
+    list[0].dir = RECV;
+    while (true) {
+        size_t index;
+        enum channel_status status = channel_select(list, 1, &index);
+        assert(status == SUCCESS);
+        assert(index == 0);
+        if (list[0].data == NULL) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+double run_select_herd(size_t selectors, size_t msgs, double* switches_per_msg)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    struct rusage usage_start, usage_end;
+    // setup
+    herd_channel = channel_create(1);
+    assert(herd_channel != NULL);
+    pthread_t* pid = malloc(sizeof(pthread_t) * selectors);
+    assert(pid != NULL);
+    for (size_t i = 0; i < selectors; i++) {
+        int pthread_status = pthread_create(&pid[i], NULL, herd_selector, NULL);
+        assert(pthread_status == 0);
+    }
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    getrusage(RUSAGE_SELF, &usage_start);
+    for (size_t msg = 1; msg <= msgs; msg++) {
+        status = channel_send(herd_channel, (void*)msg);
+        assert(status == SUCCESS);
+    }
+    getrusage(RUSAGE_SELF, &usage_end);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (size_t i = 0; i < selectors; i++) {
+        // send stop message
+        status = channel_send(herd_channel, NULL);
+        assert(status == SUCCESS);
+    }
+    for (size_t i = 0; i < selectors; i++) {
+        pthread_join(pid[i], NULL);
+    }
+
+    // cleanup
+    status = channel_close(herd_channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(herd_channel);
+    assert(status == SUCCESS);
+    free(pid);
+
+    long switches = (usage_end.ru_nvcsw - usage_start.ru_nvcsw) + (usage_end.ru_nivcsw - usage_start.ru_nivcsw);
+    *switches_per_msg = (double)switches / (double)msgs;
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)msgs / seconds;
+}
+
+static channel_t** scale_channels;
+static channel_t* scale_ack;
+static size_t scale_count;
+static enum select_scale_mode scale_mode;
+
+void* scale_selector(void* arg)
+{
+    select_t* list = malloc(sizeof(select_t) * scale_count);
+    assert(list != NULL);
+    for (size_t i = 0; i < scale_count; i++) {
+        list[i].channel = scale_channels[i];
+        list[i].dir = RECV;
+    }
+    select_set_t* set = NULL;
+    if (scale_mode == SCALE_SELECT_SET) {
+        set = select_set_create(scale_count);
+        assert(set != NULL);
+        for (size_t i = 0; i < scale_count; i++) {
+            size_t index;
+            enum channel_status status = select_set_add(set, &list[i], &index);
+            assert(status == SUCCESS);
+        }
+    }
+    select_waiter_t* waiter = NULL;
+    if (scale_mode == SCALE_SELECT_WITH) {
+        waiter = select_waiter_create();
+        assert(waiter != NULL);
+    }
+    while (true) {
+        size_t index;
+        enum channel_status status;
+        if (scale_mode == SCALE_SELECT_SET) {
+            status = select_set_wait(set, &index);
+        } else if (scale_mode == SCALE_SELECT_WITH) {
+            status = channel_select_with(waiter, list, scale_count, &index, NULL);
+        } else {
+            status = channel_select(list, scale_count, &index);
+        }
+        assert(status == SUCCESS);
+        if (list[index].data == NULL) {
+            break;
+        }
+        status = channel_send(scale_ack, NULL);
+        assert(status == SUCCESS);
+    }
+    select_set_destroy(set);
+    select_waiter_destroy(waiter);
+    free(list);
+    return NULL;
+}
+
+double run_select_scale(size_t channels, size_t msgs, enum select_scale_mode mode)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    // setup
+    scale_count = channels;
+    scale_mode = mode;
+    scale_channels = malloc(sizeof(channel_t*) * channels);
+    assert(scale_channels != NULL);
+    for (size_t i = 0; i < channels; i++) {
+        scale_channels[i] = channel_create(1);
+        assert(scale_channels[i] != NULL);
+    }
+    scale_ack = channel_create(1);
+    assert(scale_ack != NULL);
+    pthread_t pid;
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&pid, NULL, scale_selector, NULL);
+    assert(pthread_status == 0);
+    // walk the channels with a stride so consecutive messages land far apart in the select list,
+    // waiting for each one to be acknowledged so the selector parks on every channel every time
+    size_t stride = (channels > 7) ? 7 : 1;
+    for (size_t msg = 1; msg <= msgs; msg++) {
+        status = channel_send(scale_channels[(msg * stride) % channels], (void*)msg);
+        assert(status == SUCCESS);
+        void* ack;
+        status = channel_receive(scale_ack, &ack);
+        assert(status == SUCCESS);
+    }
+    // send stop message
+    status = channel_send(scale_channels[channels - 1], NULL);
+    assert(status == SUCCESS);
+    pthread_join(pid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    for (size_t i = 0; i < channels; i++) {
+        status = channel_close(scale_channels[i]);
+        assert(status == SUCCESS);
+        status = channel_destroy(scale_channels[i]);
+        assert(status == SUCCESS);
+    }
+    free(scale_channels);
+    status = channel_close(scale_ack);
+    assert(status == SUCCESS);
+    status = channel_destroy(scale_ack);
+    assert(status == SUCCESS);
+
+    double nanoseconds = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return nanoseconds / (double)msgs;
+}
+
+static channel_t** fairness_channels;
+static struct timespec** fairness_stamps;
+static size_t fairness_msgs;
+
+static double elapsed_ns(const struct timespec* start, const struct timespec* end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e9 + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void* fairness_sender(void* arg)
+{
+    size_t index = (size_t)arg;
+    // each message points at the time it was handed to channel_send, so blocking in a full channel counts as latency
+    for (size_t msg = 0; msg < fairness_msgs; msg++) {
+        clock_gettime(CLOCK_MONOTONIC, &fairness_stamps[index][msg]);
+        if (channel_send(fairness_channels[index], &fairness_stamps[index][msg]) != SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+void run_select_fairness(enum select_policy policy, size_t cases, size_t msgs, select_case_latency_t* latencies)
+{
+    enum channel_status status;
+    // setup
+    fairness_msgs = msgs;
+    fairness_channels = malloc(sizeof(channel_t*) * cases);
+    assert(fairness_channels != NULL);
+    fairness_stamps = malloc(sizeof(struct timespec*) * cases);
+    assert(fairness_stamps != NULL);
+    select_t* list = malloc(sizeof(select_t) * cases);
+    assert(list != NULL);
+    double** samples = malloc(sizeof(double*) * cases);
+    assert(samples != NULL);
+    size_t* counts = calloc(cases, sizeof(size_t));
+    assert(counts != NULL);
+    for (size_t i = 0; i < cases; i++) {
+        fairness_channels[i] = channel_create(16);
+        assert(fairness_channels[i] != NULL);
+        fairness_stamps[i] = malloc(sizeof(struct timespec) * msgs);
+        assert(fairness_stamps[i] != NULL);
+        samples[i] = malloc(sizeof(double) * msgs);
+        assert(samples[i] != NULL);
+        list[i].channel = fairness_channels[i];
+        list[i].dir = RECV;
+        // SELECT_WEIGHTED gives later cases a bigger share: 1, 2, 3, ...
+        list[i].weight = (unsigned int)(i + 1);
+    }
+    select_options_t options;
+    select_options_init(&options);
+    options.policy = policy;
+    pthread_t* pid = malloc(sizeof(pthread_t) * cases);
+    assert(pid != NULL);
+
+    // start test, every sender keeps its channel full so all cases are ready all the time
+    for (size_t i = 0; i < cases; i++) {
+        int pthread_status = pthread_create(&pid[i], NULL, fairness_sender, (void*)i);
+        assert(pthread_status == 0);
+    }
+    for (size_t msg = 0; msg < msgs; msg++) {
+        size_t index;
+        status = channel_select_options(list, cases, &index, &options);
+        assert(status == SUCCESS);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        samples[index][counts[index]++] = elapsed_ns((const struct timespec*)list[index].data, &now);
+    }
+    // closing the channels stops the senders that are still going
+    for (size_t i = 0; i < cases; i++) {
+        status = channel_close(fairness_channels[i]);
+        assert(status == SUCCESS);
+    }
+    for (size_t i = 0; i < cases; i++) {
+        pthread_join(pid[i], NULL);
+    }
+
+    // report
+    for (size_t i = 0; i < cases; i++) {
+        latencies[i].share = (double)counts[i] / (double)msgs;
+        if (counts[i] == 0) {
+            latencies[i].p50_us = -1;
+            latencies[i].p99_us = -1;
+            latencies[i].max_us = -1;
+            continue;
+        }
+        qsort(samples[i], counts[i], sizeof(double), compare_double);
+        latencies[i].p50_us = samples[i][counts[i] / 2] / 1e3;
+        latencies[i].p99_us = samples[i][(counts[i] * 99) / 100] / 1e3;
+        latencies[i].max_us = samples[i][counts[i] - 1] / 1e3;
+    }
+
+    // cleanup
+    for (size_t i = 0; i < cases; i++) {
+        status = channel_destroy(fairness_channels[i]);
+        assert(status == SUCCESS);
+        free(fairness_stamps[i]);
+        free(samples[i]);
+    }
+    free(pid);
+    free(counts);
+    free(samples);
+    free(list);
+    free(fairness_stamps);
+    free(fairness_channels);
+}
+
+void run_timer_wheel(size_t timers, uint64_t tick_ns, uint64_t max_delay_ns, timer_wheel_result_t* result)
+{
+    enum channel_status status;
+    struct timespec start, end, now;
+    // setup
+    timer_service_t* service = timer_service_create(tick_ns);
+    assert(service != NULL);
+    channel_t* channel = channel_create(timers);
+    assert(channel != NULL);
+    channel_timer_t** list = malloc(timers * sizeof(channel_timer_t*));
+    struct timespec* expiries = malloc(timers * sizeof(struct timespec));
+    double* samples = malloc(timers * sizeof(double));
+    assert(list != NULL && expiries != NULL && samples != NULL);
+    unsigned int seed = 1;
+
+    // arm every timer with a delay between half of max_delay_ns and max_delay_ns
+    double arm_ns = 0;
+    for (size_t i = 0; i < timers; i++) {
+        uint64_t delay = max_delay_ns / 2 + (uint64_t)rand_r(&seed) % (max_delay_ns / 2);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        list[i] = timer_after(service, channel, delay, (void*)i);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        assert(list[i] != NULL);
+        arm_ns += elapsed_ns(&start, &end);
+        uint64_t ns = (uint64_t)start.tv_nsec + delay;
+        expiries[i].tv_sec = start.tv_sec + (time_t)(ns / 1000000000);
+        expiries[i].tv_nsec = (long)(ns % 1000000000);
+    }
+
+    // cancel every other timer while (nearly) the whole population is armed; on slow builds such as the
+    // sanitizer one the first timers may fire before arming is done, and those cannot be cancelled any more
+    double cancel_ns = 0;
+    size_t cancelled = 0;
+    bool* stopped = calloc(timers, sizeof(bool));
+    assert(stopped != NULL);
+    for (size_t i = 1; i < timers; i += 2) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        stopped[i] = timer_stop(list[i]);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        cancel_ns += elapsed_ns(&start, &end);
+        cancelled += stopped[i];
+    }
+
+    // collect the expirations of the others
+    size_t fired = timers - cancelled;
+    for (size_t i = 0; i < fired; i++) {
+        void* data = NULL;
+        status = channel_receive(channel, &data);
+        assert(status == SUCCESS);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        size_t index = (size_t)data;
+        assert(!stopped[index]);
+        samples[i] = elapsed_ns(&expiries[index], &now);
+    }
+    qsort(samples, fired, sizeof(double), compare_double);
+    result->arm_ns = arm_ns / (double)timers;
+    result->cancel_ns = cancel_ns / (double)(timers / 2);
+    result->early = samples[0] < 0;
+    result->p50_late_us = samples[fired / 2] / 1e3;
+    result->p99_late_us = samples[(fired * 99) / 100] / 1e3;
+    result->max_late_us = samples[fired - 1] / 1e3;
+
+    // cleanup
+    for (size_t i = 0; i < timers; i++) {
+        timer_free(list[i]);
+    }
+    timer_service_destroy(service);
+    status = channel_close(channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(channel);
+    assert(status == SUCCESS);
+    free(stopped);
+    free(samples);
+    free(expiries);
+    free(list);
+}
+
+static channel_t* payload_channel;
+static size_t payload_size;
+static size_t payload_msgs;
+static bool payload_inline;
+
+// Fills a message with its sequence number followed by a byte pattern, as a sender building a real payload would
+static void payload_fill(unsigned char* message, size_t seq)
+{
+    memset(message, (int)(seq & 0xff), payload_size);
+    memcpy(message, &seq, sizeof(seq));
+}
+
+static void* payload_sender(void* arg)
+{
+    (void)arg;
+    unsigned char message[256];
+    for (size_t i = 1; i <= payload_msgs; i++) {
+        enum channel_status status;
+        if (payload_inline) {
+            payload_fill(message, i);
+            status = channel_send(payload_channel, message);
+        } else {
+            // the message has to outlive the send, so every one gets its own allocation that the receiver frees
+            unsigned char* copy = malloc(payload_size);
+            assert(copy != NULL);
+            payload_fill(copy, i);
+            status = channel_send(payload_channel, copy);
+        }
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+double run_payload(enum channel_kind kind, size_t elem_size, size_t msgs, bool sized)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    assert(elem_size >= sizeof(size_t) && elem_size <= 256);
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.kind = kind;
+    options.elem_size = sized ? elem_size : 0;
+    payload_channel = channel_create_options(128, &options);
+    assert(payload_channel != NULL);
+    payload_size = elem_size;
+    payload_msgs = msgs;
+    payload_inline = sized;
+    unsigned char message[256];
+    size_t checksum = 0;
+    pthread_t pid;
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&pid, NULL, payload_sender, NULL);
+    assert(pthread_status == 0);
+    for (size_t i = 1; i <= msgs; i++) {
+        void* data = message;
+        status = channel_receive(payload_channel, &data);
+        assert(status == SUCCESS);
+        size_t seq;
+        memcpy(&seq, data, sizeof(seq));
+        assert(seq == i);
+        // touch the whole payload, like a consumer that actually uses it
+        for (size_t b = sizeof(seq); b < elem_size; b++) {
+            checksum += ((unsigned char*)data)[b];
+        }
+        if (!sized) {
+            free(data);
+        }
+    }
+    pthread_join(pid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert(checksum > 0);
+
+    // cleanup
+    status = channel_close(payload_channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(payload_channel);
+    assert(status == SUCCESS);
+
+    return (double)msgs / (elapsed_ns(&start, &end) / 1e9);
+}
+
+// Returns the cost of timing an empty region with two clock_gettime calls, in nanoseconds
+static double clock_overhead_ns(void)
+{
+    struct timespec start, end;
+    double spent = 0;
+    for (size_t i = 0; i < 10000; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        spent += elapsed_ns(&start, &end);
+    }
+    return spent / 10000;
+}
+
+static channel_t* pool_channel;
+static size_t pool_msg_size;
+static size_t pool_msgs_per_thread;
+static bool pool_pooled;
+static atomic_llong pool_alloc_ns;
+
+static void* pool_producer(void* arg)
+{
+    (void)arg;
+    struct timespec start, end;
+    double spent = 0;
+    for (size_t i = 1; i <= pool_msgs_per_thread; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t* message = pool_pooled ? channel_msg_alloc(pool_channel) : malloc(pool_msg_size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        spent += elapsed_ns(&start, &end);
+        assert(message != NULL);
+        memset(message, 0, pool_msg_size);
+        message[0] = i;
+        enum channel_status status = channel_send(pool_channel, message);
+        assert(status == SUCCESS);
+    }
+    atomic_fetch_add(&pool_alloc_ns, (long long)spent);
+    return NULL;
+}
+
+static void* pool_consumer(void* arg)
+{
+    (void)arg;
+    struct timespec start, end;
+    double spent = 0;
+    for (size_t i = 0; i < pool_msgs_per_thread; i++) {
+        void* data = NULL;
+        enum channel_status status = channel_receive(pool_channel, &data);
+        assert(status == SUCCESS);
+        assert(*(size_t*)data != 0);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (pool_pooled) {
+            channel_msg_release(pool_channel, data);
+        } else {
+            free(data);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        spent += elapsed_ns(&start, &end);
+    }
+    atomic_fetch_add(&pool_alloc_ns, (long long)spent);
+    return NULL;
+}
+
+double run_msg_pool(size_t pairs, size_t msg_size, size_t msgs, bool pooled, double* alloc_ns)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    assert(msg_size >= sizeof(size_t));
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.msg_size = pooled ? msg_size : 0;
+    pool_channel = channel_create_options(128, &options);
+    assert(pool_channel != NULL);
+    pool_msg_size = msg_size;
+    pool_msgs_per_thread = msgs / pairs;
+    pool_pooled = pooled;
+    atomic_store(&pool_alloc_ns, 0);
+    pthread_t* pid = malloc(2 * pairs * sizeof(pthread_t));
+    assert(pid != NULL);
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < pairs; i++) {
+        int pthread_status = pthread_create(&pid[2 * i], NULL, pool_consumer, NULL);
+        assert(pthread_status == 0);
+        pthread_status = pthread_create(&pid[2 * i + 1], NULL, pool_producer, NULL);
+        assert(pthread_status == 0);
+    }
+    for (size_t i = 0; i < 2 * pairs; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    status = channel_close(pool_channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(pool_channel);
+    assert(status == SUCCESS);
+    free(pid);
+
+    // every message was timed twice, once when allocated and once when freed
+    size_t total = pool_msgs_per_thread * pairs;
+    *alloc_ns = (double)atomic_load(&pool_alloc_ns) / (double)total - 2 * clock_overhead_ns();
+    return (double)total / (elapsed_ns(&start, &end) / 1e9);
+}
+
+static channel_t* crowd_channel;
+static channel_t* crowd_ping;
+static channel_t* crowd_pong;
+
+// Parks in a select on the crowded channel until it is closed
+static void* crowd_waiter(void* arg)
+{
+    (void)arg;
+    select_t list[1] = {{crowd_channel, RECV, NULL}};
+    size_t index;
+    enum channel_status status = channel_select(list, 1, &index);
+    assert(status == CLOSED_ERROR);
+    return NULL;
+}
+
+// Selects on the crowded channel and the ping channel, so every round trip registers on the crowded channel
+// behind all the parked waiters and deregisters from it again
+static void* crowd_echo(void* arg)
+{
+    size_t msgs = (size_t)arg;
+    select_t list[2] = {{crowd_channel, RECV, NULL}, {crowd_ping, RECV, NULL}};
+    for (size_t i = 0; i < msgs; i++) {
+        size_t index;
+        enum channel_status status = channel_select(list, 2, &index);
+        assert(status == SUCCESS && index == 1);
+        status = channel_send(crowd_pong, list[1].data);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+double run_select_crowd(size_t waiters, size_t msgs)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    // setup
+    crowd_channel = channel_create(1);
+    crowd_ping = channel_create(1);
+    crowd_pong = channel_create(1);
+    assert(crowd_channel != NULL && crowd_ping != NULL && crowd_pong != NULL);
+    pthread_t* pid = malloc((waiters + 1) * sizeof(pthread_t));
+    assert(pid != NULL);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    for (size_t i = 0; i < waiters; i++) {
+        int pthread_status = pthread_create(&pid[i], &attr, crowd_waiter, NULL);
+        assert(pthread_status == 0);
+    }
+    pthread_attr_destroy(&attr);
+    // wait until the whole crowd is parked
+    while (atomic_load(&crowd_channel->waiting[RECV]) < waiters) {
+        sched_yield();
+    }
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&pid[waiters], NULL, crowd_echo, (void*)msgs);
+    assert(pthread_status == 0);
+    for (size_t i = 1; i <= msgs; i++) {
+        void* data = NULL;
+        status = channel_send(crowd_ping, (void*)i);
+        assert(status == SUCCESS);
+        status = channel_receive(crowd_pong, &data);
+        assert(status == SUCCESS && (size_t)data == i);
+    }
+    pthread_join(pid[waiters], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    status = channel_close(crowd_channel);
+    assert(status == SUCCESS);
+    for (size_t i = 0; i < waiters; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    status = channel_destroy(crowd_channel);
+    assert(status == SUCCESS);
+    channel_close(crowd_ping);
+    channel_close(crowd_pong);
+    channel_destroy(crowd_ping);
+    channel_destroy(crowd_pong);
+    free(pid);
+
+    return elapsed_ns(&start, &end) / (double)msgs;
+}
+
+static channel_t** fanout_channels;
+static size_t fanout_msgs;
+
+// Receives the messages 1..fanout_msgs in order from its own channel, then the NULL stop message
+static void* fanout_channel_receiver(void* arg)
+{
+    channel_t* inbox = (channel_t*)arg;
+    for (size_t i = 1; i <= fanout_msgs; i++) {
+        void* data = NULL;
+        enum channel_status status = channel_receive(inbox, &data);
+        assert(status == SUCCESS && (size_t)data == i);
+    }
+    void* data = NULL;
+    enum channel_status status = channel_receive(inbox, &data);
+    assert(status == SUCCESS && data == NULL);
+    return NULL;
+}
+
+// Same as fanout_channel_receiver through a broadcast subscriber
+static void* fanout_subscriber(void* arg)
+{
+    broadcast_subscriber_t* subscriber = (broadcast_subscriber_t*)arg;
+    for (size_t i = 1; i <= fanout_msgs; i++) {
+        void* data = NULL;
+        enum channel_status status = broadcast_receive(subscriber, &data);
+        assert(status == SUCCESS && (size_t)data == i);
+    }
+    void* data = NULL;
+    enum channel_status status = broadcast_receive(subscriber, &data);
+    assert(status == SUCCESS && data == NULL);
+    return NULL;
+}
+
+double run_fanout(size_t receivers, size_t msgs, bool broadcast)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    // setup
+    fanout_msgs = msgs;
+    pthread_t* pid = malloc(receivers * sizeof(pthread_t));
+    assert(pid != NULL);
+    broadcast_t* bus = NULL;
+    broadcast_subscriber_t** subscribers = NULL;
+    if (broadcast) {
+        bus = broadcast_create(64, BROADCAST_BLOCK);
+        subscribers = malloc(receivers * sizeof(broadcast_subscriber_t*));
+        assert(bus != NULL && subscribers != NULL);
+        for (size_t i = 0; i < receivers; i++) {
+            subscribers[i] = broadcast_subscribe(bus);
+            assert(subscribers[i] != NULL);
+        }
+    } else {
+        fanout_channels = malloc(receivers * sizeof(channel_t*));
+        assert(fanout_channels != NULL);
+        for (size_t i = 0; i < receivers; i++) {
+            fanout_channels[i] = channel_create(64);
+            assert(fanout_channels[i] != NULL);
+        }
+    }
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < receivers; i++) {
+        int pthread_status = broadcast ? pthread_create(&pid[i], NULL, fanout_subscriber, subscribers[i])
+                                       : pthread_create(&pid[i], NULL, fanout_channel_receiver, fanout_channels[i]);
+        assert(pthread_status == 0);
+    }
+    // messages are numbered from 1 so NULL stays free as the stop message
+    for (size_t i = 1; i <= msgs + 1; i++) {
+        void* data = (i <= msgs) ? (void*)i : NULL;
+        if (broadcast) {
+            status = broadcast_publish(bus, data);
+            assert(status == SUCCESS);
+        } else {
+            for (size_t r = 0; r < receivers; r++) {
+                status = channel_send(fanout_channels[r], data);
+                assert(status == SUCCESS);
+            }
+        }
+    }
+    for (size_t i = 0; i < receivers; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    if (broadcast) {
+        status = broadcast_close(bus);
+        assert(status == SUCCESS);
+        status = broadcast_destroy(bus);
+        assert(status == SUCCESS);
+        free(subscribers);
+    } else {
+        for (size_t i = 0; i < receivers; i++) {
+            channel_close(fanout_channels[i]);
+            channel_destroy(fanout_channels[i]);
+        }
+        free(fanout_channels);
+    }
+    free(pid);
+
+    return elapsed_ns(&start, &end) / (double)msgs;
+}
+
+static channel_t* probe_channel;
+static channel_t* probe_ack;
+static struct timespec* probe_stamps;
+static double* probe_latencies;
+static size_t probe_count;
+
+// Keeps the channel full of bulk NULL messages at level 0 until it is closed
+static void* probe_bulk_sender(void* arg)
+{
+    (void)arg;
+    while (channel_send_priority(probe_channel, NULL, 0) == SUCCESS) {
+    }
+    return NULL;
+}
+
+// Works a little on every bulk message and records how long every probe spent in the channel, acknowledging
+// each one; closes the channel after the last probe
+static void* probe_receiver(void* arg)
+{
+    (void)arg;
+    volatile size_t work = 0;
+    size_t received = 0;
+    while (received < probe_count) {
+        void* data = NULL;
+        enum channel_status status = channel_receive(probe_channel, &data);
+        assert(status == SUCCESS);
+        if (data == NULL) {
+            for (size_t k = 0; k < 500; k++) {
+                work += k;
+            }
+            continue;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        size_t probe = (size_t)data - 1;
+        probe_latencies[probe] = elapsed_ns(&probe_stamps[probe], &now) / 1e3;
+        received++;
+        status = channel_send(probe_ack, NULL);
+        assert(status == SUCCESS);
+    }
+    channel_close(probe_channel);
+    return NULL;
+}
+
+void run_priority_probe(bool prioritized, size_t probes, double* p50_us, double* p99_us)
+{
+    enum channel_status status;
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.priorities = prioritized ? 2 : 0;
+    probe_channel = channel_create_options(128, &options);
+    probe_ack = channel_create(1);
+    probe_count = probes;
+    probe_stamps = malloc(probes * sizeof(struct timespec));
+    probe_latencies = malloc(probes * sizeof(double));
+    assert(probe_channel != NULL && probe_ack != NULL && probe_stamps != NULL && probe_latencies != NULL);
+    pthread_t pid[2];
+    int pthread_status = pthread_create(&pid[0], NULL, probe_bulk_sender, NULL);
+    assert(pthread_status == 0);
+    pthread_status = pthread_create(&pid[1], NULL, probe_receiver, NULL);
+    assert(pthread_status == 0);
+
+    // start test: one probe at a time at level 1, each sent once the previous one came through
+    for (size_t i = 0; i < probes; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &probe_stamps[i]);
+        status = channel_send_priority(probe_channel, (void*)(i + 1), 1);
+        assert(status == SUCCESS);
+        void* ack;
+        status = channel_receive(probe_ack, &ack);
+        assert(status == SUCCESS);
+    }
+    pthread_join(pid[0], NULL);
+    pthread_join(pid[1], NULL);
+
+    qsort(probe_latencies, probes, sizeof(double), compare_double);
+    *p50_us = probe_latencies[probes / 2];
+    *p99_us = probe_latencies[(probes * 99) / 100];
+
+    // cleanup
+    channel_destroy(probe_channel);
+    channel_close(probe_ack);
+    channel_destroy(probe_ack);
+    free(probe_stamps);
+    free(probe_latencies);
+}
+
+static channel_t* burst_channel;
+static channel_t* burst_ack;
+static size_t burst_count;
+static size_t burst_length;
+
+// Works a little on every message and acknowledges the end of every burst
+static void* burst_receiver(void* arg)
+{
+    (void)arg;
+    volatile size_t work = 0;
+    for (size_t b = 0; b < burst_count; b++) {
+        for (size_t i = 0; i < burst_length; i++) {
+            void* data;
+            enum channel_status status = channel_receive(burst_channel, &data);
+            assert(status == SUCCESS);
+            for (size_t k = 0; k < 200; k++) {
+                work += k;
+            }
+        }
+        enum channel_status status = channel_send(burst_ack, NULL);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+void run_burst(enum channel_growth growth, size_t bursts, size_t burst_size, burst_result_t* result)
+{
+    enum channel_status status;
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.growth = growth;
+    options.max_size = 65536;
+    burst_channel = channel_create_options(64, &options);
+    burst_ack = channel_create(1);
+    burst_count = bursts;
+    burst_length = burst_size;
+    double* latencies = malloc(bursts * burst_size * sizeof(double));
+    assert(burst_channel != NULL && burst_ack != NULL && latencies != NULL);
+    pthread_t pid;
+    int pthread_status = pthread_create(&pid, NULL, burst_receiver, NULL);
+    assert(pthread_status == 0);
+
+    // start test: every burst is sent as fast as possible, then the sender idles until the receiver caught up
+    result->peak_bytes = 0;
+    for (size_t b = 0; b < bursts; b++) {
+        for (size_t i = 0; i < burst_size; i++) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            status = channel_send(burst_channel, (void*)(i + 1));
+            assert(status == SUCCESS);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            latencies[b * burst_size + i] = elapsed_ns(&start, &end) / 1e3;
+        }
+        size_t bytes = channel_storage_bytes(burst_channel);
+        if (bytes > result->peak_bytes) {
+            result->peak_bytes = bytes;
+        }
+        void* ack;
+        status = channel_receive(burst_ack, &ack);
+        assert(status == SUCCESS);
+    }
+    pthread_join(pid, NULL);
+    result->idle_bytes = channel_storage_bytes(burst_channel);
+
+    size_t sends = bursts * burst_size;
+    qsort(latencies, sends, sizeof(double), compare_double);
+    result->p50_send_us = latencies[sends / 2];
+    result->p99_send_us = latencies[(sends * 99) / 100];
+
+    // cleanup
+    channel_close(burst_channel);
+    channel_destroy(burst_channel);
+    channel_close(burst_ack);
+    channel_destroy(burst_ack);
+    free(latencies);
+}
+
+typedef struct {
+    size_t seq;
+    char payload[56];
+} spill_message_t;
+
+static channel_t* spill_channel;
+static size_t spill_msgs;
+
+// Works a little on every message and checks they arrive in order
+static void* spill_receiver(void* arg)
+{
+    (void)arg;
+    volatile size_t work = 0;
+    spill_message_t message;
+    for (size_t i = 0; i < spill_msgs; i++) {
+        void* data = &message;
+        enum channel_status status = channel_receive(spill_channel, &data);
+        assert(status == SUCCESS && message.seq == i);
+        for (size_t k = 0; k < 200; k++) {
+            work += k;
+        }
+    }
+    return NULL;
+}
+
+void run_spill(enum channel_growth growth, size_t size, size_t msgs, spill_result_t* result)
+{
+    enum channel_status status;
+    struct timespec start, sent, received;
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.growth = growth;
+    options.elem_size = sizeof(spill_message_t);
+    spill_channel = channel_create_options(size, &options);
+    assert(spill_channel != NULL);
+    spill_msgs = msgs;
+    spill_message_t message;
+    memset(&message, 'x', sizeof(message));
+    pthread_t pid;
+
+    // start test: the whole burst is sent as fast as possible
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int pthread_status = pthread_create(&pid, NULL, spill_receiver, NULL);
+    assert(pthread_status == 0);
+    for (size_t i = 0; i < msgs; i++) {
+        message.seq = i;
+        status = channel_send(spill_channel, &message);
+        assert(status == SUCCESS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sent);
+    result->peak_bytes = channel_storage_bytes(spill_channel);
+    pthread_join(pid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &received);
+
+    result->send_rate = (double)msgs / (elapsed_ns(&start, &sent) / 1e9);
+    result->receive_rate = (double)msgs / (elapsed_ns(&start, &received) / 1e9);
+
+    // cleanup
+    channel_close(spill_channel);
+    channel_destroy(spill_channel);
+}
+
+double run_op_cost(enum channel_kind kind, size_t ops)
+{
+    enum channel_status status;
+    struct timespec start, end;
+    // setup
+    channel_t* channel = channel_create_kind(64, kind);
+    assert(channel != NULL);
+
+    // start test
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < ops; i++) {
+        status = channel_non_blocking_send(channel, (void*)i);
+        assert(status == SUCCESS);
+        void* data;
+        status = channel_non_blocking_receive(channel, &data);
+        assert(status == SUCCESS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // cleanup
+    channel_close(channel);
+    channel_destroy(channel);
+
+    return elapsed_ns(&start, &end) / (double)(2 * ops);
+}
+
+static channel_t* pipeline_channels[PIPELINE_STAGES];
+static channel_t* pipeline_ack;
+static size_t pipeline_msgs;
+
+// Receives every message from the channel in front of stage (passed as arg), works on it and hands it on to the
+// next stage, or acknowledges every burst_size messages at the last stage
+static void* pipeline_stage(void* arg)
+{
+    size_t stage = (size_t)arg;
+    size_t work_per_msg = (stage == PIPELINE_STAGES / 2) ? 5000 : 50;
+    volatile size_t work = 0;
+    for (size_t i = 0; i < pipeline_msgs; i++) {
+        void* data;
+        enum channel_status status = channel_receive(pipeline_channels[stage], &data);
+        assert(status == SUCCESS);
+        for (size_t k = 0; k < work_per_msg; k++) {
+            work += k;
+        }
+        if (stage + 1 < PIPELINE_STAGES) {
+            status = channel_send(pipeline_channels[stage + 1], data);
+        } else if ((size_t)data == 0) {
+            status = channel_send(pipeline_ack, NULL);
+        }
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+void run_pipeline(enum channel_kind kind, size_t bursts, size_t burst_size, pipeline_result_t* result)
+{
+    enum channel_status status;
+    // setup
+    channel_options_t options;
+    channel_options_init(&options);
+    options.kind = kind;
+    options.sojourn = true;
+    for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+        pipeline_channels[stage] = channel_create_options(64, &options);
+        assert(pipeline_channels[stage] != NULL);
+    }
+    pipeline_ack = channel_create(1);
+    histogram_t* merged = histogram_create();
+    assert(pipeline_ack != NULL && merged != NULL);
+    pipeline_msgs = bursts * burst_size;
+    pthread_t pids[PIPELINE_STAGES];
+    for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+        int pthread_status = pthread_create(&pids[stage], NULL, pipeline_stage, (void*)stage);
+        assert(pthread_status == 0);
+    }
+
+    // start test: the last message of every burst is 0, which the last stage acknowledges
+    for (size_t b = 0; b < bursts; b++) {
+        for (size_t i = 0; i < burst_size; i++) {
+            status = channel_send(pipeline_channels[0], (void*)(burst_size - 1 - i));
+            assert(status == SUCCESS);
+        }
+        void* ack;
+        status = channel_receive(pipeline_ack, &ack);
+        assert(status == SUCCESS);
+    }
+    for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+        pthread_join(pids[stage], NULL);
+    }
+
+    for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+        histogram_t* sojourn = channel_sojourn_histogram(pipeline_channels[stage]);
+        result->p50_us[stage] = (double)histogram_percentile(sojourn, 50) / 1e3;
+        result->p99_us[stage] = (double)histogram_percentile(sojourn, 99) / 1e3;
+        result->p999_us[stage] = (double)histogram_percentile(sojourn, 99.9) / 1e3;
+        histogram_merge(merged, sojourn);
+    }
+    result->merged_p50_us = (double)histogram_percentile(merged, 50) / 1e3;
+    result->merged_p99_us = (double)histogram_percentile(merged, 99) / 1e3;
+    result->merged_p999_us = (double)histogram_percentile(merged, 99.9) / 1e3;
+
+    // cleanup
+    for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+        channel_close(pipeline_channels[stage]);
+        channel_destroy(pipeline_channels[stage]);
+    }
+    channel_close(pipeline_ack);
+    channel_destroy(pipeline_ack);
+    histogram_destroy(merged);
+}
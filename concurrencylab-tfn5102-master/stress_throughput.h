@@ -0,0 +1,152 @@
+#ifndef STRESS_THROUGHPUT_H
+#define STRESS_THROUGHPUT_H
+
+#include <stdint.h>
+#include "channel.h"
+
+// Pushes msgs messages from the sender threads to the receiver threads over one channel of the given kind
+// Senders and receivers move up to batch messages per call, using the batch API when batch is above 1
+// Checks that every message is received exactly once and returns the throughput in messages per second
+double run_stress_throughput(enum channel_kind kind, size_t buffer_size, size_t senders, size_t receivers, size_t msgs, size_t batch);
+
+// Bounces one message between two threads over a pair of channels created with the given options for round_trips round trips
+// Every hop finds the other channel empty, so each one waits for the other thread
+// With timed, every hop uses channel_send_until/channel_receive_until with a deadline that is never hit
+// Returns the average round trip time in nanoseconds
+double run_ping_pong(const channel_options_t* options, size_t buffer_size, size_t round_trips, bool timed);
+
+// Streams msgs messages from a producer pinned to the first CPU to a consumer pinned to the last one through the
+// slots of a buffer_t, with the ring indices either packed on one cache line or padded onto separate lines
+// Stores the hardware cache misses per message of both threads in misses_per_msg, or -1 if they cannot be counted
+// Returns the throughput in messages per second
+double run_ring_layout(bool padded, size_t buffer_size, size_t msgs, double* misses_per_msg);
+
+// Sends msgs messages over a channel of size 1 with selectors threads each looping on a single-case channel_select
+// Stores the context switches of the whole process per message in switches_per_msg
+// Returns the throughput in messages per second
+double run_select_herd(size_t selectors, size_t msgs, double* switches_per_msg);
+
+// How the selector of run_select_scale waits on its channels
+enum select_scale_mode {
+    SCALE_SELECT, // channel_select
+    SCALE_SELECT_WITH, // channel_select_with and one select_waiter_t for all the calls
+    SCALE_SELECT_SET, // select_set_wait on a select_set_t registered once
+};
+
+// Sends msgs messages spread over channels channels of size 1 to one thread selecting on all of them,
+// waiting for an acknowledgement after each message
+// Returns the average round trip time per message in nanoseconds
+double run_select_scale(size_t channels, size_t msgs, enum select_scale_mode mode);
+
+// Service latency of one select case, from the sender calling channel_send until the select returned the message
+typedef struct {
+    // Fraction of all messages that came from this case
+    double share;
+    // Latency percentiles in microseconds, -1 if the case never got a message through
+    double p50_us;
+    double p99_us;
+    double max_us;
+} select_case_latency_t;
+
+// Receives msgs messages with channel_select_options and the given policy from cases channels of size 16 that are
+// kept full by one sender thread each; SELECT_WEIGHTED weighs the cases 1, 2, 3, ...
+// Stores the share and latency distribution of every case in latencies, which must hold cases entries
+void run_select_fairness(enum select_policy policy, size_t cases, size_t msgs, select_case_latency_t* latencies);
+
+// Cost of arming and cancelling timers, and how late their expirations arrive
+typedef struct {
+    // Average time of one timer_after and one timer_stop in nanoseconds
+    double arm_ns;
+    double cancel_ns;
+    // True if any expiration arrived before its delay had passed
+    bool early;
+    // Lateness percentiles in microseconds, from the expiry until the receiver got the message
+    double p50_late_us;
+    double p99_late_us;
+    double max_late_us;
+} timer_wheel_result_t;
+
+// Arms timers one-shot timers with random delays between max_delay_ns / 2 and max_delay_ns on a service with the
+// given tick, all delivering to one channel, then stops every other one and receives the rest
+// Stores the arm and cancel costs and the lateness of the expirations in result
+void run_timer_wheel(size_t timers, uint64_t tick_ns, uint64_t max_delay_ns, timer_wheel_result_t* result);
+
+// Streams msgs messages of elem_size bytes (between sizeof(size_t) and 256) from one sender to one receiver over
+// a channel of the given kind and size 128; the receiver reads every byte of every message
+// With sized, the channel is created with elem_size and copies the messages inline; otherwise the sender
+// allocates every message and passes the pointer, and the receiver frees it
+// Returns the throughput in messages per second
+double run_payload(enum channel_kind kind, size_t elem_size, size_t msgs, bool sized);
+
+// Runs pairs producer and consumer threads over one channel of size 128 that together move msgs messages of
+// msg_size bytes (at least sizeof(size_t)); producers allocate every message and consumers free it
+// With pooled, messages come from channel_msg_alloc and go back with channel_msg_release, otherwise from malloc/free
+// Stores the time spent allocating and freeing, in nanoseconds per message without the cost of timing, in alloc_ns
+// Returns the throughput in messages per second
+double run_msg_pool(size_t pairs, size_t msg_size, size_t msgs, bool pooled, double* alloc_ns);
+
+// Parks waiters threads in a select on one channel, then bounces msgs messages off a thread that selects on that
+// crowded channel and a ping channel, so each round trip registers and deregisters behind all the parked waiters
+// Returns the average round trip time in nanoseconds
+double run_select_crowd(size_t waiters, size_t msgs);
+
+// Delivers msgs messages from one publisher to each of receivers threads and waits until all of them got them all
+// With broadcast, every message is one broadcast_publish on a BROADCAST_BLOCK broadcast of capacity 64 that every
+// receiver subscribes to; otherwise the publisher sends every message on a channel of size 64 per receiver
+// Returns the time per message in nanoseconds
+double run_fanout(size_t receivers, size_t msgs, bool broadcast);
+
+// Sends probes probes one at a time at priority level 1 of a channel of size 128 that a bulk sender keeps full of
+// level 0 messages, while the receiver works a little on every bulk message
+// With prioritized, the channel has two priority levels; otherwise it is a plain FIFO channel
+// Stores the percentiles of the time a probe spends in the channel, in microseconds, in p50_us and p99_us
+void run_priority_probe(bool prioritized, size_t probes, double* p50_us, double* p99_us);
+
+typedef struct {
+    double p50_send_us;
+    double p99_send_us;
+    size_t peak_bytes; // channel storage right after a burst was sent
+    size_t idle_bytes; // channel storage once every burst was received
+} burst_result_t;
+
+// Sends bursts bursts of burst_size messages as fast as possible to a receiver that works a little on every message,
+// waiting for it to catch up between bursts, over a channel of size 64 with the given growth (max_size 65536)
+// Stores the percentiles of the time one channel_send takes and the channel storage in result
+void run_burst(enum channel_growth growth, size_t bursts, size_t burst_size, burst_result_t* result);
+
+typedef struct {
+    double send_rate; // messages per second until the sender sent the whole burst
+    double receive_rate; // messages per second until the receiver got the whole burst
+    size_t peak_bytes; // channel storage once the whole burst was sent
+} spill_result_t;
+
+// Sends a burst of msgs 64 byte messages as fast as possible over a sized channel of the given size and growth,
+// to a receiver that works a little on every message
+// Stores the sender and receiver throughput and the channel storage at the end of the burst in result
+void run_spill(enum channel_growth growth, size_t size, size_t msgs, spill_result_t* result);
+
+// Sends and receives ops messages one at a time from a single thread over a channel of the given kind and size 64,
+// so every operation runs uncontended
+// Returns the time per operation in nanoseconds
+double run_op_cost(enum channel_kind kind, size_t ops);
+
+#define PIPELINE_STAGES 3
+
+typedef struct {
+    // Percentiles of the time messages spent in the channel in front of every stage, in microseconds
+    double p50_us[PIPELINE_STAGES];
+    double p99_us[PIPELINE_STAGES];
+    double p999_us[PIPELINE_STAGES];
+    // The same over the histograms of all the channels merged
+    double merged_p50_us;
+    double merged_p99_us;
+    double merged_p999_us;
+} pipeline_result_t;
+
+// Sends bursts bursts of burst_size messages through a pipeline of PIPELINE_STAGES threads, each receiving from
+// its own sojourn channel of the given kind and size 64 and forwarding to the next one, and waits for the last
+// stage to get a whole burst before sending the next one; the middle stage works a lot longer on every message
+// Stores the sojourn percentiles of every channel and of all of them merged in result
+void run_pipeline(enum channel_kind kind, size_t bursts, size_t burst_size, pipeline_result_t* result);
+
+#endif // STRESS_THROUGHPUT_H
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <time.h>
 #include <sys/resource.h>
@@ -10,6 +11,9 @@
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "stress_throughput.h"
+#include "timer.h"
+#include "broadcast.h"
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -44,6 +48,14 @@ typedef struct {
     pthread_t pid;
 } cpu_args;
 
+typedef struct {
+    channel_t *channel;
+    void **items;
+    size_t count;
+    size_t done_count;
+    enum channel_status out;
+} batch_args;
+
 int tests_run = 0;
 int tests_passed = 0;
 
@@ -115,6 +127,24 @@ void* helper_non_blocking_send(send_args *myargs) {
     return NULL;
 }
 
+void* helper_send_batch(batch_args *myargs) {
+    myargs->out = channel_send_batch(myargs->channel, myargs->items, myargs->count, &myargs->done_count);
+    return NULL;
+}
+
+// Sends the numbers 1 to (size_t)myargs->data in order
+void* helper_spsc_sender(send_args *myargs) {
+    size_t count = (size_t)myargs->data;
+    myargs->out = SUCCESS;
+    for (size_t i = 1; i <= count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_send(myargs->channel, (void*)i);
+    }
+    if (myargs->done) {
+        sem_post(myargs->done);
+    }
+    return NULL;
+}
+
 void* helper_non_blocking_receive(receive_args* myargs) {
     myargs->out = channel_non_blocking_receive(myargs->channel, &myargs->data);
     if (myargs->done) {
@@ -742,6 +772,7 @@ char* test_response_time() {
     }
 
     double avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
+    printf("    avg response time for a receive-side wakeup: %.1f us\n", avg_response_time * 1e6);
     mu_assert("test_response_time: Avg response time for send/receive is higher than 0.0005", avg_response_time < 0.0005);
 
     for (size_t i = 0; i < capacity; i++) {
@@ -769,6 +800,7 @@ char* test_response_time() {
     }
 
     avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
+    printf("    avg response time for a send-side wakeup: %.1f us\n", avg_response_time * 1e6);
     mu_assert("test_response_time: Avg response time for send/receive is higher than 0.0005", avg_response_time < 0.0005);
 
     // Free memory
@@ -2020,6 +2052,2163 @@ char* test_select_mixed_buffered_unbuffered() {
     return NULL;
 }
 
+char* test_lock_free() {
+    print_test_details(__func__, "Testing the lock-free channel backend");
+
+    /* Non-blocking calls should see the ring fill up and drain in FIFO order */
+    size_t capacity = 3;
+    channel_t* channel = channel_create_kind(capacity, CHANNEL_LOCK_FREE);
+    mu_assert("test_lock_free: Could not create channel\n", channel != NULL);
+    mu_assert("test_lock_free: Wrong backend\n", channel->kind == CHANNEL_LOCK_FREE);
+
+    char* messages[] = {"Message1", "Message2", "Message3"};
+    void* data = NULL;
+    mu_assert("test_lock_free: Non-blocking receive on empty channel failed", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < capacity; i++) {
+            mu_assert("test_lock_free: Non-blocking send failed", channel_non_blocking_send(channel, messages[i]) == SUCCESS);
+        }
+        mu_assert("test_lock_free: Non-blocking send on full channel failed", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+        for (size_t i = 0; i < capacity; i++) {
+            mu_assert("test_lock_free: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+            mu_assert("test_lock_free: Received out of order", string_equal(data, messages[i]));
+        }
+    }
+
+    /* A blocked receive should be woken by a send, and a blocked send by a receive */
+    pthread_t pid;
+    receive_args data_rec;
+    init_object_for_receive_api(&data_rec, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &data_rec);
+    usleep(10000);
+    mu_assert("test_lock_free: Receive isn't blocked as expected", data_rec.out == GEN_ERROR);
+    mu_assert("test_lock_free: Send failed", channel_send(channel, "Message") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_lock_free: Receive failed", data_rec.out == SUCCESS);
+    mu_assert("test_lock_free: Received wrong message", string_equal(data_rec.data, "Message"));
+
+    for (size_t i = 0; i < capacity; i++) {
+        channel_send(channel, messages[i]);
+    }
+    send_args data_send;
+    init_object_for_send_api(&data_send, channel, "Message4", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &data_send);
+    usleep(10000);
+    mu_assert("test_lock_free: Send isn't blocked as expected", data_send.out == GEN_ERROR);
+    mu_assert("test_lock_free: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_lock_free: Send failed", data_send.out == SUCCESS);
+    for (size_t i = 1; i < capacity; i++) {
+        mu_assert("test_lock_free: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_lock_free: Received out of order", string_equal(data, messages[i]));
+    }
+    mu_assert("test_lock_free: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_lock_free: Received wrong message", string_equal(data, "Message4"));
+
+    /* Select should wake up on a lock-free channel and close should release it */
+    select_t list[2];
+    channel_t* other = channel_create(1);
+    list[0].channel = other;
+    list[0].dir = RECV;
+    list[1].channel = channel;
+    list[1].dir = RECV;
+    select_args args;
+    init_object_for_select_api(&args, list, 2, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_lock_free: Select isn't blocked as expected", args.out == GEN_ERROR);
+    mu_assert("test_lock_free: Non-blocking send failed", channel_non_blocking_send(channel, "Message5") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_lock_free: Select failed", args.out == SUCCESS);
+    mu_assert("test_lock_free: Select returned wrong index", args.index == 1);
+    mu_assert("test_lock_free: Select received wrong message", string_equal(list[1].data, "Message5"));
+
+    init_object_for_select_api(&args, list, 2, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_lock_free: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_lock_free: Select didn't see close", args.out == CLOSED_ERROR);
+    mu_assert("test_lock_free: Select returned wrong index", args.index == 1);
+    mu_assert("test_lock_free: Send after close failed", channel_send(channel, "Message") == CLOSED_ERROR);
+    mu_assert("test_lock_free: Receive after close failed", channel_non_blocking_receive(channel, &data) == CLOSED_ERROR);
+
+    channel_close(other);
+    channel_destroy(other);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_throughput_lock_free() {
+    print_test_details(__func__, "Comparing locked and lock-free channel throughput with 1 to 64 senders/receivers");
+
+    size_t capacity = 64;
+    size_t msgs = 200000;
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        double locked = run_stress_throughput(CHANNEL_LOCKED, capacity, threads, threads, msgs, 1);
+        double lock_free = run_stress_throughput(CHANNEL_LOCK_FREE, capacity, threads, threads, msgs, 1);
+        printf("    %2zu senders/receivers: locked %10.0f msgs/s, lock-free %10.0f msgs/s (%.2fx)\n", threads, locked, lock_free, lock_free / locked);
+    }
+    return NULL;
+}
+
+char* test_spsc() {
+    print_test_details(__func__, "Testing the single-producer/single-consumer channel backend");
+
+    size_t capacity = 4;
+    channel_t* channel = channel_create_kind(capacity, CHANNEL_SPSC);
+    mu_assert("test_spsc: Could not create channel\n", channel != NULL);
+    mu_assert("test_spsc: Wrong backend\n", channel->kind == CHANNEL_SPSC);
+
+    /* Wrap the ring a few times with non-blocking calls */
+    void* data = NULL;
+    size_t next_send = 1;
+    size_t next_receive = 1;
+    for (size_t round = 0; round < 5; round++) {
+        while (channel_non_blocking_send(channel, (void*)next_send) == SUCCESS) {
+            next_send++;
+        }
+        mu_assert("test_spsc: Ring did not fill up at capacity", next_send - next_receive == capacity);
+        for (size_t i = 0; i < capacity - 1; i++) {
+            mu_assert("test_spsc: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+            mu_assert("test_spsc: Received out of order", (size_t)data == next_receive);
+            next_receive++;
+        }
+    }
+    mu_assert("test_spsc: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+    mu_assert("test_spsc: Non-blocking receive on empty channel failed", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    /* One sender thread and one receiver thread with blocking calls on both ends */
+    size_t MESSAGES = 100000;
+    pthread_t pid;
+    send_args data_send;
+    init_object_for_send_api(&data_send, channel, NULL, NULL);
+    data_send.data = (void*)MESSAGES;
+    pthread_create(&pid, NULL, (void *)helper_spsc_sender, &data_send);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_spsc: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spsc: Received out of order", (size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_spsc: Send failed", data_send.out == SUCCESS);
+
+    /* Close releases a blocked receiver */
+    receive_args data_rec;
+    init_object_for_receive_api(&data_rec, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &data_rec);
+    usleep(10000);
+    mu_assert("test_spsc: Receive isn't blocked as expected", data_rec.out == GEN_ERROR);
+    mu_assert("test_spsc: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_spsc: Receive didn't see close", data_rec.out == CLOSED_ERROR);
+
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_stress_send_recv_spsc() {
+    print_test_details(__func__, "Comparing ring hop throughput of run_stress_send_recv with locked and SPSC ring links");
+
+    size_t buffer_sizes[] = {1, 64};
+    size_t threads[] = {2, 4, 16};
+    for (size_t i = 0; i < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); i++) {
+        for (size_t j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+            double locked = run_stress_send_recv_kind(CHANNEL_LOCKED, buffer_sizes[i], threads[j], 0.75, 500000);
+            double spsc = run_stress_send_recv_kind(CHANNEL_SPSC, buffer_sizes[i], threads[j], 0.75, 500000);
+            printf("    buffer %2zu, %2zu threads: locked %10.0f hops/s, spsc %10.0f hops/s (%.2fx)\n", buffer_sizes[i], threads[j], locked, spsc, spsc / locked);
+        }
+    }
+    return NULL;
+}
+
+char* test_batch() {
+    print_test_details(__func__, "Testing batch send and receive");
+
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        size_t capacity = 5;
+        channel_t* channel = channel_create_kind(capacity, kinds[k]);
+        void* items[8];
+        void* out[8];
+        size_t count = 0;
+        for (size_t i = 0; i < 8; i++) {
+            items[i] = (void*)(i + 1);
+        }
+
+        /* An empty batch is rejected by every batch call */
+        mu_assert("test_batch: Empty send batch should fail", channel_send_batch(channel, items, 0, &count) == GEN_ERROR);
+        mu_assert("test_batch: Empty receive batch should fail", channel_receive_batch(channel, out, 0, &count) == GEN_ERROR);
+        mu_assert("test_batch: Empty non-blocking send batch should fail", channel_non_blocking_send_batch(channel, items, 0, &count) == GEN_ERROR);
+        mu_assert("test_batch: Empty non-blocking receive batch should fail", channel_non_blocking_receive_batch(channel, out, 0, &count) == GEN_ERROR);
+
+        /* Non-blocking batches move what fits and keep FIFO order across the ring wraparound */
+        mu_assert("test_batch: Non-blocking receive batch on empty channel failed", channel_non_blocking_receive_batch(channel, out, 8, &count) == CHANNEL_EMPTY);
+        mu_assert("test_batch: Nothing should be received", count == 0);
+        size_t next_receive = 1;
+        for (size_t round = 0; round < 4; round++) {
+            mu_assert("test_batch: Non-blocking send batch failed", channel_non_blocking_send_batch(channel, items, 3, &count) == SUCCESS);
+            mu_assert("test_batch: Non-blocking send batch sent wrong count", count == 3);
+            mu_assert("test_batch: Non-blocking receive batch failed", channel_non_blocking_receive_batch(channel, out, 2, &count) == SUCCESS);
+            mu_assert("test_batch: Non-blocking receive batch received wrong count", count == 2);
+            for (size_t i = 0; i < count; i++) {
+                mu_assert("test_batch: Received out of order", (size_t)out[i] == next_receive);
+                next_receive = next_receive % 3 + 1;
+            }
+            // drain the leftover so every round starts from an empty channel at a different ring offset
+            mu_assert("test_batch: Non-blocking receive batch failed", channel_non_blocking_receive_batch(channel, out, 8, &count) == SUCCESS);
+            mu_assert("test_batch: Non-blocking receive batch received wrong count", count == 1);
+            mu_assert("test_batch: Received out of order", (size_t)out[0] == next_receive);
+            next_receive = next_receive % 3 + 1;
+        }
+        mu_assert("test_batch: Non-blocking send batch failed", channel_non_blocking_send_batch(channel, items, 8, &count) == SUCCESS);
+        mu_assert("test_batch: Non-blocking send batch should stop at capacity", count == capacity);
+        mu_assert("test_batch: Non-blocking send batch on full channel failed", channel_non_blocking_send_batch(channel, items, 8, &count) == CHANNEL_FULL);
+        mu_assert("test_batch: Nothing should be sent", count == 0);
+        mu_assert("test_batch: Receive batch failed", channel_receive_batch(channel, out, 8, &count) == SUCCESS);
+        mu_assert("test_batch: Receive batch received wrong count", count == capacity);
+        for (size_t i = 0; i < count; i++) {
+            mu_assert("test_batch: Received out of order", out[i] == items[i]);
+        }
+
+        /* A blocking batch larger than the channel completes as a receiver drains it */
+        size_t MESSAGES = 1000;
+        void* send_items[MESSAGES];
+        for (size_t i = 0; i < MESSAGES; i++) {
+            send_items[i] = (void*)(i + 1);
+        }
+        pthread_t pid;
+        batch_args args;
+        args.channel = channel;
+        args.items = send_items;
+        args.count = MESSAGES;
+        pthread_create(&pid, NULL, (void *)helper_send_batch, &args);
+        size_t next = 1;
+        while (next <= MESSAGES) {
+            mu_assert("test_batch: Receive batch failed", channel_receive_batch(channel, out, 8, &count) == SUCCESS);
+            mu_assert("test_batch: Receive batch received nothing", count > 0);
+            for (size_t i = 0; i < count; i++) {
+                mu_assert("test_batch: Received out of order", (size_t)out[i] == next);
+                next++;
+            }
+        }
+        pthread_join(pid, NULL);
+        mu_assert("test_batch: Send batch failed", args.out == SUCCESS);
+        mu_assert("test_batch: Send batch sent wrong count", args.done_count == MESSAGES);
+
+        /* Close stops a blocked batch send and reports how much got through */
+        args.count = capacity + 2;
+        pthread_create(&pid, NULL, (void *)helper_send_batch, &args);
+        usleep(10000);
+        mu_assert("test_batch: Close failed", channel_close(channel) == SUCCESS);
+        pthread_join(pid, NULL);
+        mu_assert("test_batch: Send batch didn't see close", args.out == CLOSED_ERROR);
+        mu_assert("test_batch: Send batch sent wrong count before close", args.done_count == capacity);
+        mu_assert("test_batch: Receive batch after close failed", channel_receive_batch(channel, out, 8, &count) == CLOSED_ERROR);
+
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_throughput_batch() {
+    print_test_details(__func__, "Comparing single and batch send/receive throughput");
+
+    size_t capacity = 64;
+    size_t msgs = 400000;
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    const char* names[] = {"locked", "lock-free", "spsc"};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        size_t threads = (kinds[k] == CHANNEL_SPSC) ? 1 : 4;
+        double single = run_stress_throughput(kinds[k], capacity, threads, threads, msgs, 1);
+        double batch = run_stress_throughput(kinds[k], capacity, threads, threads, msgs, 16);
+        printf("    %-9s %zu senders/receivers: single %10.0f msgs/s, batch of 16 %10.0f msgs/s (%.2fx)\n", names[k], threads, single, batch, batch / single);
+    }
+    return NULL;
+}
+
+char* test_ping_pong() {
+    print_test_details(__func__, "Measuring ping-pong round trip latency between two threads");
+
+    size_t round_trips = 100000;
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    const char* kind_names[] = {"locked", "lock-free", "spsc"};
+    enum channel_wait_policy policies[] = {CHANNEL_WAIT_PARK, CHANNEL_WAIT_SPIN, CHANNEL_WAIT_ADAPTIVE};
+    const char* policy_names[] = {"park", "spin", "adaptive"};
+    channel_options_t options;
+    channel_options_init(&options);
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        options.kind = kinds[k];
+        printf("    %-10s buffer 1:", kind_names[k]);
+        for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+            options.wait_policy = policies[p];
+            double latency = run_ping_pong(&options, 1, round_trips, false);
+            printf(" %s %6.0f ns", policy_names[p], latency);
+        }
+        printf(" per round trip\n");
+    }
+    channel_options_init(&options);
+    double latency = run_ping_pong(&options, 0, round_trips, false);
+    printf("    %-10s         : park %6.0f ns per round trip\n", "unbuffered", latency);
+    return NULL;
+}
+
+char* test_wait_policy() {
+    print_test_details(__func__, "Testing the spinning wait policies (takes around 5 seconds)");
+
+    enum channel_wait_policy policies[] = {CHANNEL_WAIT_SPIN, CHANNEL_WAIT_ADAPTIVE};
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        channel_options_t options;
+        channel_options_init(&options);
+        options.kind = CHANNEL_LOCK_FREE;
+        options.wait_policy = policies[p];
+        channel_t* channel = channel_create_options(2, &options);
+        mu_assert("test_wait_policy: Could not create channel\n", channel != NULL);
+        mu_assert("test_wait_policy: Wrong wait policy\n", channel->wait_policy == policies[p]);
+
+        /* Spinning senders and receivers still see every message in order */
+        size_t MESSAGES = 100000;
+        pthread_t pid;
+        send_args data_send;
+        init_object_for_send_api(&data_send, channel, NULL, NULL);
+        data_send.data = (void*)MESSAGES;
+        pthread_create(&pid, NULL, (void *)helper_spsc_sender, &data_send);
+        void* data = NULL;
+        for (size_t i = 1; i <= MESSAGES; i++) {
+            mu_assert("test_wait_policy: Receive failed", channel_receive(channel, &data) == SUCCESS);
+            mu_assert("test_wait_policy: Received out of order", (size_t)data == i);
+        }
+        pthread_join(pid, NULL);
+        mu_assert("test_wait_policy: Send failed", data_send.out == SUCCESS);
+
+        /* Receivers on an idle channel give up spinning and sleep */
+        size_t THREADS = 10;
+        pthread_t pids[THREADS];
+        receive_args args[THREADS];
+        for (size_t i = 0; i < THREADS; i++) {
+            init_object_for_receive_api(&args[i], channel, NULL);
+            pthread_create(&pids[i], NULL, (void *)helper_receive, &args[i]);
+        }
+        sleep(1);
+        struct rusage usage1;
+        getrusage(RUSAGE_SELF, &usage1);
+        sleep(1);
+        struct rusage usage2;
+        getrusage(RUSAGE_SELF, &usage2);
+        long double result = (usage2.ru_utime.tv_sec - usage1.ru_utime.tv_sec)*1000000L + usage2.ru_utime.tv_usec - usage1.ru_utime.tv_usec + (usage2.ru_stime.tv_sec - usage1.ru_stime.tv_sec)*1000000L + usage2.ru_stime.tv_usec - usage1.ru_stime.tv_usec;
+        mu_assert("test_wait_policy: CPU Utilization of idle receivers is higher than required", result < 50000);
+
+        mu_assert("test_wait_policy: Close failed", channel_close(channel) == SUCCESS);
+        for (size_t i = 0; i < THREADS; i++) {
+            pthread_join(pids[i], NULL);
+            mu_assert("test_wait_policy: Receive didn't see close", args[i].out == CLOSED_ERROR);
+        }
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_buffer_layout() {
+    print_test_details(__func__, "Comparing packed and cache line padded ring indices across CPUs");
+
+    size_t capacity = 256;
+    size_t msgs = 2000000;
+    bool layouts[] = {false, true};
+    const char* names[] = {"packed", "padded"};
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        double misses;
+        double throughput = run_ring_layout(layouts[l], capacity, msgs, &misses);
+        if (misses < 0) {
+            printf("    %s indices: %10.0f msgs/s, cache misses not available\n", names[l], throughput);
+        } else {
+            printf("    %s indices: %10.0f msgs/s, %.3f cache misses/msg\n", names[l], throughput, misses);
+        }
+    }
+    return NULL;
+}
+
+char* test_select_herd() {
+    print_test_details(__func__, "Measuring context switches with many selectors parked on one channel");
+
+    size_t selectors[] = {1, 10, 100};
+    size_t msgs = 20000;
+    for (size_t i = 0; i < sizeof(selectors) / sizeof(selectors[0]); i++) {
+        double switches;
+        double throughput = run_select_herd(selectors[i], msgs, &switches);
+        printf("    %3zu selectors: %10.0f msgs/s, %7.2f context switches/msg\n", selectors[i], throughput, switches);
+    }
+    return NULL;
+}
+
+char* test_select_scale() {
+    print_test_details(__func__, "Measuring the cost of select as the number of channels grows");
+
+    size_t channels[] = {1, 10, 100, 1000};
+    size_t msgs = 20000;
+    for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+        double latency = run_select_scale(channels[i], msgs, SCALE_SELECT);
+        double persistent_latency = run_select_scale(channels[i], msgs, SCALE_SELECT_SET);
+        printf("    %4zu channels: %8.0f ns per message with channel_select, %8.0f ns with select_set_wait\n", channels[i], latency, persistent_latency);
+    }
+    return NULL;
+}
+
+char* test_select_set() {
+    print_test_details(__func__, "Testing persistent select sets");
+
+    size_t CHANNELS = 3;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    select_set_t* set = select_set_create(CHANNELS + 1);
+    mu_assert("test_select_set: Could not create select set", set != NULL);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        list[i].channel = channel[i];
+        list[i].dir = RECV;
+        list[i].data = NULL;
+        size_t index;
+        mu_assert("test_select_set: Could not add case", select_set_add(set, &list[i], &index) == SUCCESS);
+        mu_assert("test_select_set: Cases should get the lowest free index", index == i);
+    }
+
+    // Ready cases are picked lowest index first
+    size_t index;
+    channel_send(channel[2], "Message2");
+    channel_send(channel[1], "Message1");
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    mu_assert("test_select_set: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    mu_assert("test_select_set: Wrong case selected", index == 2 && string_equal(list[2].data, "Message2"));
+
+    // Disabled cases are skipped until enabled again
+    mu_assert("test_select_set: Could not disable case", select_set_disable(set, 0) == SUCCESS);
+    channel_send(channel[0], "Message0");
+    channel_send(channel[2], "Message2");
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    mu_assert("test_select_set: Disabled case was selected", index == 2);
+    mu_assert("test_select_set: Could not enable case", select_set_enable(set, 0) == SUCCESS);
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    mu_assert("test_select_set: Enabled case was not selected", index == 0 && string_equal(list[0].data, "Message0"));
+
+    // Removed indices are reused
+    mu_assert("test_select_set: Could not remove case", select_set_remove(set, 1) == SUCCESS);
+    mu_assert("test_select_set: Removed case twice", select_set_remove(set, 1) == GEN_ERROR);
+    mu_assert("test_select_set: Could not add case", select_set_add(set, &list[1], &index) == SUCCESS);
+    mu_assert("test_select_set: Removed index was not reused", index == 1);
+
+    // Blocks until a sender shows up, also on unbuffered channels
+    channel_t* unbuffered = channel_create(0);
+    select_t unbuffered_case = {unbuffered, RECV, NULL};
+    size_t unbuffered_index;
+    mu_assert("test_select_set: Could not add case", select_set_add(set, &unbuffered_case, &unbuffered_index) == SUCCESS);
+    mu_assert("test_select_set: Set should be full", select_set_add(set, &unbuffered_case, &index) == GEN_ERROR);
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, unbuffered, "Unbuffered", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_set: Wrong case selected", index == unbuffered_index && string_equal(unbuffered_case.data, "Unbuffered"));
+    mu_assert("test_select_set: Send failed", args.out == SUCCESS);
+    init_object_for_send_api(&args, channel[1], "Message1", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &index) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_set: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+
+    // Closed channels are reported, and a set without enabled cases cannot wait
+    channel_close(channel[2]);
+    mu_assert("test_select_set: Closed channel not reported", select_set_wait(set, &index) == CLOSED_ERROR && index == 2);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        mu_assert("test_select_set: Could not disable case", select_set_disable(set, i) == SUCCESS);
+    }
+    mu_assert("test_select_set: Could not disable case", select_set_disable(set, unbuffered_index) == SUCCESS);
+    mu_assert("test_select_set: Wait without cases should fail", select_set_wait(set, &index) == GEN_ERROR);
+
+    select_set_destroy(set);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        if (i != 2) {
+            channel_close(channel[i]);
+        }
+        channel_destroy(channel[i]);
+    }
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+// Returns the CLOCK_MONOTONIC time milliseconds from now
+static struct timespec deadline_after(long milliseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+// Returns true if the CLOCK_MONOTONIC time deadline has passed
+static bool deadline_passed(const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+char* test_deadline() {
+    print_test_details(__func__, "Testing deadline-bounded send, receive and select");
+
+    channel_t* buffered = channel_create(1);
+    channel_t* unbuffered = channel_create(0);
+    void* data = NULL;
+    size_t index = 2;
+
+    // Waits time out, and not before the deadline
+    struct timespec deadline = deadline_after(20);
+    mu_assert("test_deadline: Receive should time out", channel_receive_until(buffered, &data, &deadline) == TIMEOUT);
+    mu_assert("test_deadline: Receive returned before the deadline", deadline_passed(&deadline));
+    deadline = deadline_after(20);
+    mu_assert("test_deadline: Receive should time out", channel_receive_until(unbuffered, &data, &deadline) == TIMEOUT);
+    mu_assert("test_deadline: Receive returned before the deadline", deadline_passed(&deadline));
+    deadline = deadline_after(20);
+    mu_assert("test_deadline: Send should time out", channel_send_until(unbuffered, "Message", &deadline) == TIMEOUT);
+    mu_assert("test_deadline: Send returned before the deadline", deadline_passed(&deadline));
+    mu_assert("test_deadline: Send failed", channel_send(buffered, "Message") == SUCCESS);
+    deadline = deadline_after(20);
+    mu_assert("test_deadline: Send should time out", channel_send_until(buffered, "Message", &deadline) == TIMEOUT);
+    mu_assert("test_deadline: Send returned before the deadline", deadline_passed(&deadline));
+    mu_assert("test_deadline: Receive failed", channel_receive(buffered, &data) == SUCCESS);
+    select_t list[2] = {{buffered, RECV, NULL}, {unbuffered, RECV, NULL}};
+    deadline = deadline_after(20);
+    mu_assert("test_deadline: Select should time out", channel_select_until(list, 2, &index, &deadline) == TIMEOUT);
+    mu_assert("test_deadline: Select returned before the deadline", deadline_passed(&deadline));
+    mu_assert("test_deadline: Select should leave the index alone on timeout", index == 2);
+
+    // A timed out waiter is gone, so a later peer is not completed against it
+    mu_assert("test_deadline: Non-blocking send should fail", channel_non_blocking_send(unbuffered, "Message") == CHANNEL_FULL);
+
+    // Deadlines in the past still take what is ready
+    deadline = deadline_after(0);
+    mu_assert("test_deadline: Send failed", channel_send_until(buffered, "Message1", &deadline) == SUCCESS);
+    mu_assert("test_deadline: Receive failed", channel_receive_until(buffered, &data, &deadline) == SUCCESS);
+    mu_assert("test_deadline: Wrong value received", string_equal(data, "Message1"));
+
+    // Waits that are satisfied in time succeed
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, unbuffered, "Unbuffered", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    deadline = deadline_after(10000);
+    mu_assert("test_deadline: Receive failed", channel_receive_until(unbuffered, &data, &deadline) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_deadline: Wrong value received", string_equal(data, "Unbuffered") && args.out == SUCCESS);
+    init_object_for_send_api(&args, buffered, "Buffered", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    mu_assert("test_deadline: Select failed", channel_select_until(list, 2, &index, &deadline) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_deadline: Wrong case selected", index == 0 && string_equal(list[0].data, "Buffered"));
+
+    // Invalid deadlines and closed channels
+    mu_assert("test_deadline: Missing deadline accepted", channel_send_until(buffered, "Message", NULL) == GEN_ERROR);
+    deadline.tv_nsec = 1000000000;
+    mu_assert("test_deadline: Invalid deadline accepted", channel_receive_until(buffered, &data, &deadline) == GEN_ERROR);
+    channel_close(buffered);
+    deadline = deadline_after(10000);
+    mu_assert("test_deadline: Closed channel not reported", channel_receive_until(buffered, &data, &deadline) == CLOSED_ERROR);
+
+    channel_destroy(buffered);
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+char* test_deadline_overhead() {
+    print_test_details(__func__, "Measuring the cost of deadlines that are not hit");
+
+    size_t round_trips = 100000;
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    const char* kind_names[] = {"locked", "lock-free", "spsc"};
+    channel_options_t options;
+    channel_options_init(&options);
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        options.kind = kinds[k];
+        double untimed = run_ping_pong(&options, 1, round_trips, false);
+        double timed = run_ping_pong(&options, 1, round_trips, true);
+        printf("    %-10s buffer 1: untimed %6.0f ns, timed %6.0f ns per round trip\n", kind_names[k], untimed, timed);
+    }
+    channel_options_init(&options);
+    double untimed = run_ping_pong(&options, 0, round_trips, false);
+    double timed = run_ping_pong(&options, 0, round_trips, true);
+    printf("    %-10s         : untimed %6.0f ns, timed %6.0f ns per round trip\n", "unbuffered", untimed, timed);
+    return NULL;
+}
+
+char* test_try_select() {
+    print_test_details(__func__, "Testing non-blocking select");
+
+    size_t CHANNELS = 3;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        list[i].channel = channel[i];
+        list[i].dir = RECV;
+        list[i].data = NULL;
+    }
+    size_t index = CHANNELS;
+
+    // Nothing is ready
+    mu_assert("test_try_select: Should not find a ready case", channel_try_select(list, CHANNELS, &index) == CHANNEL_EMPTY);
+    mu_assert("test_try_select: Index changed without a ready case", index == CHANNELS);
+
+    // The first ready case is taken
+    channel_send(channel[2], "Message2");
+    channel_send(channel[1], "Message1");
+    mu_assert("test_try_select: Should find a ready case", channel_try_select(list, CHANNELS, &index) == SUCCESS);
+    mu_assert("test_try_select: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+    mu_assert("test_try_select: Should find a ready case", channel_try_select(list, CHANNELS, &index) == SUCCESS);
+    mu_assert("test_try_select: Wrong case selected", index == 2 && string_equal(list[2].data, "Message2"));
+    mu_assert("test_try_select: Should not find a ready case", channel_try_select(list, CHANNELS, &index) == CHANNEL_EMPTY);
+
+    // Send cases are ready while their channel has room
+    list[0].dir = SEND;
+    list[0].data = "Message0";
+    mu_assert("test_try_select: Should find a ready case", channel_try_select(list, CHANNELS, &index) == SUCCESS);
+    mu_assert("test_try_select: Wrong case selected", index == 0);
+    mu_assert("test_try_select: Should not find a ready case", channel_try_select(list, 1, &index) == CHANNEL_EMPTY);
+    void* data;
+    mu_assert("test_try_select: Value was not sent", channel_receive(channel[0], &data) == SUCCESS && string_equal(data, "Message0"));
+
+    // Unbuffered cases are ready when a peer is waiting
+    channel_t* unbuffered = channel_create(0);
+    select_t unbuffered_case = {unbuffered, RECV, NULL};
+    mu_assert("test_try_select: Should not find a ready case", channel_try_select(&unbuffered_case, 1, &index) == CHANNEL_EMPTY);
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, unbuffered, "Unbuffered", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    while (channel_try_select(&unbuffered_case, 1, &index) == CHANNEL_EMPTY) {
+        usleep(1000);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_try_select: Wrong value received", index == 0 && string_equal(unbuffered_case.data, "Unbuffered"));
+    mu_assert("test_try_select: Send failed", args.out == SUCCESS);
+
+    // Closed channels are reported
+    channel_close(channel[1]);
+    mu_assert("test_try_select: Closed channel not reported", channel_try_select(list + 1, CHANNELS - 1, &index) == CLOSED_ERROR && index == 0);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        if (i != 1) {
+            channel_close(channel[i]);
+        }
+        channel_destroy(channel[i]);
+    }
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+char* test_select_policy() {
+    print_test_details(__func__, "Testing the case order of the select policies");
+
+    size_t CHANNELS = 3;
+    size_t ROUNDS = 30;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(ROUNDS * 6);
+        list[i].channel = channel[i];
+        list[i].dir = RECV;
+        for (size_t j = 0; j < ROUNDS * 6; j++) {
+            channel_send(channel[i], "Message");
+        }
+    }
+    size_t index;
+    select_options_t options;
+
+    // Every case is ready, so SELECT_FIRST keeps picking the first one
+    select_options_init(&options);
+    for (size_t i = 0; i < ROUNDS; i++) {
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        mu_assert("test_select_policy: SELECT_FIRST did not pick the first case", index == 0);
+    }
+
+    // SELECT_ROUND_ROBIN takes turns
+    options.policy = SELECT_ROUND_ROBIN;
+    options.cursor = 0;
+    for (size_t i = 0; i < ROUNDS; i++) {
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        mu_assert("test_select_policy: SELECT_ROUND_ROBIN did not take turns", index == i % CHANNELS);
+    }
+
+    // SELECT_WEIGHTED never picks a case without weight while a weighted one is ready
+    unsigned int weights[] = {0, 0, 1};
+    options.policy = SELECT_WEIGHTED;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        list[i].weight = weights[i];
+    }
+    for (size_t i = 0; i < ROUNDS; i++) {
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        mu_assert("test_select_policy: SELECT_WEIGHTED picked a case without weight", index == 2);
+    }
+
+    // SELECT_RANDOM reaches every case
+    size_t picked[CHANNELS];
+    memset(picked, 0, sizeof(picked));
+    options.policy = SELECT_RANDOM;
+    for (size_t i = 0; i < ROUNDS * 3; i++) {
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        picked[index]++;
+    }
+    for (size_t i = 0; i < CHANNELS; i++) {
+        mu_assert("test_select_policy: SELECT_RANDOM never picked a case", picked[i] > 0);
+    }
+
+    // Only the ready cases count, wherever the policy starts
+    options.policy = SELECT_ROUND_ROBIN;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        void* data;
+        while (channel_non_blocking_receive(channel[i], &data) == SUCCESS) {
+        }
+    }
+    channel_send(channel[1], "Message1");
+    options.cursor = 2;
+    mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+    mu_assert("test_select_policy: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+    mu_assert("test_select_policy: Cursor did not move past the selected case", options.cursor == 2);
+
+    // SELECT_WEIGHTED splits the picks by the weights of the cases that are ready: with the heavy case 0 empty,
+    // cases 1 and 2 share them evenly instead of case 1 inheriting the share of case 0
+    size_t PICKS = 2000;
+    unsigned int skewed[] = {10, 1, 1};
+    size_t shares[CHANNELS];
+    memset(shares, 0, sizeof(shares));
+    options.policy = SELECT_WEIGHTED;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        list[i].weight = skewed[i];
+    }
+    for (size_t i = 0; i < PICKS; i++) {
+        channel_send(channel[1], "Message1");
+        channel_send(channel[2], "Message2");
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        shares[index]++;
+        void* data;
+        channel_non_blocking_receive(channel[3 - index], &data);
+    }
+    mu_assert("test_select_policy: SELECT_WEIGHTED picked an empty case", shares[0] == 0);
+    mu_assert("test_select_policy: SELECT_WEIGHTED shares do not follow the ready weights",
+              shares[1] > PICKS * 2 / 5 && shares[2] > PICKS * 2 / 5);
+    // With every case ready, case 0 gets 10 of every 12 picks
+    memset(shares, 0, sizeof(shares));
+    for (size_t i = 0; i < PICKS; i++) {
+        for (size_t j = 0; j < CHANNELS; j++) {
+            channel_send(channel[j], "Message");
+        }
+        mu_assert("test_select_policy: Select failed", channel_select_options(list, CHANNELS, &index, &options) == SUCCESS);
+        shares[index]++;
+        for (size_t j = 0; j < CHANNELS; j++) {
+            void* data;
+            channel_non_blocking_receive(channel[j], &data);
+        }
+    }
+    mu_assert("test_select_policy: SELECT_WEIGHTED shares do not follow the weights",
+              shares[0] > PICKS * 3 / 4 && shares[0] < PICKS * 9 / 10 && shares[1] > 0 && shares[2] > 0);
+
+    // Persistent sets follow the same policies
+    select_set_t* set = select_set_create(CHANNELS);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        select_set_add(set, &list[i], &index);
+        channel_send(channel[i], "Message");
+        channel_send(channel[i], "Message");
+    }
+    select_options_init(&options);
+    options.policy = SELECT_ROUND_ROBIN;
+    select_set_options(set, &options);
+    for (size_t i = 0; i < CHANNELS * 2; i++) {
+        mu_assert("test_select_policy: Wait failed", select_set_wait(set, &index) == SUCCESS);
+        mu_assert("test_select_policy: Select set did not take turns", index == i % CHANNELS);
+    }
+    // and weigh the ready cases only, with the heavy case 0 empty again
+    options.policy = SELECT_WEIGHTED;
+    select_set_options(set, &options);
+    memset(shares, 0, sizeof(shares));
+    for (size_t i = 0; i < PICKS; i++) {
+        channel_send(channel[1], "Message1");
+        channel_send(channel[2], "Message2");
+        mu_assert("test_select_policy: Wait failed", select_set_wait(set, &index) == SUCCESS);
+        shares[index]++;
+        void* data;
+        channel_non_blocking_receive(channel[3 - index], &data);
+    }
+    mu_assert("test_select_policy: Select set shares do not follow the ready weights",
+              shares[0] == 0 && shares[1] > PICKS * 2 / 5 && shares[2] > PICKS * 2 / 5);
+    select_set_destroy(set);
+
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel_close(channel[i]);
+        channel_destroy(channel[i]);
+    }
+    return NULL;
+}
+
+char* test_select_fairness() {
+    print_test_details(__func__, "Measuring per-case service latency of the select policies under saturation");
+
+    size_t CASES = 4;
+    size_t msgs = 20000;
+    enum select_policy policies[] = {SELECT_FIRST, SELECT_RANDOM, SELECT_ROUND_ROBIN, SELECT_WEIGHTED};
+    const char* names[] = {"first", "random", "round robin", "weighted"};
+    select_case_latency_t latencies[CASES];
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        run_select_fairness(policies[p], CASES, msgs, latencies);
+        printf("    %s:\n", names[p]);
+        for (size_t i = 0; i < CASES; i++) {
+            printf("      case %zu: %5.1f%% of messages, p50 %9.1f us, p99 %9.1f us, max %9.1f us\n", i,
+                   latencies[i].share * 100, latencies[i].p50_us, latencies[i].p99_us, latencies[i].max_us);
+        }
+    }
+
+    // The sender threads cannot keep up on few CPUs, so shares above also follow how fast each channel is refilled
+    // Topping the channels up before every select keeps exactly the chosen cases ready: with case 0 idle its weight
+    // must not go to the next case, so cases 1, 2 and 3 get 2, 3 and 4 ninths
+    channel_t* channels[CASES];
+    select_t list[CASES];
+    size_t counts[CASES];
+    for (size_t i = 0; i < CASES; i++) {
+        channels[i] = channel_create(1);
+        list[i].channel = channels[i];
+        list[i].dir = RECV;
+        list[i].weight = (unsigned int)(i + 1);
+        counts[i] = 0;
+    }
+    select_options_t options;
+    select_options_init(&options);
+    options.policy = SELECT_WEIGHTED;
+    for (size_t msg = 0; msg < msgs; msg++) {
+        for (size_t i = 1; i < CASES; i++) {
+            channel_non_blocking_send(channels[i], "Message");
+        }
+        size_t index;
+        mu_assert("test_select_fairness: Select failed", channel_select_options(list, CASES, &index, &options) == SUCCESS);
+        counts[index]++;
+    }
+    printf("    weighted, case 0 idle and the others always ready:\n");
+    for (size_t i = 0; i < CASES; i++) {
+        double share = (double)counts[i] / (double)msgs;
+        double expected = (i == 0) ? 0 : (double)(i + 1) / 9;
+        printf("      case %zu: %5.1f%% of messages, %5.1f%% expected\n", i, share * 100, expected * 100);
+        mu_assert("test_select_fairness: Weighted shares do not follow the weights of the ready cases",
+                  share > expected - 0.02 && share < expected + 0.02);
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+// Message of the sized channel tests, copied by value through the channel
+typedef struct {
+    size_t id;
+    char name[40];
+} sized_message_t;
+
+static sized_message_t sized_message(size_t id, const char* name) {
+    sized_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.id = id;
+    strncpy(message.name, name, sizeof(message.name) - 1);
+    return message;
+}
+
+static bool sized_message_equal(const sized_message_t* message, size_t id, const char* name) {
+    return message->id == id && string_equal(message->name, name);
+}
+
+char* test_sized_channel() {
+    print_test_details(__func__, "Testing channels that copy fixed-size messages inline");
+
+    mu_assert("test_sized_channel: Zero element size accepted", channel_create_sized(4, 0) == NULL);
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        channel_options_t options;
+        channel_options_init(&options);
+        options.kind = kinds[k];
+        options.elem_size = sizeof(sized_message_t);
+        channel_t* channel = channel_create_options(4, &options);
+        mu_assert("test_sized_channel: Could not create channel", channel != NULL);
+
+        // The channel keeps its own copy, so the sender can reuse its message right away
+        sized_message_t message = sized_message(1, "First");
+        mu_assert("test_sized_channel: Send failed", channel_send(channel, &message) == SUCCESS);
+        message = sized_message(2, "Second");
+        mu_assert("test_sized_channel: Send failed", channel_non_blocking_send(channel, &message) == SUCCESS);
+        memset(&message, 0, sizeof(message));
+        sized_message_t received;
+        void* data = &received;
+        mu_assert("test_sized_channel: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_sized_channel: Receive moved the destination", data == &received);
+        mu_assert("test_sized_channel: Wrong value received", sized_message_equal(&received, 1, "First"));
+        mu_assert("test_sized_channel: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_sized_channel: Wrong value received", sized_message_equal(&received, 2, "Second"));
+        mu_assert("test_sized_channel: Receive should fail", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+        mu_assert("test_sized_channel: Failed receive changed the destination", sized_message_equal(&received, 2, "Second"));
+
+        // Batches copy every message through its own pointer
+        sized_message_t batch[6];
+        void* items[6];
+        for (size_t i = 0; i < 6; i++) {
+            batch[i] = sized_message(10 + i, "Batch");
+            items[i] = &batch[i];
+        }
+        size_t moved = 0;
+        mu_assert("test_sized_channel: Batch send failed", channel_non_blocking_send_batch(channel, items, 6, &moved) == SUCCESS && moved == 4);
+        sized_message_t out[6];
+        for (size_t i = 0; i < 6; i++) {
+            items[i] = &out[i];
+        }
+        mu_assert("test_sized_channel: Batch receive failed", channel_receive_batch(channel, items, 6, &moved) == SUCCESS && moved == 4);
+        for (size_t i = 0; i < 4; i++) {
+            mu_assert("test_sized_channel: Wrong batch value received", sized_message_equal(&out[i], 10 + i, "Batch"));
+        }
+
+        // Selects send from and receive into the data of their cases
+        message = sized_message(3, "Select");
+        select_t send_case = {channel, SEND, &message};
+        size_t index = 1;
+        mu_assert("test_sized_channel: Select send failed", channel_select(&send_case, 1, &index) == SUCCESS && index == 0);
+        select_t recv_case = {channel, RECV, &received};
+        mu_assert("test_sized_channel: Select receive failed", channel_select(&recv_case, 1, &index) == SUCCESS && index == 0);
+        mu_assert("test_sized_channel: Select moved the destination", recv_case.data == &received);
+        mu_assert("test_sized_channel: Wrong value received", sized_message_equal(&received, 3, "Select"));
+
+        // Messages are copied through their pointers, so there must be one
+        mu_assert("test_sized_channel: NULL message accepted", channel_send(channel, NULL) == GEN_ERROR);
+        data = NULL;
+        mu_assert("test_sized_channel: NULL destination accepted", channel_non_blocking_receive(channel, &data) == GEN_ERROR);
+
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+
+    // Unbuffered sized channels copy straight from the sender's message into the receiver's
+    channel_t* channel = channel_create_sized(0, sizeof(sized_message_t));
+    mu_assert("test_sized_channel: Could not create channel", channel != NULL);
+    sized_message_t message = sized_message(4, "Unbuffered");
+    sized_message_t received;
+    memset(&received, 0, sizeof(received));
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, channel, NULL, NULL);
+    args.data = &message;
+    pthread_create(&pid, NULL, (void *)helper_send, &args);
+    void* data = &received;
+    mu_assert("test_sized_channel: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_sized_channel: Send failed", args.out == SUCCESS);
+    mu_assert("test_sized_channel: Wrong value received", sized_message_equal(&received, 4, "Unbuffered"));
+    receive_args receive;
+    init_object_for_receive_api(&receive, channel, NULL);
+    memset(&received, 0, sizeof(received));
+    receive.data = &received;
+    pthread_create(&pid, NULL, (void *)helper_receive, &receive);
+    message = sized_message(5, "Handoff");
+    mu_assert("test_sized_channel: Send failed", channel_send(channel, &message) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_sized_channel: Receive failed", receive.out == SUCCESS);
+    mu_assert("test_sized_channel: Wrong value received", sized_message_equal(&received, 5, "Handoff"));
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_sized_throughput() {
+    print_test_details(__func__, "Measuring inline messages against heap-allocated pointers");
+
+    size_t msgs = 1000000;
+    size_t sizes[] = {16, 64, 256};
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE};
+    const char* kind_names[] = {"locked", "lock-free"};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            double pointers = run_payload(kinds[k], sizes[i], msgs, false);
+            double sized = run_payload(kinds[k], sizes[i], msgs, true);
+            printf("    %-10s %3zu bytes: malloc'd pointers %10.0f msgs/s, inline %10.0f msgs/s\n",
+                   kind_names[k], sizes[i], pointers, sized);
+        }
+    }
+    return NULL;
+}
+
+// Allocates count messages of a pooled channel and sends them; the receiver releases them
+static void* helper_pool_sender(send_args* args) {
+    size_t count = (size_t)args->data;
+    args->out = SUCCESS;
+    for (size_t i = 1; i <= count && args->out == SUCCESS; i++) {
+        size_t* message = channel_msg_alloc(args->channel);
+        if (message == NULL) {
+            args->out = GEN_ERROR;
+            break;
+        }
+        *message = i;
+        args->out = channel_send(args->channel, message);
+    }
+    return NULL;
+}
+
+char* test_msg_pool() {
+    print_test_details(__func__, "Testing the per-channel message pool");
+
+    channel_t* plain = channel_create(1);
+    mu_assert("test_msg_pool: Channel without a pool handed out a message", channel_msg_alloc(plain) == NULL);
+    channel_msg_release(plain, NULL);
+    channel_close(plain);
+    channel_destroy(plain);
+
+    channel_options_t options;
+    channel_options_init(&options);
+    options.msg_size = 100;
+    channel_t* channel = channel_create_options(16, &options);
+    mu_assert("test_msg_pool: Could not create channel", channel != NULL);
+
+    // Messages are distinct, usable over their whole size and aligned like malloc
+    char* messages[200];
+    for (size_t i = 0; i < 200; i++) {
+        messages[i] = channel_msg_alloc(channel);
+        mu_assert("test_msg_pool: Allocation failed", messages[i] != NULL);
+        mu_assert("test_msg_pool: Message not aligned", (uintptr_t)messages[i] % _Alignof(max_align_t) == 0);
+        memset(messages[i], (int)i, 100);
+    }
+    for (size_t i = 0; i < 200; i++) {
+        for (size_t b = 0; b < 100; b++) {
+            mu_assert("test_msg_pool: Messages overlap", messages[i][b] == (char)i);
+        }
+    }
+
+    // A released message is handed out again
+    channel_msg_release(channel, messages[5]);
+    mu_assert("test_msg_pool: Released message not reused", channel_msg_alloc(channel) == messages[5]);
+    for (size_t i = 0; i < 200; i++) {
+        channel_msg_release(channel, messages[i]);
+    }
+    channel_msg_release(channel, NULL);
+
+    // Messages allocated by other threads go back through the receiver, including after those threads exit
+    size_t MESSAGES = 5000;
+    pthread_t pid[2];
+    send_args args[2];
+    for (size_t t = 0; t < 2; t++) {
+        init_object_for_send_api(&args[t], channel, NULL, NULL);
+        args[t].data = (void*)MESSAGES;
+        pthread_create(&pid[t], NULL, (void *)helper_pool_sender, &args[t]);
+    }
+    size_t sum = 0;
+    for (size_t i = 0; i < 2 * MESSAGES; i++) {
+        void* data = NULL;
+        mu_assert("test_msg_pool: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        sum += *(size_t*)data;
+        channel_msg_release(channel, data);
+    }
+    for (size_t t = 0; t < 2; t++) {
+        pthread_join(pid[t], NULL);
+        mu_assert("test_msg_pool: Send failed", args[t].out == SUCCESS);
+    }
+    mu_assert("test_msg_pool: Wrong values received", sum == MESSAGES * (MESSAGES + 1));
+
+    // Destroying the channel frees messages that were never released
+    mu_assert("test_msg_pool: Allocation failed", channel_msg_alloc(channel) != NULL);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Messages larger than a 64 KiB slab come out of slabs of several messages each
+    size_t LARGE = 100000;
+    options.msg_size = LARGE;
+    channel = channel_create_options(4, &options);
+    mu_assert("test_msg_pool: Could not create channel with large messages", channel != NULL);
+    char* large[40];
+    for (size_t i = 0; i < 40; i++) {
+        large[i] = channel_msg_alloc(channel);
+        mu_assert("test_msg_pool: Large allocation failed", large[i] != NULL);
+        mu_assert("test_msg_pool: Large message not aligned", (uintptr_t)large[i] % _Alignof(max_align_t) == 0);
+        memset(large[i], (int)i, LARGE);
+    }
+    for (size_t i = 0; i < 40; i++) {
+        mu_assert("test_msg_pool: Large messages overlap", large[i][0] == (char)i && large[i][LARGE - 1] == (char)i);
+        channel_msg_release(channel, large[i]);
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // A message size no slab can hold is rejected
+    options.msg_size = SIZE_MAX;
+    mu_assert("test_msg_pool: Channel with an impossible message size was created", channel_create_options(4, &options) == NULL);
+
+    // Pools keep working once the process has run out of pthread keys for their caches
+    size_t POOLED = PTHREAD_KEYS_MAX + 16;
+    channel_t** pooled = malloc(sizeof(channel_t*) * POOLED);
+    mu_assert("test_msg_pool: Could not allocate channel list", pooled != NULL);
+    options.msg_size = 100;
+    for (size_t i = 0; i < POOLED; i++) {
+        pooled[i] = channel_create_options(1, &options);
+        mu_assert("test_msg_pool: Could not create pooled channel past the pthread key limit", pooled[i] != NULL);
+    }
+    for (size_t i = POOLED - 16; i < POOLED; i++) {
+        char* first = channel_msg_alloc(pooled[i]);
+        char* second = channel_msg_alloc(pooled[i]);
+        mu_assert("test_msg_pool: Allocation past the pthread key limit failed", first != NULL && second != NULL && first != second);
+        mu_assert("test_msg_pool: Send failed", channel_send(pooled[i], first) == SUCCESS);
+        void* data = NULL;
+        mu_assert("test_msg_pool: Receive failed", channel_receive(pooled[i], &data) == SUCCESS && data == first);
+        channel_msg_release(pooled[i], data);
+        channel_msg_release(pooled[i], second);
+        mu_assert("test_msg_pool: Released message not reused", channel_msg_alloc(pooled[i]) == second);
+    }
+    for (size_t i = 0; i < POOLED; i++) {
+        channel_close(pooled[i]);
+        channel_destroy(pooled[i]);
+    }
+    free(pooled);
+    return NULL;
+}
+
+char* test_msg_pool_throughput() {
+    print_test_details(__func__, "Measuring the message pool against malloc and free");
+
+    size_t msgs = 1000000;
+    size_t sizes[] = {64, 1024};
+    size_t pairs[] = {1, 4};
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            double malloc_ns, pool_ns;
+            double with_malloc = run_msg_pool(pairs[p], sizes[i], msgs, false, &malloc_ns);
+            double with_pool = run_msg_pool(pairs[p], sizes[i], msgs, true, &pool_ns);
+            printf("    %zu pair(s) %4zu bytes: malloc/free %5.0f ns per message (%8.0f msgs/s), pool %5.0f ns per message (%8.0f msgs/s)\n",
+                   pairs[p], sizes[i], malloc_ns, with_malloc, pool_ns, with_pool);
+        }
+    }
+    return NULL;
+}
+
+char* test_timer() {
+    print_test_details(__func__, "Testing one-shot timers and tickers delivered on channels");
+
+    mu_assert("test_timer: Zero tick accepted", timer_service_create(0) == NULL);
+    timer_service_t* service = timer_service_create(1000000);
+    mu_assert("test_timer: Service not created", service != NULL);
+    channel_t* channel = channel_create(4);
+    void* data = NULL;
+
+    // A one-shot timer fires once, and not before its delay
+    struct timespec deadline = deadline_after(20);
+    channel_timer_t* timer = timer_after(service, channel, 20000000, "After");
+    mu_assert("test_timer: Timer not created", timer != NULL);
+    mu_assert("test_timer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_timer: Timer fired early", deadline_passed(&deadline));
+    mu_assert("test_timer: Wrong value received", string_equal(data, "After"));
+    mu_assert("test_timer: Fired timer still armed", !timer_stop(timer));
+    deadline = deadline_after(40);
+    mu_assert("test_timer: Timer fired twice", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+
+    // A stopped timer never fires, until it is reset
+    mu_assert("test_timer: Reset of a fired timer reported it armed", !timer_reset(timer, 20000000));
+    mu_assert("test_timer: Stop of an armed timer failed", timer_stop(timer));
+    deadline = deadline_after(60);
+    mu_assert("test_timer: Stopped timer fired", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+    deadline = deadline_after(10);
+    mu_assert("test_timer: Reset of a stopped timer reported it armed", !timer_reset(timer, 10000000));
+    mu_assert("test_timer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_timer: Reset timer fired early", deadline_passed(&deadline));
+
+    // Resetting an armed timer pushes its expiry back
+    timer_reset(timer, 20000000);
+    deadline = deadline_after(200);
+    mu_assert("test_timer: Reset of an armed timer failed", timer_reset(timer, 200000000));
+    mu_assert("test_timer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_timer: Reset timer fired at its old expiry", deadline_passed(&deadline));
+    timer_free(timer);
+
+    // A ticker keeps ticking until it is stopped
+    mu_assert("test_timer: Zero period accepted", timer_ticker(service, channel, 0, "Tick") == NULL);
+    deadline = deadline_after(25);
+    channel_timer_t* ticker = timer_ticker(service, channel, 5000000, "Tick");
+    mu_assert("test_timer: Ticker not created", ticker != NULL);
+    for (size_t i = 0; i < 5; i++) {
+        mu_assert("test_timer: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_timer: Wrong value received", string_equal(data, "Tick"));
+    }
+    mu_assert("test_timer: Ticker ticked early", deadline_passed(&deadline));
+    mu_assert("test_timer: Stop of a ticker failed", timer_stop(ticker));
+    while (channel_non_blocking_receive(channel, &data) == SUCCESS) {
+    }
+    deadline = deadline_after(30);
+    mu_assert("test_timer: Stopped ticker ticked", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+    timer_free(ticker);
+
+    // A timer channel works as the timeout case of a select
+    channel_t* idle = channel_create(1);
+    select_t list[2] = {{idle, RECV, NULL}, {channel, RECV, NULL}};
+    size_t index = 0;
+    timer = timer_after(service, channel, 10000000, "Timeout");
+    mu_assert("test_timer: Select failed", channel_select(list, 2, &index) == SUCCESS);
+    mu_assert("test_timer: Wrong case selected", index == 1 && string_equal(list[1].data, "Timeout"));
+    timer_free(timer);
+
+    // Many timers with the same and different expiries all fire, in expiry order across ticks
+    channel_t* many = channel_create(64);
+    channel_timer_t* timers[64];
+    for (size_t i = 0; i < 64; i++) {
+        timers[i] = timer_after(service, many, (uint64_t)(i / 8) * 5000000 + 1000000, (void*)(i / 8));
+    }
+    size_t last = 0;
+    for (size_t i = 0; i < 64; i++) {
+        mu_assert("test_timer: Receive failed", channel_receive(many, &data) == SUCCESS);
+        mu_assert("test_timer: Timers fired out of order", (size_t)data >= last);
+        last = (size_t)data;
+    }
+    for (size_t i = 0; i < 64; i++) {
+        timer_free(timers[i]);
+    }
+
+    timer_service_destroy(service);
+    channel_destroy(idle);
+    channel_destroy(many);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_timer_wheel() {
+    print_test_details(__func__, "Measuring arm and cancel costs with many armed timers");
+
+    size_t counts[] = {1000, 10000, 100000};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        timer_wheel_result_t result;
+        run_timer_wheel(counts[i], 1000000, 500000000, &result);
+        printf("    %6zu timers: arm %5.0f ns, cancel %5.0f ns, lateness p50 %7.0f us, p99 %7.0f us, max %7.0f us\n",
+               counts[i], result.arm_ns, result.cancel_ns, result.p50_late_us, result.p99_late_us, result.max_late_us);
+        mu_assert("test_timer_wheel: A timer fired early", !result.early);
+    }
+    return NULL;
+}
+
+char* test_list_nodes() {
+    print_test_details(__func__, "Testing intrusive and pooled linked list nodes");
+
+    // Nodes owned by the caller are spliced in and out without allocating
+    list_t* list = list_create();
+    list_node_t nodes[4];
+    char* values[4] = {"Node0", "Node1", "Node2", "Node3"};
+    for (size_t i = 0; i < 4; i++) {
+        list_link(list, &nodes[i], values[i]);
+    }
+    mu_assert("test_list_nodes: Wrong count", list_count(list) == 4);
+    mu_assert("test_list_nodes: Wrong head", list_head(list) == &nodes[0] && list_tail(list) == &nodes[3]);
+    list_unlink(list, &nodes[1]);
+    list_unlink(list, &nodes[3]);
+    mu_assert("test_list_nodes: Wrong count after unlink", list_count(list) == 2);
+    mu_assert("test_list_nodes: Wrong links after unlink", list_next(&nodes[0]) == &nodes[2] && list_prev(&nodes[2]) == &nodes[0]);
+    mu_assert("test_list_nodes: Wrong tail after unlink", list_tail(list) == &nodes[2]);
+    // Allocated and caller-owned nodes mix in one list
+    list_node_t* inserted = list_insert(list, "Inserted");
+    mu_assert("test_list_nodes: Insert failed", inserted != NULL && list_tail(list) == inserted);
+    list_unlink(list, &nodes[0]);
+    list_unlink(list, &nodes[2]);
+    mu_assert("test_list_nodes: Wrong head", list_head(list) == inserted && string_equal(list_data(inserted), "Inserted"));
+    list_remove(list, inserted);
+    mu_assert("test_list_nodes: List not empty", list_count(list) == 0 && list_head(list) == NULL && list_tail(list) == NULL);
+    list_destroy(list);
+
+    // A pooled list reuses removed nodes for later inserts, up to its limit
+    list = list_create_pooled(2);
+    list_node_t* first = list_insert(list, values[0]);
+    list_node_t* second = list_insert(list, values[1]);
+    list_node_t* third = list_insert(list, values[2]);
+    list_remove(list, first);
+    list_remove(list, second);
+    list_remove(list, third);
+    mu_assert("test_list_nodes: Wrong number of spare nodes", list->spare_count == 2);
+    list_node_t* reused = list_insert(list, values[3]);
+    mu_assert("test_list_nodes: Spare node not reused", reused == first || reused == second);
+    mu_assert("test_list_nodes: Wrong data in reused node", string_equal(list_data(reused), "Node3") && list_count(list) == 1);
+    list_destroy(list);
+    return NULL;
+}
+
+char* test_list_find() {
+    print_test_details(__func__, "Testing linked list lookups by data");
+
+    size_t NODES = 10000;
+    char* values = malloc(NODES);
+    for (int indexed = 0; indexed <= 1; indexed++) {
+        list_t* list = list_create();
+        // Searching an empty list, or for NULL data, finds nothing instead of walking off the list
+        mu_assert("test_list_find: Found data in an empty list", list_find(list, &values[0]) == NULL);
+        mu_assert("test_list_find: Found NULL data", list_find(list, NULL) == NULL);
+        if (indexed) {
+            mu_assert("test_list_find: Could not index the list", list_enable_index(list));
+        }
+        list_node_t** nodes = malloc(NODES * sizeof(list_node_t*));
+        for (size_t i = 0; i < NODES; i++) {
+            nodes[i] = list_insert(list, &values[i]);
+        }
+        list_node_t* duplicate = list_insert(list, &values[7]);
+        list_node_t* null_node = list_insert(list, NULL);
+        for (size_t i = 0; i < NODES; i++) {
+            mu_assert("test_list_find: Wrong node found", list_find(list, &values[i]) == nodes[i]);
+        }
+        mu_assert("test_list_find: NULL data not found", list_find(list, NULL) == null_node);
+        // Duplicates are found in list order
+        list_remove(list, nodes[7]);
+        mu_assert("test_list_find: Duplicate not found", list_find(list, &values[7]) == duplicate);
+        list_remove(list, duplicate);
+        mu_assert("test_list_find: Removed node found", list_find(list, &values[7]) == NULL);
+        // Every other node removed, the rest still found
+        for (size_t i = 0; i < NODES; i += 2) {
+            if (i != 7) {
+                list_remove(list, nodes[i]);
+            }
+        }
+        for (size_t i = 0; i < NODES; i++) {
+            list_node_t* expected = (i % 2 == 0 || i == 7) ? NULL : nodes[i];
+            mu_assert("test_list_find: Wrong node found after removals", list_find(list, &values[i]) == expected);
+        }
+        // Indexing a list that already has nodes picks them all up
+        if (!indexed) {
+            mu_assert("test_list_find: Could not index the list", list_enable_index(list));
+            mu_assert("test_list_find: Node missing from the index", list_find(list, &values[1]) == nodes[1]);
+            mu_assert("test_list_find: Node missing from the index", list_find(list, &values[NODES - 1]) == nodes[NODES - 1]);
+        }
+        free(nodes);
+        list_destroy(list);
+    }
+    free(values);
+    return NULL;
+}
+
+char* test_select_crowd() {
+    print_test_details(__func__, "Measuring select deregistration with many waiters on the same channel");
+
+    size_t waiters[] = {0, 10, 100, 1000};
+    for (size_t i = 0; i < sizeof(waiters) / sizeof(waiters[0]); i++) {
+        double latency = run_select_crowd(waiters[i], 20000);
+        printf("    %4zu parked waiters: %6.0f ns per round trip\n", waiters[i], latency);
+    }
+    return NULL;
+}
+
+char* test_select_overhead() {
+    print_test_details(__func__, "Measuring what a blocking select adds over a plain receive");
+
+    size_t round_trips = 20000;
+    channel_options_t options;
+    channel_options_init(&options);
+    double baseline = run_ping_pong(&options, 1, round_trips, false);
+    printf("    plain receive      : %8.0f ns per message\n", baseline);
+    // Past CHANNEL_SELECT_STACK_CASES (16) cases channel_select allocates its registrations on every call, while
+    // channel_select_with keeps them in its select_waiter_t
+    size_t channels[] = {1, 4, 16, 17, 64, 256};
+    for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+        double latency = run_select_scale(channels[i], round_trips, SCALE_SELECT);
+        double waiter_latency = run_select_scale(channels[i], round_trips, SCALE_SELECT_WITH);
+        printf("    select on %3zu cases : %8.0f ns per message (%+6.0f ns), with a select waiter %8.0f ns (%+6.0f ns)\n",
+               channels[i], latency, latency - baseline, waiter_latency, waiter_latency - baseline);
+    }
+    return NULL;
+}
+
+typedef struct {
+    broadcast_t* bus;
+    broadcast_subscriber_t* subscriber;
+    void* data;
+    _Atomic(enum channel_status) out;
+} broadcast_args;
+
+static void* helper_broadcast_publish(broadcast_args* args) {
+    atomic_store(&args->out, broadcast_publish(args->bus, args->data));
+    return NULL;
+}
+
+static void* helper_broadcast_receive(broadcast_args* args) {
+    void* data = NULL;
+    enum channel_status status = broadcast_receive(args->subscriber, &data);
+    args->data = data;
+    atomic_store(&args->out, status);
+    return NULL;
+}
+
+char* test_broadcast() {
+    print_test_details(__func__, "Testing broadcast channels");
+
+    mu_assert("test_broadcast: Created a broadcast without capacity", broadcast_create(0, BROADCAST_BLOCK) == NULL);
+    broadcast_t* bus = broadcast_create(4, BROADCAST_BLOCK);
+    mu_assert("test_broadcast: Could not create broadcast", bus != NULL);
+    broadcast_subscriber_t* fast = broadcast_subscribe(bus);
+    broadcast_subscriber_t* slow = broadcast_subscribe(bus);
+    mu_assert("test_broadcast: Could not subscribe", fast != NULL && slow != NULL);
+    void* data = NULL;
+    mu_assert("test_broadcast: Received from an empty broadcast", broadcast_non_blocking_receive(fast, &data) == CHANNEL_EMPTY);
+
+    // Every subscriber sees every item in order, and the ring is full until the slowest one has read
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(bus, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_broadcast: Published into a full ring", broadcast_non_blocking_publish(bus, (void*)5) == CHANNEL_FULL);
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_broadcast: Receive failed", broadcast_non_blocking_receive(fast, &data) == SUCCESS);
+        mu_assert("test_broadcast: Wrong item", (size_t)data == i);
+    }
+    mu_assert("test_broadcast: Publish did not wait for the slowest subscriber", broadcast_non_blocking_publish(bus, (void*)5) == CHANNEL_FULL);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(slow, &data) == SUCCESS && (size_t)data == 1);
+    mu_assert("test_broadcast: Publish failed", broadcast_non_blocking_publish(bus, (void*)5) == SUCCESS);
+
+    // A blocked publish goes through once the slowest subscriber leaves
+    pthread_t pid;
+    broadcast_args args = {bus, NULL, (void*)6, GEN_ERROR};
+    atomic_store(&args.out, CLOSED_ERROR - 100);
+    pthread_create(&pid, NULL, (void *)helper_broadcast_publish, &args);
+    usleep(10000);
+    mu_assert("test_broadcast: Publish did not block", atomic_load(&args.out) == CLOSED_ERROR - 100);
+    broadcast_unsubscribe(slow);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast: Blocked publish failed", atomic_load(&args.out) == SUCCESS);
+    for (size_t i = 5; i <= 6; i++) {
+        mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && (size_t)data == i);
+    }
+
+    // A late subscriber only sees what is published after it subscribed, and a blocked receive wakes on a publish
+    broadcast_subscriber_t* late = broadcast_subscribe(bus);
+    mu_assert("test_broadcast: Could not subscribe", late != NULL);
+    broadcast_args receive_args = {bus, late, NULL, GEN_ERROR};
+    atomic_store(&receive_args.out, CLOSED_ERROR - 100);
+    pthread_create(&pid, NULL, (void *)helper_broadcast_receive, &receive_args);
+    usleep(10000);
+    mu_assert("test_broadcast: Receive did not block", atomic_load(&receive_args.out) == CLOSED_ERROR - 100);
+    mu_assert("test_broadcast: Publish failed", broadcast_publish(bus, (void*)7) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast: Blocked receive failed", atomic_load(&receive_args.out) == SUCCESS && (size_t)receive_args.data == 7);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && (size_t)data == 7);
+
+    // Closing wakes a blocked receive and fails every later call
+    mu_assert("test_broadcast: Destroyed an open broadcast", broadcast_destroy(bus) == DESTROY_ERROR);
+    atomic_store(&receive_args.out, CLOSED_ERROR - 100);
+    pthread_create(&pid, NULL, (void *)helper_broadcast_receive, &receive_args);
+    usleep(10000);
+    mu_assert("test_broadcast: Close failed", broadcast_close(bus) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast: Close did not wake the receive", atomic_load(&receive_args.out) == CLOSED_ERROR);
+    mu_assert("test_broadcast: Closed twice", broadcast_close(bus) == CLOSED_ERROR);
+    mu_assert("test_broadcast: Published on a closed broadcast", broadcast_publish(bus, (void*)8) == CLOSED_ERROR);
+    mu_assert("test_broadcast: Received on a closed broadcast", broadcast_receive(fast, &data) == CLOSED_ERROR);
+    mu_assert("test_broadcast: Subscribed to a closed broadcast", broadcast_subscribe(bus) == NULL);
+    mu_assert("test_broadcast: Destroy failed", broadcast_destroy(bus) == SUCCESS);
+
+    // Under BROADCAST_DROP the publisher never waits and a lagging subscriber skips to the newest items
+    bus = broadcast_create(4, BROADCAST_DROP);
+    mu_assert("test_broadcast: Could not create broadcast", bus != NULL);
+    broadcast_subscriber_t* lagging = broadcast_subscribe(bus);
+    mu_assert("test_broadcast: Could not subscribe", lagging != NULL);
+    for (size_t i = 1; i <= 20; i++) {
+        mu_assert("test_broadcast: Publish blocked under BROADCAST_DROP", broadcast_non_blocking_publish(bus, (void*)i) == SUCCESS);
+    }
+    size_t received = 0;
+    size_t last = 0;
+    while (broadcast_non_blocking_receive(lagging, &data) == SUCCESS) {
+        mu_assert("test_broadcast: Items out of order", (size_t)data > last);
+        last = (size_t)data;
+        received++;
+    }
+    mu_assert("test_broadcast: Missed the newest item", last == 20);
+    mu_assert("test_broadcast: Kept fewer items than the capacity", received >= 4);
+    mu_assert("test_broadcast: Wrong dropped count", broadcast_dropped(lagging) == 20 - received);
+    broadcast_close(bus);
+    broadcast_destroy(bus);
+    return NULL;
+}
+
+char* test_broadcast_throughput() {
+    print_test_details(__func__, "Comparing one broadcast publish with a send per receiver");
+
+    size_t receivers[] = {1, 4, 16};
+    size_t msgs = 20000;
+    for (size_t i = 0; i < sizeof(receivers) / sizeof(receivers[0]); i++) {
+        double sends = run_fanout(receivers[i], msgs, false);
+        double publish = run_fanout(receivers[i], msgs, true);
+        printf("    %2zu receivers: %8.0f ns per message with a channel each, %8.0f ns with a broadcast\n", receivers[i], sends, publish);
+    }
+    return NULL;
+}
+
+char* test_priority_channel() {
+    print_test_details(__func__, "Testing priority channels");
+
+    channel_options_t options;
+    channel_options_init(&options);
+    options.priorities = CHANNEL_MAX_PRIORITIES + 1;
+    mu_assert("test_priority_channel: Created a channel with too many priorities", channel_create_options(4, &options) == NULL);
+    options.priorities = 3;
+    options.kind = CHANNEL_LOCK_FREE;
+    channel_t* channel = channel_create_options(4, &options);
+    mu_assert("test_priority_channel: Could not create channel", channel != NULL);
+    mu_assert("test_priority_channel: Priority channel is not locked", channel->kind == CHANNEL_LOCKED);
+
+    // Higher levels overtake lower ones, items of one level stay in order, and all levels share the size
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)1, 0) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_send(channel, (void*)2) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)3, 2) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_non_blocking_send_priority(channel, (void*)4, 1) == SUCCESS);
+    mu_assert("test_priority_channel: Sent into a full channel", channel_non_blocking_send_priority(channel, (void*)5, 2) == CHANNEL_FULL);
+    size_t expected[] = {3, 4, 1, 2};
+    void* data = NULL;
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_priority_channel: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_priority_channel: Wrong order", (size_t)data == expected[i]);
+    }
+    mu_assert("test_priority_channel: Received from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // Levels above the highest one are clamped to it
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)5, 2) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)6, 99) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)7, 1) == SUCCESS);
+    mu_assert("test_priority_channel: Wrong order", channel_receive(channel, &data) == SUCCESS && (size_t)data == 5);
+    mu_assert("test_priority_channel: Wrong order", channel_receive(channel, &data) == SUCCESS && (size_t)data == 6);
+    mu_assert("test_priority_channel: Wrong order", channel_receive(channel, &data) == SUCCESS && (size_t)data == 7);
+
+    // Select sends at the priority of its case and receives from the highest level
+    select_t send_case[1] = {{channel, SEND, (void*)8, 2}};
+    select_t receive_case[1] = {{channel, RECV, NULL, 0}};
+    size_t index;
+    mu_assert("test_priority_channel: Send failed", channel_send(channel, (void*)9) == SUCCESS);
+    mu_assert("test_priority_channel: Select send failed", channel_select(send_case, 1, &index) == SUCCESS);
+    mu_assert("test_priority_channel: Select receive failed", channel_select(receive_case, 1, &index) == SUCCESS);
+    mu_assert("test_priority_channel: Select ignored the priority", (size_t)receive_case[0].data == 8);
+    mu_assert("test_priority_channel: Select receive failed", channel_select(receive_case, 1, &index) == SUCCESS);
+    mu_assert("test_priority_channel: Wrong order", (size_t)receive_case[0].data == 9);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // With aging, a waiting lower level is served after every 2 items of the higher one
+    channel_options_init(&options);
+    options.priorities = 2;
+    options.priority_aging = 2;
+    channel = channel_create_options(16, &options);
+    mu_assert("test_priority_channel: Could not create channel", channel != NULL);
+    for (size_t i = 10; i < 14; i++) {
+        mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)i, 0) == SUCCESS);
+    }
+    for (size_t i = 20; i < 26; i++) {
+        mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)i, 1) == SUCCESS);
+    }
+    size_t aged[] = {20, 21, 10, 22, 23, 11, 24, 25, 12, 13};
+    void* batch[10];
+    size_t received;
+    mu_assert("test_priority_channel: Batch receive failed", channel_receive_batch(channel, batch, 10, &received) == SUCCESS && received == 10);
+    for (size_t i = 0; i < 10; i++) {
+        mu_assert("test_priority_channel: Aging did not serve the lower level", (size_t)batch[i] == aged[i]);
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Plain channels ignore the priority
+    channel = channel_create(4);
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)1, 0) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed", channel_send_priority(channel, (void*)2, 5) == SUCCESS);
+    mu_assert("test_priority_channel: Plain channel reordered", channel_receive(channel, &data) == SUCCESS && (size_t)data == 1);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_priority_latency() {
+    print_test_details(__func__, "Measuring how long control messages wait behind saturating bulk traffic");
+
+    size_t probes = 500;
+    double p50, p99;
+    run_priority_probe(false, probes, &p50, &p99);
+    printf("    fifo channel     : p50 %8.1f us, p99 %8.1f us\n", p50, p99);
+    run_priority_probe(true, probes, &p50, &p99);
+    printf("    priority channel : p50 %8.1f us, p99 %8.1f us\n", p50, p99);
+    return NULL;
+}
+
+static channel_t* growth_channel;
+
+// Sends 1 to 20000 on growth_channel in batches of up to 7
+static void* growth_sender(void* arg)
+{
+    (void)arg;
+    void* batch[7];
+    size_t next = 1;
+    while (next <= 20000) {
+        size_t count = 0;
+        while (count < 7 && next <= 20000) {
+            batch[count++] = (void*)next++;
+        }
+        size_t sent;
+        if (channel_send_batch(growth_channel, batch, count, &sent) != SUCCESS || sent != count) {
+            return "Batch send failed";
+        }
+    }
+    return NULL;
+}
+
+char* test_channel_growth() {
+    print_test_details(__func__, "Testing growable and unbounded channels");
+
+    channel_options_t options;
+    channel_options_init(&options);
+    options.growth = CHANNEL_GROWABLE;
+    options.max_size = 2;
+    mu_assert("test_channel_growth: Created a growable channel smaller than its size", channel_create_options(4, &options) == NULL);
+    options.growth = CHANNEL_UNBOUNDED;
+    options.priorities = 2;
+    mu_assert("test_channel_growth: Created an unbounded priority channel", channel_create_options(4, &options) == NULL);
+
+    // A growable channel doubles up to max_size, then blocks like a fixed one, and shrinks back once drained
+    channel_options_init(&options);
+    options.growth = CHANNEL_GROWABLE;
+    options.max_size = 16;
+    options.kind = CHANNEL_LOCK_FREE;
+    channel_t* channel = channel_create_options(4, &options);
+    mu_assert("test_channel_growth: Could not create channel", channel != NULL);
+    mu_assert("test_channel_growth: Growable channel is not locked", channel->kind == CHANNEL_LOCKED);
+    size_t initial = channel_storage_bytes(channel);
+    for (size_t i = 1; i <= 16; i++) {
+        mu_assert("test_channel_growth: Send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_growth: Grew past max_size", channel_non_blocking_send(channel, (void*)17) == CHANNEL_FULL);
+    mu_assert("test_channel_growth: Storage did not grow", channel_storage_bytes(channel) > initial);
+    void* data = NULL;
+    for (size_t i = 1; i <= 16; i++) {
+        mu_assert("test_channel_growth: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_growth: Wrong order", (size_t)data == i);
+    }
+    mu_assert("test_channel_growth: Received from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_channel_growth: Storage did not shrink", channel_storage_bytes(channel) == initial);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // An unbounded channel never reports full and keeps order across its ring and its overflow
+    channel_options_init(&options);
+    options.growth = CHANNEL_UNBOUNDED;
+    channel = channel_create_options(4, &options);
+    mu_assert("test_channel_growth: Could not create channel", channel != NULL);
+    initial = channel_storage_bytes(channel);
+    for (size_t i = 1; i <= 1000; i++) {
+        mu_assert("test_channel_growth: Unbounded send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_growth: Storage did not grow", channel_storage_bytes(channel) > initial);
+    for (size_t i = 1; i <= 998; i++) {
+        mu_assert("test_channel_growth: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_growth: Wrong order", (size_t)data == i);
+        if (i == 500) {
+            mu_assert("test_channel_growth: Send failed", channel_send(channel, (void*)1001) == SUCCESS);
+        }
+    }
+    void* batch[8];
+    size_t received;
+    mu_assert("test_channel_growth: Batch receive failed", channel_receive_batch(channel, batch, 8, &received) == SUCCESS && received == 3);
+    mu_assert("test_channel_growth: Wrong order", (size_t)batch[0] == 999 && (size_t)batch[1] == 1000 && (size_t)batch[2] == 1001);
+    mu_assert("test_channel_growth: Received from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Sized unbounded channels copy the overflow inline too
+    options.elem_size = sizeof(size_t);
+    channel = channel_create_options(2, &options);
+    mu_assert("test_channel_growth: Could not create channel", channel != NULL);
+    for (size_t i = 0; i < 600; i++) {
+        mu_assert("test_channel_growth: Sized send failed", channel_non_blocking_send(channel, &i) == SUCCESS);
+    }
+    for (size_t i = 0; i < 600; i++) {
+        size_t value = 0;
+        data = &value;
+        mu_assert("test_channel_growth: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_channel_growth: Wrong value received", value == i);
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Items keep their order while the ring resizes under a concurrent sender
+    enum channel_growth growths[] = {CHANNEL_GROWABLE, CHANNEL_UNBOUNDED};
+    for (size_t g = 0; g < 2; g++) {
+        channel_options_init(&options);
+        options.growth = growths[g];
+        options.max_size = 256;
+        growth_channel = channel_create_options(2, &options);
+        mu_assert("test_channel_growth: Could not create channel", growth_channel != NULL);
+        pthread_t pid;
+        mu_assert("test_channel_growth: Could not create thread", pthread_create(&pid, NULL, growth_sender, NULL) == 0);
+        size_t expected = 1;
+        while (expected <= 20000) {
+            mu_assert("test_channel_growth: Batch receive failed", channel_receive_batch(growth_channel, batch, 8, &received) == SUCCESS);
+            for (size_t i = 0; i < received; i++) {
+                mu_assert("test_channel_growth: Wrong order", (size_t)batch[i] == expected++);
+            }
+        }
+        void* error;
+        pthread_join(pid, &error);
+        mu_assert("test_channel_growth: Sender failed", error == NULL);
+        channel_close(growth_channel);
+        channel_destroy(growth_channel);
+    }
+    return NULL;
+}
+
+char* test_burst() {
+    print_test_details(__func__, "Measuring fixed, growable and unbounded channels under bursty traffic");
+
+    enum channel_growth growths[] = {CHANNEL_FIXED, CHANNEL_GROWABLE, CHANNEL_UNBOUNDED};
+    const char* names[] = {"fixed", "growable", "unbounded"};
+    for (size_t g = 0; g < 3; g++) {
+        burst_result_t result;
+        run_burst(growths[g], 20, 4096, &result);
+        printf("    %-10s: send p50 %7.2f us, p99 %8.2f us, peak %7zu bytes, idle %7zu bytes\n",
+               names[g], result.p50_send_us, result.p99_send_us, result.peak_bytes, result.idle_bytes);
+    }
+    return NULL;
+}
+
+typedef struct {
+    size_t seq;
+    char payload[4088];
+} spill_page_t;
+
+char* test_spill_channel() {
+    print_test_details(__func__, "Testing channels that spill to memory-mapped segment files");
+
+    channel_options_t options;
+    channel_options_init(&options);
+    options.growth = CHANNEL_SPILL;
+    mu_assert("test_spill_channel: Created a spill channel of void*", channel_create_options(4, &options) == NULL);
+
+    // Items past the ring go to the segment files, across several segments, and come back in order
+    options.elem_size = sizeof(spill_page_t);
+    channel_t* channel = channel_create_options(4, &options);
+    mu_assert("test_spill_channel: Could not create channel", channel != NULL);
+    mu_assert("test_spill_channel: Spill channel is not locked", channel->kind == CHANNEL_LOCKED);
+    size_t items = 3 * SPILL_QUEUE_SEGMENT_BYTES / sizeof(spill_page_t);
+    spill_page_t page;
+    memset(&page, 0, sizeof(page));
+    size_t next = 0;
+    for (size_t i = 0; i < items; i++) {
+        page.seq = i;
+        page.payload[sizeof(page.payload) - 1] = (char)i;
+        mu_assert("test_spill_channel: Spill send failed", channel_non_blocking_send(channel, &page) == SUCCESS);
+        // Receive now and then so the ring and the segments are both in use
+        if (i % 3 == 0) {
+            void* data = &page;
+            mu_assert("test_spill_channel: Receive failed", channel_receive(channel, &data) == SUCCESS);
+            mu_assert("test_spill_channel: Wrong order", page.seq == next);
+            mu_assert("test_spill_channel: Wrong value received", page.payload[sizeof(page.payload) - 1] == (char)next);
+            next++;
+        }
+    }
+    while (next < items) {
+        void* data = &page;
+        mu_assert("test_spill_channel: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spill_channel: Wrong order", page.seq == next);
+        mu_assert("test_spill_channel: Wrong value received", page.payload[sizeof(page.payload) - 1] == (char)next);
+        next++;
+    }
+    void* data = &page;
+    mu_assert("test_spill_channel: Received from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_spill_channel: Segments counted as memory", channel_storage_bytes(channel) < SPILL_QUEUE_SEGMENT_BYTES);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Without a usable directory the channel stays bounded by its ring
+    options.spill_dir = "/nonexistent/spill";
+    channel = channel_create_options(2, &options);
+    mu_assert("test_spill_channel: Could not create channel", channel != NULL);
+    mu_assert("test_spill_channel: Send failed", channel_non_blocking_send(channel, &page) == SUCCESS);
+    mu_assert("test_spill_channel: Send failed", channel_non_blocking_send(channel, &page) == SUCCESS);
+    mu_assert("test_spill_channel: Spilled without a directory", channel_non_blocking_send(channel, &page) == CHANNEL_FULL);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_spill() {
+    print_test_details(__func__, "Measuring producers during a burst 10 times the size of the channel");
+
+    size_t size = 16384;
+    enum channel_growth growths[] = {CHANNEL_FIXED, CHANNEL_UNBOUNDED, CHANNEL_SPILL};
+    const char* names[] = {"fixed", "unbounded", "spill"};
+    for (size_t g = 0; g < 3; g++) {
+        spill_result_t result;
+        run_spill(growths[g], size, 10 * size, &result);
+        printf("    %-10s: sender %10.0f msgs/s, receiver %10.0f msgs/s, %9zu bytes in memory after the burst\n",
+               names[g], result.send_rate, result.receive_rate, result.peak_bytes);
+    }
+    return NULL;
+}
+
+char* test_channel_stats() {
+    print_test_details(__func__, "Testing per-channel statistics counters");
+
+    channel_stats_t stats;
+    mu_assert("test_channel_stats: Stats of a NULL channel", channel_get_stats(NULL, &stats) == GEN_ERROR);
+#ifndef CHANNEL_STATS
+    // Built with STATS=0: nothing is counted
+    channel_t* off = channel_create(1);
+    mu_assert("test_channel_stats: Counters were not compiled out", channel_get_stats(off, &stats) == GEN_ERROR && stats.sends == 0);
+    mu_assert("test_channel_stats: Counters were not compiled out", channel_reset_stats(off) == GEN_ERROR);
+    channel_close(off);
+    channel_destroy(off);
+    return NULL;
+#endif
+
+    // Items, failures and depth are counted the same on every kind; batches count every item
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        channel_t* channel = channel_create_kind(4, kinds[k]);
+        mu_assert("test_channel_stats: Could not create channel", channel != NULL);
+        mu_assert("test_channel_stats: Send failed", channel_send(channel, "1") == SUCCESS);
+        mu_assert("test_channel_stats: Send failed", channel_non_blocking_send(channel, "2") == SUCCESS);
+        void* items[4] = {"3", "4", "5", "6"};
+        size_t moved;
+        mu_assert("test_channel_stats: Batch send failed", channel_non_blocking_send_batch(channel, items, 4, &moved) == SUCCESS && moved == 2);
+        mu_assert("test_channel_stats: Sent into a full channel", channel_non_blocking_send(channel, "7") == CHANNEL_FULL);
+        mu_assert("test_channel_stats: Batch receive failed", channel_receive_batch(channel, items, 4, &moved) == SUCCESS && moved == 4);
+        void* data;
+        mu_assert("test_channel_stats: Received from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+        mu_assert("test_channel_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+        mu_assert("test_channel_stats: Wrong send count", stats.sends == 4);
+        mu_assert("test_channel_stats: Wrong receive count", stats.receives == 4);
+        mu_assert("test_channel_stats: Wrong failure count", stats.send_failures == 1 && stats.receive_failures == 1);
+        mu_assert("test_channel_stats: Non-blocking calls counted as waits", stats.send_waits == 0 && stats.receive_waits == 0);
+        mu_assert("test_channel_stats: Wrong max depth", stats.max_depth == 4);
+
+        mu_assert("test_channel_stats: Reset failed", channel_reset_stats(channel) == SUCCESS);
+        mu_assert("test_channel_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+        mu_assert("test_channel_stats: Reset left counts", stats.sends == 0 && stats.receives == 0 && stats.send_failures == 0 &&
+                  stats.receive_failures == 0 && stats.max_depth == 0 && stats.select_wakeups == 0);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+
+    // A receive that finds the channel empty waits, and the time it waited is counted
+    channel_t* channel = channel_create(1);
+    sem_t done;
+    sem_init(&done, 0, 0);
+    pthread_t pid;
+    receive_args receive;
+    init_object_for_receive_api(&receive, channel, &done);
+    pthread_create(&pid, NULL, (void*)helper_receive, &receive);
+    usleep(10000);
+    mu_assert("test_channel_stats: Send failed", channel_send(channel, "1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_stats: Receive failed", receive.out == SUCCESS);
+    mu_assert("test_channel_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_channel_stats: Wait not counted", stats.receive_waits == 1 && stats.send_waits == 0);
+    mu_assert("test_channel_stats: Blocked time not counted", stats.receive_blocked_ns >= 1000000);
+    mu_assert("test_channel_stats: Wrong counts", stats.sends == 1 && stats.receives == 1);
+
+    // So does a select, which is also counted as woken by the channel
+    select_t cases[1] = {{channel, RECV, NULL, 0}};
+    select_args select;
+    init_object_for_select_api(&select, cases, 1, &done);
+    pthread_create(&pid, NULL, (void*)helper_select, &select);
+    usleep(10000);
+    mu_assert("test_channel_stats: Send failed", channel_send(channel, "2") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_stats: Select failed", select.out == SUCCESS);
+    mu_assert("test_channel_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_channel_stats: Select wakeup not counted", stats.select_wakeups == 1);
+    mu_assert("test_channel_stats: Wrong counts", stats.sends == 2 && stats.receives == 2);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // A handoff on an unbuffered channel counts for both sides
+    channel = channel_create(0);
+    send_args send;
+    init_object_for_send_api(&send, channel, "1", &done);
+    pthread_create(&pid, NULL, (void*)helper_send, &send);
+    usleep(10000);
+    void* data;
+    mu_assert("test_channel_stats: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_channel_stats: Wrong handoff counts", stats.sends == 1 && stats.receives == 1);
+    mu_assert("test_channel_stats: Wait not counted", stats.send_waits == 1 && stats.receive_waits == 0);
+    mu_assert("test_channel_stats: Unbuffered channel has a depth", stats.max_depth == 0);
+    channel_close(channel);
+    channel_destroy(channel);
+    sem_destroy(&done);
+    return NULL;
+}
+
+char* test_stats_overhead() {
+    print_test_details(__func__, "Measuring the cost of uncontended operations, to compare against a STATS=0 build");
+
+#ifdef CHANNEL_STATS
+    printf("    built with channel statistics\n");
+#else
+    printf("    built without channel statistics\n");
+#endif
+    size_t ops = 5000000;
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    const char* names[] = {"locked", "lock-free", "spsc"};
+    for (size_t k = 0; k < 3; k++) {
+        printf("    %-10s: %6.2f ns per operation\n", names[k], run_op_cost(kinds[k], ops));
+    }
+    return NULL;
+}
+
+char* test_histogram() {
+    print_test_details(__func__, "Testing log-linear histograms");
+
+    histogram_t* histogram = histogram_create();
+    mu_assert("test_histogram: Could not create histogram", histogram != NULL);
+    mu_assert("test_histogram: Empty histogram has values", histogram_count(histogram) == 0 && histogram_max(histogram) == 0);
+    mu_assert("test_histogram: Empty histogram has a percentile", histogram_percentile(histogram, 50) == 0);
+
+    // Small values get a bucket each
+    for (uint64_t v = 0; v < 128; v++) {
+        histogram_record(histogram, v);
+    }
+    mu_assert("test_histogram: Small values are not exact", histogram_percentile(histogram, 50) == 63);
+    mu_assert("test_histogram: Small values are not exact", histogram_percentile(histogram, 0) == 0);
+    mu_assert("test_histogram: Small values are not exact", histogram_percentile(histogram, 100) == 127);
+
+    // Larger ones are at most 1 / 2^HISTOGRAM_SUB_BITS over, never under
+    histogram_reset(histogram);
+    mu_assert("test_histogram: Reset histogram has values", histogram_count(histogram) == 0 && histogram_max(histogram) == 0);
+    size_t n = 1000000;
+    for (uint64_t v = 1; v <= n; v++) {
+        histogram_record(histogram, v);
+    }
+    mu_assert("test_histogram: Wrong count", histogram_count(histogram) == n);
+    mu_assert("test_histogram: Wrong max", histogram_max(histogram) == n);
+    double percentiles[] = {50, 99, 99.9};
+    for (size_t p = 0; p < 3; p++) {
+        double exact = percentiles[p] / 100 * (double)n;
+        double value = (double)histogram_percentile(histogram, percentiles[p]);
+        mu_assert("test_histogram: Percentile below the exact value", value >= exact);
+        mu_assert("test_histogram: Percentile too far off", value <= exact * (1 + 1.0 / (1 << HISTOGRAM_SUB_BITS)));
+    }
+    mu_assert("test_histogram: 100th percentile is not the max", histogram_percentile(histogram, 100) == n);
+
+    // Merging adds the counts and keeps the larger max, over the whole uint64_t range
+    histogram_t* other = histogram_create();
+    mu_assert("test_histogram: Could not create histogram", other != NULL);
+    histogram_record(other, UINT64_MAX);
+    histogram_record(other, 5);
+    histogram_merge(histogram, other);
+    mu_assert("test_histogram: Wrong merged count", histogram_count(histogram) == n + 2 && histogram_count(other) == 2);
+    mu_assert("test_histogram: Wrong merged max", histogram_max(histogram) == UINT64_MAX);
+    mu_assert("test_histogram: Wrong merged max", histogram_percentile(histogram, 100) == UINT64_MAX);
+    mu_assert("test_histogram: Merge moved the median", histogram_percentile(histogram, 50) >= n / 2);
+
+    histogram_destroy(histogram);
+    histogram_destroy(other);
+    return NULL;
+}
+
+char* test_sojourn_channel() {
+    print_test_details(__func__, "Testing sojourn time histograms of channels");
+
+    channel_options_t options;
+    channel_options_init(&options);
+    mu_assert("test_sojourn_channel: Sojourn mode is on by default", !options.sojourn);
+    mu_assert("test_sojourn_channel: NULL channel has a histogram", channel_sojourn_histogram(NULL) == NULL);
+    channel_t* plain = channel_create(4);
+    mu_assert("test_sojourn_channel: Plain channel has a histogram", channel_sojourn_histogram(plain) == NULL);
+    channel_close(plain);
+    channel_destroy(plain);
+
+    // Only single level fixed capacity channels
+    options.sojourn = true;
+    options.priorities = 2;
+    mu_assert("test_sojourn_channel: Created a priority sojourn channel", channel_create_options(4, &options) == NULL);
+    options.priorities = 1;
+    options.growth = CHANNEL_GROWABLE;
+    mu_assert("test_sojourn_channel: Created a growable sojourn channel", channel_create_options(4, &options) == NULL);
+    options.growth = CHANNEL_FIXED;
+
+    // Every item is recorded once, singles and batches alike, with at least the time it sat in the channel
+    useconds_t delay = 20000;
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        options.kind = kinds[k];
+        channel_t* channel = channel_create_options(8, &options);
+        mu_assert("test_sojourn_channel: Could not create channel", channel != NULL);
+        histogram_t* sojourn = channel_sojourn_histogram(channel);
+        mu_assert("test_sojourn_channel: No histogram", sojourn != NULL && histogram_count(sojourn) == 0);
+
+        // Go around the ring a few times so stamps of reused slots are checked too
+        for (size_t round = 0; round < 3; round++) {
+            void* items[3] = {"2", "3", "4"};
+            size_t moved;
+            mu_assert("test_sojourn_channel: Send failed", channel_send(channel, "1") == SUCCESS);
+            mu_assert("test_sojourn_channel: Batch send failed", channel_send_batch(channel, items, 3, &moved) == SUCCESS && moved == 3);
+            usleep(delay);
+            void* out[3];
+            mu_assert("test_sojourn_channel: Batch receive failed", channel_receive_batch(channel, out, 3, &moved) == SUCCESS && moved == 3);
+            mu_assert("test_sojourn_channel: Wrong items", strcmp(out[0], "1") == 0 && strcmp(out[2], "3") == 0);
+            mu_assert("test_sojourn_channel: Receive failed", channel_non_blocking_receive(channel, &out[0]) == SUCCESS);
+            mu_assert("test_sojourn_channel: Wrong item", strcmp(out[0], "4") == 0);
+            mu_assert("test_sojourn_channel: Wrong count", histogram_count(sojourn) == 4 * (round + 1));
+        }
+        mu_assert("test_sojourn_channel: Sojourn below the delay", histogram_percentile(sojourn, 0) >= (uint64_t)delay * 1000);
+        void* data;
+        mu_assert("test_sojourn_channel: Receive from an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+        mu_assert("test_sojourn_channel: Recorded a failed receive", histogram_count(sojourn) == 12);
+
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+
+    // Unbuffered channels hand items over without queueing them
+    options.kind = CHANNEL_LOCKED;
+    channel_t* unbuffered = channel_create_options(0, &options);
+    mu_assert("test_sojourn_channel: Could not create unbuffered channel", unbuffered != NULL);
+    mu_assert("test_sojourn_channel: No histogram", channel_sojourn_histogram(unbuffered) != NULL);
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+char* test_pipeline_sojourn() {
+    print_test_details(__func__, "Measuring where a pipeline with a slow middle stage queues messages");
+
+    const char* kind_names[] = {"locked", "lock-free", "spsc"};
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_LOCK_FREE, CHANNEL_SPSC};
+    for (size_t k = 0; k < 3; k++) {
+        pipeline_result_t result;
+        run_pipeline(kinds[k], 500, 32, &result);
+        printf("    %s\n", kind_names[k]);
+        for (size_t stage = 0; stage < PIPELINE_STAGES; stage++) {
+            printf("      stage %zu : p50 %9.1f us, p99 %9.1f us, p999 %9.1f us\n", stage, result.p50_us[stage],
+                   result.p99_us[stage], result.p999_us[stage]);
+        }
+        printf("      merged  : p50 %9.1f us, p99 %9.1f us, p999 %9.1f us\n", result.merged_p50_us, result.merged_p99_us,
+               result.merged_p999_us);
+    }
+    return NULL;
+}
+
+// Sends after a pause, so the receiving side is already blocked by then
+static void* helper_delayed_send(send_args* myargs) {
+    usleep(10000);
+    myargs->out = channel_send(myargs->channel, myargs->data);
+    return NULL;
+}
+
+char* test_select_waiter() {
+    print_test_details(__func__, "Testing selects that keep their registrations in a select waiter");
+
+    size_t CHANNELS = 20;
+    channel_t* channel[CHANNELS];
+    select_t list[CHANNELS];
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channel[i] = channel_create(1);
+        list[i].channel = channel[i];
+        list[i].dir = RECV;
+        list[i].data = NULL;
+    }
+    select_waiter_t* waiter = select_waiter_create();
+    mu_assert("test_select_waiter: Could not create select waiter", waiter != NULL);
+    size_t index;
+    mu_assert("test_select_waiter: NULL waiter should fail", channel_select_with(NULL, list, 3, &index, NULL) == GEN_ERROR);
+    mu_assert("test_select_waiter: NULL list should fail", channel_select_with(waiter, NULL, 3, &index, NULL) == GEN_ERROR);
+
+    // The same waiter serves call after call, whichever case the sender picks
+    pthread_t pid;
+    send_args args;
+    for (size_t round = 0; round < 6; round++) {
+        size_t target = (round * 2) % 3;
+        init_object_for_send_api(&args, channel[target], "Message", NULL);
+        pthread_create(&pid, NULL, (void *)helper_delayed_send, &args);
+        mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, 3, &index, NULL) == SUCCESS);
+        pthread_join(pid, NULL);
+        mu_assert("test_select_waiter: Wrong case selected", index == target && string_equal(list[target].data, "Message"));
+        mu_assert("test_select_waiter: Send failed", args.out == SUCCESS);
+    }
+
+    // Ready cases are taken without blocking, in the order of the options
+    channel_send(channel[1], "Message1");
+    channel_send(channel[2], "Message2");
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, 3, &index, NULL) == SUCCESS);
+    mu_assert("test_select_waiter: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+    select_options_t options;
+    select_options_init(&options);
+    options.policy = SELECT_ROUND_ROBIN;
+    options.cursor = 2;
+    channel_send(channel[0], "Message0");
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, 3, &index, &options) == SUCCESS);
+    mu_assert("test_select_waiter: Wrong case selected", index == 2 && string_equal(list[2].data, "Message2"));
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, 3, &index, &options) == SUCCESS);
+    mu_assert("test_select_waiter: Wrong case selected", index == 0 && string_equal(list[0].data, "Message0"));
+
+    // The waiter grows past the cases a select keeps on the stack, and still serves fewer cases afterwards
+    init_object_for_send_api(&args, channel[CHANNELS - 1], "Last", NULL);
+    pthread_create(&pid, NULL, (void *)helper_delayed_send, &args);
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, CHANNELS, &index, NULL) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_waiter: Wrong case selected", index == CHANNELS - 1 && string_equal(list[index].data, "Last"));
+    init_object_for_send_api(&args, channel[1], "Message1", NULL);
+    pthread_create(&pid, NULL, (void *)helper_delayed_send, &args);
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, list, 2, &index, NULL) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_waiter: Wrong case selected", index == 1 && string_equal(list[1].data, "Message1"));
+
+    // Cases may change between calls, also to unbuffered channels
+    channel_t* unbuffered = channel_create(0);
+    select_t other[2] = {{channel[5], RECV, NULL}, {unbuffered, RECV, NULL}};
+    init_object_for_send_api(&args, unbuffered, "Unbuffered", NULL);
+    pthread_create(&pid, NULL, (void *)helper_delayed_send, &args);
+    mu_assert("test_select_waiter: Select failed", channel_select_with(waiter, other, 2, &index, NULL) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_waiter: Wrong case selected", index == 1 && string_equal(other[1].data, "Unbuffered"));
+    mu_assert("test_select_waiter: Send failed", args.out == SUCCESS);
+
+    // Closed channels are reported
+    channel_close(channel[5]);
+    mu_assert("test_select_waiter: Closed channel not reported", channel_select_with(waiter, other, 2, &index, NULL) == CLOSED_ERROR && index == 0);
+
+    select_waiter_destroy(waiter);
+    select_waiter_destroy(NULL);
+    for (size_t i = 0; i < CHANNELS; i++) {
+        if (i != 5) {
+            channel_close(channel[i]);
+        }
+        channel_destroy(channel[i]);
+    }
+    channel_close(unbuffered);
+    channel_destroy(unbuffered);
+    return NULL;
+}
+
+char* test_stress_select_set_buffered() {
+    print_test_details(__func__, "Stress Testing select sets for buffered channels");
+    run_stress_kind(1, 1, "topology.txt", true);
+    run_stress_kind(1, 1, "connected_topology.txt", true);
+    run_stress_kind(1, 1, "random_topology.txt", true);
+    run_stress_kind(1, 1, "random_topology_1.txt", true);
+    run_stress_kind(1, 1, "big_graph.txt", true);
+    return NULL;
+}
+
+char* test_stress_select_set_unbuffered() {
+    print_test_details(__func__, "Stress Testing select sets for unbuffered channels");
+    run_stress_kind(0, 0, "topology.txt", true);
+    run_stress_kind(0, 0, "connected_topology.txt", true);
+    run_stress_kind(0, 0, "random_topology.txt", true);
+    run_stress_kind(0, 0, "random_topology_1.txt", true);
+    run_stress_kind(0, 0, "big_graph.txt", true);
+    return NULL;
+}
+
+char* test_stress_select_set_mixed_buffered_unbuffered() {
+    print_test_details(__func__, "Stress Testing select sets for mixing buffered and unbuffered channels");
+    run_stress_kind(0, 1, "topology.txt", true);
+    run_stress_kind(0, 1, "connected_topology.txt", true);
+    run_stress_kind(0, 1, "random_topology.txt", true);
+    run_stress_kind(0, 1, "random_topology_1.txt", true);
+    run_stress_kind(0, 1, "big_graph.txt", true);
+    return NULL;
+}
+
 typedef char* (*test_fn_t)();
 typedef struct {
     char* name;
@@ -2053,18 +4242,62 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
-                  //{"test_unbuffered", test_unbuffered},
-                  //{"test_non_blocking_unbuffered", test_non_blocking_unbuffered},
-                  //{"test_stress_send_recv_unbuffered", test_stress_send_recv_unbuffered},
-                  //{"test_select_and_non_blocking_send_unbuffered", test_select_and_non_blocking_send_unbuffered},
-                  //{"test_select_and_non_blocking_receive_unbuffered", test_select_and_non_blocking_receive_unbuffered},
-                  //{"test_select_with_select_unbuffered", test_select_with_select_unbuffered},
-                  //{"test_select_with_same_channel_unbuffered", test_select_with_same_channel_unbuffered},
-                  //{"test_select_with_send_receive_on_same_channel_unbuffered", test_select_with_send_receive_on_same_channel_unbuffered},
-                  //{"test_select_with_duplicate_channel_unbuffered", test_select_with_duplicate_channel_unbuffered},
-                  //{"test_select_mixed_buffered_unbuffered", test_select_mixed_buffered_unbuffered},
-                  //{"test_stress_unbuffered", test_stress_unbuffered},
-                  //{"test_stress_mixed_buffered_unbuffered", test_stress_mixed_buffered_unbuffered},
+                  {"test_lock_free", test_lock_free},
+                  {"test_throughput_lock_free", test_throughput_lock_free},
+                  {"test_spsc", test_spsc},
+                  {"test_stress_send_recv_spsc", test_stress_send_recv_spsc},
+                  {"test_batch", test_batch},
+                  {"test_throughput_batch", test_throughput_batch},
+                  {"test_unbuffered", test_unbuffered},
+                  {"test_non_blocking_unbuffered", test_non_blocking_unbuffered},
+                  {"test_stress_send_recv_unbuffered", test_stress_send_recv_unbuffered},
+                  {"test_select_and_non_blocking_send_unbuffered", test_select_and_non_blocking_send_unbuffered},
+                  {"test_select_and_non_blocking_receive_unbuffered", test_select_and_non_blocking_receive_unbuffered},
+                  {"test_select_with_select_unbuffered", test_select_with_select_unbuffered},
+                  {"test_select_with_same_channel_unbuffered", test_select_with_same_channel_unbuffered},
+                  {"test_select_with_send_receive_on_same_channel_unbuffered", test_select_with_send_receive_on_same_channel_unbuffered},
+                  {"test_select_with_duplicate_channel_unbuffered", test_select_with_duplicate_channel_unbuffered},
+                  {"test_select_mixed_buffered_unbuffered", test_select_mixed_buffered_unbuffered},
+                  {"test_stress_unbuffered", test_stress_unbuffered},
+                  {"test_stress_mixed_buffered_unbuffered", test_stress_mixed_buffered_unbuffered},
+                  {"test_ping_pong", test_ping_pong},
+                  {"test_wait_policy", test_wait_policy},
+                  {"test_buffer_layout", test_buffer_layout},
+                  {"test_select_herd", test_select_herd},
+                  {"test_select_scale", test_select_scale},
+                  {"test_select_set", test_select_set},
+                  {"test_deadline", test_deadline},
+                  {"test_deadline_overhead", test_deadline_overhead},
+                  {"test_try_select", test_try_select},
+                  {"test_select_policy", test_select_policy},
+                  {"test_select_fairness", test_select_fairness},
+                  {"test_timer", test_timer},
+                  {"test_timer_wheel", test_timer_wheel},
+                  {"test_sized_channel", test_sized_channel},
+                  {"test_sized_throughput", test_sized_throughput},
+                  {"test_msg_pool", test_msg_pool},
+                  {"test_msg_pool_throughput", test_msg_pool_throughput},
+                  {"test_list_nodes", test_list_nodes},
+                  {"test_list_find", test_list_find},
+                  {"test_select_crowd", test_select_crowd},
+                  {"test_select_overhead", test_select_overhead},
+                  {"test_broadcast", test_broadcast},
+                  {"test_broadcast_throughput", test_broadcast_throughput},
+                  {"test_priority_channel", test_priority_channel},
+                  {"test_priority_latency", test_priority_latency},
+                  {"test_channel_growth", test_channel_growth},
+                  {"test_burst", test_burst},
+                  {"test_spill_channel", test_spill_channel},
+                  {"test_spill", test_spill},
+                  {"test_channel_stats", test_channel_stats},
+                  {"test_stats_overhead", test_stats_overhead},
+                  {"test_histogram", test_histogram},
+                  {"test_sojourn_channel", test_sojourn_channel},
+                  {"test_pipeline_sojourn", test_pipeline_sojourn},
+                  {"test_select_waiter", test_select_waiter},
+                  {"test_stress_select_set_buffered", test_stress_select_set_buffered},
+                  {"test_stress_select_set_unbuffered", test_stress_select_set_unbuffered},
+                  {"test_stress_select_set_mixed_buffered_unbuffered", test_stress_select_set_mixed_buffered_unbuffered},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
@@ -0,0 +1,404 @@
+#include <stdlib.h>
+#include <time.h>
+#include "timer.h"
+
+// The wheel has TIMER_LEVEL0_SLOTS slots of one tick, then TIMER_LEVELS - 1 levels of TIMER_LEVEL_SLOTS slots that
+// each cover a whole turn of the level below; a timer sits on the lowest level whose range covers its expiry
+// When level 0 wraps around, the next slot of level 1 is cascaded down into it, and so on up the levels, so every
+// timer moves at most TIMER_LEVELS - 1 times before it fires
+#define TIMER_LEVEL0_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_LEVELS 5
+#define TIMER_LEVEL0_SLOTS (1 << TIMER_LEVEL0_BITS)
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_SLOTS (TIMER_LEVEL0_SLOTS + (TIMER_LEVELS - 1) * TIMER_LEVEL_SLOTS)
+// Furthest expiry the wheel can hold, in ticks; later ones are clamped to it
+#define TIMER_MAX_TICKS ((UINT64_C(1) << (TIMER_LEVEL0_BITS + (TIMER_LEVELS - 1) * TIMER_LEVEL_BITS)) - 1)
+
+// Links of a circular doubly linked list; every wheel slot is the sentinel of the timers that sit in it
+typedef struct timer_link {
+    struct timer_link* prev;
+    struct timer_link* next;
+} timer_link_t;
+
+struct channel_timer {
+    timer_link_t link; // in the wheel slot of the timer while it is armed
+    timer_service_t* service;
+    channel_t* channel;
+    void* message;
+    uint64_t expires; // tick the timer fires on
+    uint64_t period; // ticks between two firings of a ticker, 0 for one-shot timers
+    size_t slot; // index in service->slots while armed
+    bool armed;
+};
+
+struct timer_service {
+    pthread_mutex_t mutex; // guards everything below
+    timer_link_t slots[TIMER_SLOTS]; // level 0 first, then TIMER_LEVEL_SLOTS per higher level
+    uint64_t occupied[TIMER_LEVEL0_SLOTS / 64]; // bitmap of the non-empty level 0 slots
+    uint64_t tick; // next tick to process; every earlier one has fired
+    size_t armed; // number of timers in the wheel
+    uint64_t wake_tick; // tick the service thread sleeps until, UINT64_MAX while it waits for a wakeup
+    bool running;
+    uint64_t tick_ns;
+    struct timespec start; // time of tick 0
+    // The service thread sleeps on this until the next tick that has work; arming a timer before that tick or
+    // destroying the service sends on it to wake the thread up early
+    channel_t* wakeup;
+    pthread_t thread;
+};
+
+static void timer_link_init(timer_link_t* link)
+{
+    link->prev = link;
+    link->next = link;
+}
+
+static bool timer_link_empty(const timer_link_t* link)
+{
+    return link->next == link;
+}
+
+// Returns the nanoseconds between the start of the service and now
+static uint64_t timer_now_ns(const timer_service_t* service)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)((int64_t)(now.tv_sec - service->start.tv_sec) * 1000000000 + (now.tv_nsec - service->start.tv_nsec));
+}
+
+// Returns the CLOCK_MONOTONIC time at which tick begins
+static struct timespec timer_tick_time(const timer_service_t* service, uint64_t tick)
+{
+    uint64_t ns = tick * service->tick_ns + (uint64_t)service->start.tv_nsec;
+    struct timespec time;
+    time.tv_sec = service->start.tv_sec + (time_t)(ns / 1000000000);
+    time.tv_nsec = (long)(ns % 1000000000);
+    return time;
+}
+
+// Puts the timer in the wheel slot matching its expiry, relative to the next tick to process
+// The service mutex must be held
+static void timer_insert_locked(timer_service_t* service, channel_timer_t* timer)
+{
+    if (timer->expires < service->tick) {
+        timer->expires = service->tick;
+    }
+    uint64_t delta = timer->expires - service->tick;
+    if (delta > TIMER_MAX_TICKS) {
+        timer->expires = service->tick + TIMER_MAX_TICKS;
+        delta = TIMER_MAX_TICKS;
+    }
+    size_t slot;
+    if (delta < TIMER_LEVEL0_SLOTS) {
+        slot = (size_t)(timer->expires & (TIMER_LEVEL0_SLOTS - 1));
+        service->occupied[slot / 64] |= UINT64_C(1) << (slot % 64);
+    } else {
+        size_t level = 1;
+        while (delta >= (UINT64_C(1) << (TIMER_LEVEL0_BITS + level * TIMER_LEVEL_BITS))) {
+            level++;
+        }
+        size_t shift = TIMER_LEVEL0_BITS + (level - 1) * TIMER_LEVEL_BITS;
+        slot = TIMER_LEVEL0_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS + (size_t)((timer->expires >> shift) & (TIMER_LEVEL_SLOTS - 1));
+    }
+    timer->slot = slot;
+    timer_link_t* head = &service->slots[slot];
+    timer->link.prev = head->prev;
+    timer->link.next = head;
+    head->prev->next = &timer->link;
+    head->prev = &timer->link;
+}
+
+// Takes the timer out of its wheel slot
+// The service mutex must be held
+static void timer_unlink_locked(timer_service_t* service, channel_timer_t* timer)
+{
+    timer->link.prev->next = timer->link.next;
+    timer->link.next->prev = timer->link.prev;
+    timer_link_init(&timer->link);
+    // Clears the level 0 bit if that was the last timer in its slot
+    size_t slot = timer->slot;
+    if (slot < TIMER_LEVEL0_SLOTS && timer_link_empty(&service->slots[slot])) {
+        service->occupied[slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+    }
+}
+
+// Arms the timer to fire on tick expires, waking the service thread if it sleeps past that tick
+// The service mutex must be held
+static void timer_arm_locked(timer_service_t* service, channel_timer_t* timer, uint64_t expires)
+{
+    timer->expires = expires;
+    timer->armed = true;
+    service->armed++;
+    timer_insert_locked(service, timer);
+    if (timer->expires < service->wake_tick) {
+        service->wake_tick = timer->expires;
+        channel_non_blocking_send(service->wakeup, NULL);
+    }
+}
+
+// Stops an armed timer
+// The service mutex must be held
+static void timer_disarm_locked(timer_service_t* service, channel_timer_t* timer)
+{
+    timer_unlink_locked(service, timer);
+    timer->armed = false;
+    service->armed--;
+}
+
+// Moves every timer of the given slot of a higher level down to the slot its expiry now maps to
+// The service mutex must be held
+static void timer_cascade_locked(timer_service_t* service, size_t level, size_t index)
+{
+    timer_link_t pending;
+    timer_link_t* head = &service->slots[TIMER_LEVEL0_SLOTS + (level - 1) * TIMER_LEVEL_SLOTS + index];
+    if (timer_link_empty(head)) {
+        return;
+    }
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    timer_link_init(head);
+    while (!timer_link_empty(&pending)) {
+        channel_timer_t* timer = (channel_timer_t*)pending.next;
+        pending.next = timer->link.next;
+        pending.next->prev = &pending;
+        timer_insert_locked(service, timer);
+    }
+}
+
+// Returns the first tick from service->tick on that needs processing: one whose level 0 slot holds timers, or
+// the next turn of level 0, where the higher levels cascade
+// The service mutex must be held
+static uint64_t timer_next_tick_locked(const timer_service_t* service)
+{
+    size_t index = (size_t)(service->tick & (TIMER_LEVEL0_SLOTS - 1));
+    if (index == 0) {
+        return service->tick;
+    }
+    for (size_t word = index / 64; word < TIMER_LEVEL0_SLOTS / 64; word++) {
+        uint64_t bits = service->occupied[word];
+        if (word == index / 64) {
+            bits &= ~((UINT64_C(1) << (index % 64)) - 1);
+        }
+        if (bits != 0) {
+            return service->tick - index + word * 64 + (uint64_t)__builtin_ctzll(bits);
+        }
+    }
+    return service->tick - index + TIMER_LEVEL0_SLOTS;
+}
+
+// Fires every timer due up to and including tick now, skipping the ticks that have nothing to do
+// The service mutex must be held
+static void timer_advance_locked(timer_service_t* service, uint64_t now)
+{
+    while (service->armed > 0) {
+        uint64_t tick = timer_next_tick_locked(service);
+        if (tick > now) {
+            break;
+        }
+        service->tick = tick;
+        size_t index = (size_t)(tick & (TIMER_LEVEL0_SLOTS - 1));
+        if (index == 0) {
+            // Level l only cascades when every level below it has wrapped around as well
+            for (size_t level = 1; level < TIMER_LEVELS; level++) {
+                size_t shift = TIMER_LEVEL0_BITS + (level - 1) * TIMER_LEVEL_BITS;
+                size_t level_index = (size_t)((tick >> shift) & (TIMER_LEVEL_SLOTS - 1));
+                timer_cascade_locked(service, level, level_index);
+                if (level_index != 0) {
+                    break;
+                }
+            }
+        }
+        service->tick = tick + 1;
+        timer_link_t* head = &service->slots[index];
+        while (!timer_link_empty(head)) {
+            channel_timer_t* timer = (channel_timer_t*)head->next;
+            timer_disarm_locked(service, timer);
+            channel_non_blocking_send(timer->channel, timer->message);
+            if (timer->period != 0) {
+                // A ticker that fell behind skips the periods it missed instead of firing them all at once
+                uint64_t next = timer->expires + timer->period;
+                if (next <= now) {
+                    next += ((now - next) / timer->period + 1) * timer->period;
+                }
+                timer_arm_locked(service, timer, next);
+            }
+        }
+    }
+    if (service->tick <= now) {
+        service->tick = now + 1;
+    }
+}
+
+// Body of the service thread: fires the due timers, then sleeps until the next tick with work or a wakeup
+static void* timer_service_run(void* arg)
+{
+    timer_service_t* service = (timer_service_t*)arg;
+    pthread_mutex_lock(&service->mutex);
+    while (service->running) {
+        timer_advance_locked(service, timer_now_ns(service) / service->tick_ns);
+        bool idle = service->armed == 0;
+        service->wake_tick = idle ? UINT64_MAX : timer_next_tick_locked(service);
+        struct timespec deadline = idle ? service->start : timer_tick_time(service, service->wake_tick);
+        pthread_mutex_unlock(&service->mutex);
+        void* data;
+        if (idle) {
+            channel_receive(service->wakeup, &data);
+        } else {
+            channel_receive_until(service->wakeup, &data, &deadline);
+        }
+        pthread_mutex_lock(&service->mutex);
+    }
+    pthread_mutex_unlock(&service->mutex);
+    return NULL;
+}
+
+// Creates a timer service with a resolution of tick_ns nanoseconds and starts its thread
+// Timers fire on the first tick at or after their expiry, so they may be up to one tick late but never early
+// Returns NULL if tick_ns is 0 or the service could not be created
+timer_service_t* timer_service_create(uint64_t tick_ns)
+{
+    if (tick_ns == 0) {
+        return NULL;
+    }
+    timer_service_t* service = (timer_service_t*)malloc(sizeof(timer_service_t));
+    if (service == NULL) {
+        return NULL;
+    }
+    service->wakeup = channel_create(1);
+    if (service->wakeup == NULL) {
+        free(service);
+        return NULL;
+    }
+    pthread_mutex_init(&service->mutex, NULL);
+    for (size_t i = 0; i < TIMER_SLOTS; i++) {
+        timer_link_init(&service->slots[i]);
+    }
+    for (size_t i = 0; i < TIMER_LEVEL0_SLOTS / 64; i++) {
+        service->occupied[i] = 0;
+    }
+    service->tick = 1;
+    service->armed = 0;
+    service->wake_tick = UINT64_MAX;
+    service->running = true;
+    service->tick_ns = tick_ns;
+    clock_gettime(CLOCK_MONOTONIC, &service->start);
+    if (pthread_create(&service->thread, NULL, timer_service_run, service) != 0) {
+        pthread_mutex_destroy(&service->mutex);
+        channel_close(service->wakeup);
+        channel_destroy(service->wakeup);
+        free(service);
+        return NULL;
+    }
+    return service;
+}
+
+// Stops the service thread and frees the service
+// All of its timers must have been freed with timer_free; the channels they delivered on belong to the caller
+void timer_service_destroy(timer_service_t* service)
+{
+    if (service == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&service->mutex);
+    service->running = false;
+    pthread_mutex_unlock(&service->mutex);
+    channel_close(service->wakeup);
+    pthread_join(service->thread, NULL);
+    channel_destroy(service->wakeup);
+    pthread_mutex_destroy(&service->mutex);
+    free(service);
+}
+
+// Returns the first tick that begins at or after delay_ns nanoseconds from now
+// The service mutex must be held
+static uint64_t timer_expiry_locked(timer_service_t* service, uint64_t delay_ns)
+{
+    uint64_t now = timer_now_ns(service);
+    if (service->armed == 0 && service->tick <= now / service->tick_ns) {
+        // Nothing needs the ticks the service slept through, so skip them instead of walking the wheel over them
+        service->tick = now / service->tick_ns + 1;
+    }
+    return (now + delay_ns + service->tick_ns - 1) / service->tick_ns;
+}
+
+static channel_timer_t* timer_new(timer_service_t* service, channel_t* channel, uint64_t delay_ns, uint64_t period_ns, void* message)
+{
+    if (service == NULL || channel == NULL) {
+        return NULL;
+    }
+    channel_timer_t* timer = (channel_timer_t*)malloc(sizeof(channel_timer_t));
+    if (timer == NULL) {
+        return NULL;
+    }
+    timer_link_init(&timer->link);
+    timer->service = service;
+    timer->channel = channel;
+    timer->message = message;
+    timer->period = (period_ns + service->tick_ns - 1) / service->tick_ns;
+    timer->armed = false;
+    pthread_mutex_lock(&service->mutex);
+    timer_arm_locked(service, timer, timer_expiry_locked(service, delay_ns));
+    pthread_mutex_unlock(&service->mutex);
+    return timer;
+}
+
+// Arms a one-shot timer that sends message on channel once delay_ns nanoseconds have passed
+// Expirations are sent with channel_non_blocking_send so a slow receiver never holds up the other timers;
+// an expiration that finds the channel full or closed is dropped, so size the channel for the timers sharing it
+// Returns NULL if the timer could not be allocated or an argument is invalid
+channel_timer_t* timer_after(timer_service_t* service, channel_t* channel, uint64_t delay_ns, void* message)
+{
+    return timer_new(service, channel, delay_ns, 0, message);
+}
+
+// Arms a ticker that sends message on channel every period_ns nanoseconds, dropping ticks the channel has no room for
+// Returns NULL if the timer could not be allocated or an argument is invalid
+channel_timer_t* timer_ticker(timer_service_t* service, channel_t* channel, uint64_t period_ns, void* message)
+{
+    if (period_ns == 0) {
+        return NULL;
+    }
+    return timer_new(service, channel, period_ns, period_ns, message);
+}
+
+// Stops the timer; once this returns it will not send anything until it is reset
+// Returns true if the timer was armed
+bool timer_stop(channel_timer_t* timer)
+{
+    timer_service_t* service = timer->service;
+    pthread_mutex_lock(&service->mutex);
+    bool armed = timer->armed;
+    if (armed) {
+        timer_disarm_locked(service, timer);
+    }
+    pthread_mutex_unlock(&service->mutex);
+    return armed;
+}
+
+// Re-arms the timer to fire delay_ns nanoseconds from now, then every period for tickers
+// Returns true if the timer was armed before
+bool timer_reset(channel_timer_t* timer, uint64_t delay_ns)
+{
+    timer_service_t* service = timer->service;
+    pthread_mutex_lock(&service->mutex);
+    bool armed = timer->armed;
+    if (armed) {
+        timer_disarm_locked(service, timer);
+    }
+    timer_arm_locked(service, timer, timer_expiry_locked(service, delay_ns));
+    pthread_mutex_unlock(&service->mutex);
+    return armed;
+}
+
+// Stops the timer and frees it
+void timer_free(channel_timer_t* timer)
+{
+    if (timer == NULL) {
+        return;
+    }
+    timer_stop(timer);
+    free(timer);
+}
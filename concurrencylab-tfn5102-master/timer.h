@@ -0,0 +1,45 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "channel.h"
+
+// A hierarchical timer wheel driven by one thread that delivers expirations as messages on channels
+// Arming, re-arming and stopping a timer are O(1) whatever the number of timers armed
+typedef struct timer_service timer_service_t;
+
+// A one-shot timer or ticker of a timer service
+typedef struct channel_timer channel_timer_t;
+
+// Creates a timer service with a resolution of tick_ns nanoseconds and starts its thread
+// Timers fire on the first tick at or after their expiry, so they may be up to one tick late but never early
+// Returns NULL if tick_ns is 0 or the service could not be created
+timer_service_t* timer_service_create(uint64_t tick_ns);
+
+// Stops the service thread and frees the service
+// All of its timers must have been freed with timer_free; the channels they delivered on belong to the caller
+void timer_service_destroy(timer_service_t* service);
+
+// Arms a one-shot timer that sends message on channel once delay_ns nanoseconds have passed
+// Expirations are sent with channel_non_blocking_send so a slow receiver never holds up the other timers;
+// an expiration that finds the channel full or closed is dropped, so size the channel for the timers sharing it
+// Returns NULL if the timer could not be allocated or an argument is invalid
+channel_timer_t* timer_after(timer_service_t* service, channel_t* channel, uint64_t delay_ns, void* message);
+
+// Arms a ticker that sends message on channel every period_ns nanoseconds, dropping ticks the channel has no room for
+// Returns NULL if the timer could not be allocated or an argument is invalid
+channel_timer_t* timer_ticker(timer_service_t* service, channel_t* channel, uint64_t period_ns, void* message);
+
+// Stops the timer; once this returns it will not send anything until it is reset
+// Returns true if the timer was armed
+bool timer_stop(channel_timer_t* timer);
+
+// Re-arms the timer to fire delay_ns nanoseconds from now, then every period for tickers
+// Returns true if the timer was armed before
+bool timer_reset(channel_timer_t* timer, uint64_t delay_ns);
+
+// Stops the timer and frees it
+void timer_free(channel_timer_t* timer);
+
+#endif // TIMER_H